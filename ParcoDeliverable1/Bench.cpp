@@ -0,0 +1,308 @@
+#include "Bench.h"
+#include "Cpu_dispatch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <regex>
+#include <sstream>
+
+#include <unistd.h>
+
+//Set by CMake for this file only
+#ifndef PARCO_GIT_REVISION
+#define PARCO_GIT_REVISION "unknown"
+#endif
+
+#ifndef PARCO_CXX_FLAGS
+#define PARCO_CXX_FLAGS "unknown"
+#endif
+
+//Environment variables that change the results
+static const char* BENCH_ENV_VARS[] = {
+	"OMP_SCHEDULE", "OMP_PROC_BIND", "OMP_PLACES", "OMP_NUM_THREADS", "OMP_WAIT_POLICY",
+	"PARCO_SIMD", "PARCO_HUGE_PAGES", "PARCO_NUMA", "PARCO_TUNING_PROFILE"
+};
+
+//Two sided 97.5% quantiles of Student's t for 1 to 30
+//degrees of freedom, the normal one is used above
+static const double T_QUANTILES[] = {
+	12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+	2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+	2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+static constexpr double NORMAL_QUANTILE = 1.960;
+
+static double TQuantile(size_t dof) {
+	if (dof == 0)
+		return 0;
+
+	return dof <= sizeof(T_QUANTILES) / sizeof(T_QUANTILES[0]) ? T_QUANTILES[dof - 1] : NORMAL_QUANTILE;
+}
+
+//Linear interpolation between the closest ranks
+static double Percentile(std::vector<double> const& sorted, double p) {
+	double rank = p * (sorted.size() - 1);
+	size_t lower = size_t(rank);
+	size_t upper = std::min(lower + 1, sorted.size() - 1);
+
+	return sorted[lower] + (rank - lower) * (sorted[upper] - sorted[lower]);
+}
+
+BenchSettings& GetBenchSettings() {
+	static BenchSettings settings{ 2, 5, 10000, 0.02, 500, 0.05, true, "" };
+	return settings;
+}
+
+bool BenchSelected(const char* name) {
+	//Compiled again only when the filter changes
+	static std::string compiled;
+	static std::regex regex;
+
+	std::string const& filter = GetBenchSettings().filter;
+
+	if (filter.empty())
+		return true;
+
+	if (filter != compiled) {
+		regex = std::regex(filter);
+		compiled = filter;
+	}
+
+	return std::regex_search(name, regex);
+}
+
+BenchStats ComputeBenchStats(std::vector<double> samples, uint32_t calls_per_sample) {
+	BenchStats stats{};
+	stats.calls_per_sample = calls_per_sample;
+
+	if (samples.empty())
+		return stats;
+
+	std::vector<double> sorted(samples);
+	std::sort(sorted.begin(), sorted.end());
+
+	stats.min = sorted.front();
+	stats.median = Percentile(sorted, 0.5);
+	stats.p90 = Percentile(sorted, 0.9);
+	stats.p99 = Percentile(sorted, 0.99);
+
+	double sum = 0;
+
+	for (double sample : sorted)
+		sum += sample;
+
+	stats.mean = sum / sorted.size();
+
+	if (sorted.size() > 1) {
+		double sq_sum = 0;
+
+		for (double sample : sorted)
+			sq_sum += (sample - stats.mean) * (sample - stats.mean);
+
+		stats.stddev = std::sqrt(sq_sum / (sorted.size() - 1));
+		stats.ci95 = TQuantile(sorted.size() - 1) * stats.stddev / std::sqrt(double(sorted.size()));
+	}
+
+	stats.samples = std::move(samples);
+	return stats;
+}
+
+void PrintBenchStats(std::ostream& os, BenchStats const& stats) {
+	os << stats.median << " ms (min " << stats.min << ", p90 " << stats.p90 << ", p99 " << stats.p99
+		<< ", mean " << stats.mean << " +- " << stats.ci95 << ", stddev " << stats.stddev << ", "
+		<< stats.samples.size() << " samples";
+
+	if (stats.calls_per_sample > 1)
+		os << " of " << stats.calls_per_sample << " calls";
+
+	os << ")" << std::endl;
+
+	if (stats.bytes == 0 && !stats.counters.AnyValid())
+		return;
+
+	os << "\t";
+
+	//Measured the first time, with one thread per cpu
+	if (stats.bytes != 0) {
+		double stream = StreamCopyBandwidth();
+
+		os << stats.Bandwidth() << " GB/s";
+
+		if (stream > 0)
+			os << " (" << 100 * stats.Bandwidth() / stream << "% of STREAM copy, " << stream << " GB/s)";
+
+		os << (stats.counters.AnyValid() ? ", " : "");
+	}
+
+	bool first = true;
+
+	for (uint32_t event = 0; event < PERF_EVENT_COUNT; event++) {
+		if (!stats.counters.valid[event])
+			continue;
+
+		os << (first ? "" : ", ") << PerfEventName(PerfEvent(event)) << " " << stats.counters.values[event];
+		first = false;
+	}
+
+	const uint32_t CYCLES = uint32_t(PerfEvent::Cycles);
+	const uint32_t INSTRUCTIONS = uint32_t(PerfEvent::Instructions);
+
+	if (stats.counters.valid[CYCLES] && stats.counters.valid[INSTRUCTIONS] && stats.counters.values[CYCLES] > 0)
+		os << ", IPC " << stats.counters.values[INSTRUCTIONS] / stats.counters.values[CYCLES];
+
+	//Every miss is a line brought in from memory
+	const uint32_t LLC_MISSES = uint32_t(PerfEvent::LLCMisses);
+
+	if (stats.counters.valid[LLC_MISSES] && stats.median > 0)
+		os << ", LLC miss traffic " << stats.counters.values[LLC_MISSES] * CACHE_LINE_SIZE / (stats.median * 1e6) << " GB/s";
+
+	os << (first ? "" : " per call") << std::endl;
+}
+
+static std::string JsonString(std::string const& text) {
+	std::ostringstream json;
+	json << '"';
+
+	for (char c : text) {
+		if (c == '"' || c == '\\')
+			json << '\\' << c;
+		else if (static_cast<unsigned char>(c) < 0x20)
+			json << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec;
+		else
+			json << c;
+	}
+
+	json << '"';
+	return json.str();
+}
+
+//Enough digits to tell apart two runs, inf/nan are not JSON
+static std::string JsonNumber(double value) {
+	if (!std::isfinite(value))
+		return "null";
+
+	std::ostringstream json;
+	json << std::setprecision(9) << value;
+	return json.str();
+}
+
+static std::string CpuModel() {
+	std::ifstream cpuinfo("/proc/cpuinfo");
+	std::string line;
+
+	while (std::getline(cpuinfo, line)) {
+		if (line.compare(0, 10, "model name") != 0)
+			continue;
+
+		size_t colon = line.find(':');
+
+		if (colon != std::string::npos)
+			return line.substr(line.find_first_not_of(" \t", colon + 1));
+	}
+
+	return "unknown";
+}
+
+static std::string Hostname() {
+	char name[256] = {};
+	return gethostname(name, sizeof(name) - 1) == 0 ? name : "unknown";
+}
+
+static std::string UtcDate() {
+	char date[32] = {};
+	std::time_t now = std::time(nullptr);
+	std::tm utc;
+
+	gmtime_r(&now, &utc);
+	std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", &utc);
+	return date;
+}
+
+BenchReport::BenchReport() : m_n(0) {
+	AddMetadata("cpu", CpuModel());
+	AddMetadata("hostname", Hostname());
+	AddMetadata("date", UtcDate());
+	AddMetadata("git_revision", PARCO_GIT_REVISION);
+	AddMetadata("compiler", __VERSION__);
+	AddMetadata("cxx_flags", PARCO_CXX_FLAGS);
+	AddMetadata("simd", SimdLevelName(GetSimdLevel()));
+	AddMetadata("num_procs", double(omp_get_num_procs()));
+
+	//Unset ones are null, not empty
+	for (const char* name : BENCH_ENV_VARS) {
+		const char* value = std::getenv(name);
+		m_metadata.emplace_back(name, value != nullptr ? JsonString(value) : "null");
+	}
+}
+
+void BenchReport::AddMetadata(const char* key, std::string const& value) {
+	m_metadata.emplace_back(key, JsonString(value));
+}
+
+void BenchReport::AddMetadata(const char* key, double value) {
+	m_metadata.emplace_back(key, JsonNumber(value));
+}
+
+void BenchReport::Add(const char* kernel, uint32_t threads, bool parallel, BenchStats const& stats) {
+	m_entries.push_back(Entry{ kernel, m_n, threads, parallel, stats });
+}
+
+bool BenchReport::Write(const char* path) const {
+	std::ofstream out(path, std::ios::out | std::ios::trunc);
+
+	out << "{\n\t\"metadata\": {";
+
+	for (size_t idx = 0; idx < m_metadata.size(); idx++) {
+		out << (idx == 0 ? "\n" : ",\n") << "\t\t" << JsonString(m_metadata[idx].first) << ": "
+			<< m_metadata[idx].second;
+	}
+
+	out << "\n\t},\n\t\"results\": [";
+
+	for (size_t idx = 0; idx < m_entries.size(); idx++) {
+		Entry const& entry = m_entries[idx];
+		BenchStats const& stats = entry.stats;
+
+		out << (idx == 0 ? "\n" : ",\n") << "\t\t{ \"kernel\": " << JsonString(entry.kernel)
+			<< ", \"n\": " << entry.n << ", \"threads\": " << entry.threads
+			<< ", \"parallel\": " << (entry.parallel ? "true" : "false")
+			<< ", \"bytes\": " << stats.bytes
+			<< ", \"gb_per_s\": " << (stats.bytes != 0 ? JsonNumber(stats.Bandwidth()) : "null")
+			<< ", \"min_ms\": " << JsonNumber(stats.min)
+			<< ", \"median_ms\": " << JsonNumber(stats.median)
+			<< ", \"p90_ms\": " << JsonNumber(stats.p90)
+			<< ", \"p99_ms\": " << JsonNumber(stats.p99)
+			<< ", \"mean_ms\": " << JsonNumber(stats.mean)
+			<< ", \"stddev_ms\": " << JsonNumber(stats.stddev)
+			<< ", \"ci95_ms\": " << JsonNumber(stats.ci95)
+			<< ", \"calls_per_sample\": " << stats.calls_per_sample;
+
+		out << ",\n\t\t\t\"counters\": {";
+		bool first = true;
+
+		for (uint32_t event = 0; event < PERF_EVENT_COUNT; event++) {
+			if (!stats.counters.valid[event])
+				continue;
+
+			out << (first ? " " : ", ") << JsonString(PerfEventName(PerfEvent(event))) << ": "
+				<< JsonNumber(stats.counters.values[event]);
+			first = false;
+		}
+
+		out << (first ? "}" : " }") << ",\n\t\t\t\"samples_ms\": [";
+
+		for (size_t sample = 0; sample < stats.samples.size(); sample++)
+			out << (sample == 0 ? "" : ", ") << JsonNumber(stats.samples[sample]);
+
+		out << "] }";
+	}
+
+	out << "\n\t]\n}\n";
+
+	out.close();
+	return bool(out);
+}
@@ -4,45 +4,278 @@
 #include <iostream>
 #include <fstream>
 #include <chrono>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include <omp.h>
 
+#include "Perf_counters.h"
+
+/// <summary>
+/// How every benchmark is measured. The function is first
+/// run a few times without timing it (page faults, first
+/// touch, creation of the OMP threads), then it is timed
+/// one sample at a time until the 95% confidence interval
+/// of the mean is within target_rel_error of it, or the
+/// sample/time budget runs out
+/// </summary>
+struct BenchSettings {
+	//Untimed runs before the first sample
+	uint32_t warmup;
+	//Samples taken before the first check, at least
+	//the repeat count passed to the benchmark
+	uint32_t min_samples;
+	uint32_t max_samples;
+	//Half width of the confidence interval over the mean
+	double target_rel_error;
+	//Budget of one measurement, checked between samples
+	double max_ms;
+	//Calls faster than this are batched in one sample,
+	//so that the clock resolution does not show up
+	double min_sample_ms;
+	//Count cycles, instructions, LLC and dTLB misses
+	//during the samples, when perf_event_open allows it
+	bool counters;
+	//ECMAScript regex, only the benchmarks whose name
+	//contains a match are run (empty = all)
+	std::string filter;
+};
+
+/// <summary>
+/// Settings used by Benchmark and BenchmarkThreads,
+/// can be changed before running them
+/// </summary>
+/// <returns>The settings</returns>
+BenchSettings& GetBenchSettings();
+
+/// <summary>
+/// Tells if the benchmark passes the filter of the settings,
+/// the caller skips it (and its checks) otherwise
+/// </summary>
+/// <param name="name">Benchmark name</param>
+/// <returns>True if it has to be run</returns>
+bool BenchSelected(const char* name);
+
+/// <summary>
+/// Statistics of one measurement, times are
+/// per call, in ms
+/// </summary>
+struct BenchStats {
+	//Time of each sample, per call
+	std::vector<double> samples;
+	//Calls timed together in a sample
+	uint32_t calls_per_sample;
+
+	double min;
+	double median;
+	double p90;
+	double p99;
+	double mean;
+	double stddev;
+	//Half width of the 95% confidence interval of the mean
+	double ci95;
+
+	//Bytes read and written by a call, 0 if unknown
+	uint64_t bytes;
+	//Counters of the timed samples, per call
+	PerfValues counters;
+
+	double RelError() const { return mean > 0 ? ci95 / mean : 0; }
+
+	//GB/s at the median time
+	double Bandwidth() const { return median > 0 ? bytes / (median * 1e6) : 0; }
+};
+
+/// <summary>
+/// Fills the statistics from the samples
+/// </summary>
+/// <param name="samples">Time of each sample, per call</param>
+/// <param name="calls_per_sample">Calls timed together in a sample</param>
+/// <returns>The statistics</returns>
+BenchStats ComputeBenchStats(std::vector<double> samples, uint32_t calls_per_sample);
+
+/// <summary>
+/// Prints the statistics on one line, after
+/// "<name> took <median> ms", then the bandwidth
+/// against the STREAM copy one and the counters
+/// on a second line, if there are any
+/// </summary>
+void PrintBenchStats(std::ostream& os, BenchStats const& stats);
+
 /// <summary>
-/// Runs the given function a certain amount
-/// of times while registering the time
-/// it takes to execute it, then performs
-/// the average of the wall clock time
-/// and prints it to the console
+/// Results of a run, written as JSON together with what
+/// is needed to compare runs made on different machines:
+/// cpu, compiler and flags, git revision, SIMD level and
+/// the OMP/PARCO environment variables.
+/// The file looks like
+/// {
+///   "metadata": { "cpu": ..., "git_revision": ..., ... },
+///   "results": [ { "kernel": "OMP transpose", "n": 1024,
+///     "threads": 2, "parallel": true, "bytes": ...,
+///     "gb_per_s": ..., "median_ms": ..., "samples_ms": [...],
+///     "counters": { "cycles": ..., ... } }, ... ]
+/// }
+/// with times per call, in ms
+/// </summary>
+class BenchReport {
+public:
+	BenchReport();
+
+	/// <summary>
+	/// Size of the matrices of the results added next
+	/// </summary>
+	void SetSize(uint32_t N) { m_n = N; }
+
+	/// <summary>
+	/// Adds a field to the metadata
+	/// </summary>
+	void AddMetadata(const char* key, std::string const& value);
+	void AddMetadata(const char* key, double value);
+
+	/// <summary>
+	/// Adds the result of a benchmark
+	/// </summary>
+	/// <param name="kernel">Benchmark name</param>
+	/// <param name="threads">OMP threads, 1 for the serial ones</param>
+	/// <param name="parallel">Run by BenchmarkThreads</param>
+	/// <param name="stats">Statistics of the benchmark</param>
+	void Add(const char* kernel, uint32_t threads, bool parallel, BenchStats const& stats);
+
+	/// <summary>
+	/// Writes every result added so far,
+	/// replacing the file
+	/// </summary>
+	/// <param name="path">Output file</param>
+	/// <returns>False if the file could not be written</returns>
+	bool Write(const char* path) const;
+
+private:
+	struct Entry {
+		std::string kernel;
+		uint32_t n;
+		uint32_t threads;
+		bool parallel;
+		BenchStats stats;
+	};
+
+	uint32_t m_n;
+	//Keys and values, already in JSON
+	std::vector<std::pair<std::string, std::string>> m_metadata;
+	std::vector<Entry> m_entries;
+};
+
+/// <summary>
+/// Warms up and times call as described in BenchSettings
+/// </summary>
+/// <typeparam name="Call">Function type</typeparam>
+/// <param name="call">The function to time</param>
+/// <param name="repeat">Minimum number of samples</param>
+/// <param name="bytes">Bytes read and written by a call, 0 if unknown</param>
+/// <returns>The statistics of the samples</returns>
+template <typename Call>
+BenchStats MeasureBenchmark(Call&& call, uint32_t repeat, uint64_t bytes = 0) {
+	using Clock = std::chrono::steady_clock;
+	using Ms = std::chrono::duration<double, std::milli>;
+
+	BenchSettings const& settings = GetBenchSettings();
+
+	//At least one warmup run, it is also used to
+	//find how many calls go in a sample
+	double call_ms = 0;
+
+	for (uint32_t warm = 0; warm < settings.warmup || warm == 0; warm++) {
+		Clock::time_point start = Clock::now();
+		call();
+		call_ms = Ms(Clock::now() - start).count();
+	}
+
+	uint32_t calls = 1;
+
+	if (call_ms < settings.min_sample_ms)
+		calls = call_ms > 0 ? uint32_t(settings.min_sample_ms / call_ms) + 1 : 1u << 16;
+
+	const uint32_t MIN_SAMPLES = repeat > settings.min_samples ? repeat : settings.min_samples;
+
+	std::vector<double> samples;
+	BenchStats stats = ComputeBenchStats(samples, calls);
+
+	PerfCounters counters;
+	const bool COUNT = settings.counters && PerfCountersAvailable();
+
+	if (COUNT)
+		counters.Start();
+
+	Clock::time_point begin = Clock::now();
+	uint32_t next_check = MIN_SAMPLES;
+
+	while (samples.size() < settings.max_samples) {
+		Clock::time_point start = Clock::now();
+
+		for (uint32_t idx = 0; idx < calls; idx++)
+			call();
+
+		Clock::time_point end = Clock::now();
+		samples.push_back(Ms(end - start).count() / calls);
+
+		bool out_of_time = Ms(end - begin).count() >= settings.max_ms;
+
+		//Checked every MIN_SAMPLES samples, the interval
+		//only changes slowly anyway
+		if (samples.size() < next_check && !out_of_time)
+			continue;
+
+		stats = ComputeBenchStats(samples, calls);
+
+		if (samples.size() >= MIN_SAMPLES && (out_of_time || stats.RelError() <= settings.target_rel_error))
+			break;
+
+		next_check += MIN_SAMPLES;
+	}
+
+	PerfValues totals{};
+
+	if (COUNT)
+		totals = counters.Stop();
+
+	stats = ComputeBenchStats(samples, calls);
+	stats.bytes = bytes;
+	stats.counters = totals;
+
+	for (double& value : stats.counters.values)
+		value /= double(samples.size()) * calls;
+
+	return stats;
+}
+
+/// <summary>
+/// Measures the given function (see BenchSettings),
+/// prints the statistics to the console and adds
+/// them to out
 /// </summary>
 /// <typeparam name="Func">Function type</typeparam>
 /// <typeparam name="type">Hidden</typeparam>
 /// <param name="function">The function to benchmark</param>
 /// <param name="name">Benchmark name</param>
-/// <param name="repeat">Amount of times that the function needs to be run</param>
+/// <param name="repeat">Minimum number of timed samples</param>
+/// <param name="bytes">Bytes read and written by a call, 0 if unknown</param>
 template <typename Func,
 	typename std::enable_if< std::is_same<decltype((std::declval<Func>())()), void>::value, bool>::type = true
 >
-void Benchmark(Func&& function, const char* name, uint32_t repeat, std::ofstream& out) {
-	uint32_t rep_temp = repeat;
-	auto start = std::chrono::high_resolution_clock::now();
-
-	while (repeat--) {
-		function();
-	}
+void Benchmark(Func&& function, const char* name, uint32_t repeat, BenchReport& out, uint64_t bytes = 0) {
+	BenchStats stats = MeasureBenchmark(function, repeat, bytes);
 
-	auto end = std::chrono::high_resolution_clock::now();
+	std::cout << name << " took ";
+	PrintBenchStats(std::cout, stats);
 
-	auto diff = (end - start).count() / 1e6;
-	std::cout << name << " took " << diff / rep_temp << " ms" << std::endl;
-
-	out << diff / rep_temp << std::endl;
+	out.Add(name, 1, false, stats);
 }
 
 /// <summary>
-/// Runs the given function a certain amount
-/// of times while registering the time
-/// it takes to execute it, then performs
-/// the average of the wall clock time
-/// and prints it to the console.
+/// Measures the given function (see BenchSettings),
+/// prints the statistics to the console and adds
+/// them to out.
 /// Also returns the value from the function
 /// (which means that it would be a good idea
 /// to use a routine that always returns the same
@@ -52,29 +285,18 @@ void Benchmark(Func&& function, const char* name, uint32_t repeat, std::ofstream
 /// <typeparam name="type">Hidden</typeparam>
 /// <param name="function">The function to benchmark</param>
 /// <param name="name">Benchmark name</param>
-/// <param name="repeat">Amount of times that the function needs to be run</param>
+/// <param name="repeat">Minimum number of timed samples</param>
+/// <param name="bytes">Bytes read and written by a call, 0 if unknown</param>
 /// <returns>The return value of the function</returns>
 template <typename Func,
 	typename = typename std::enable_if< !std::is_same<decltype((std::declval<Func>())()), void>::value, bool>::type
 >
-decltype((std::declval<Func>())()) Benchmark(Func&& function, const char* name, uint32_t repeat, 
-	std::ofstream& out) {
-	uint32_t rep_temp = repeat;
+decltype((std::declval<Func>())()) Benchmark(Func&& function, const char* name, uint32_t repeat,
+	BenchReport& out, uint64_t bytes = 0) {
 	using RetType = decltype(function()); //Deduce return type
 	RetType ret{};
 
-	auto start = std::chrono::high_resolution_clock::now();
-
-	while (repeat--) {
-		ret = function();
-	}
-
-	auto end = std::chrono::high_resolution_clock::now();
-
-	auto diff = (end - start).count() / 1e6;
-	std::cout << name << " took " << diff / rep_temp << " ms" << std::endl;
-
-	out << diff / rep_temp << std::endl;
+	Benchmark([&]() { ret = function(); }, name, repeat, out, bytes);
 
 	return ret;
 }
@@ -84,25 +306,27 @@ decltype((std::declval<Func>())()) Benchmark(Func&& function, const char* name,
 /// <summary>
 /// The principle is the same for the normal
 /// benchmark, but performed with a different
-/// number of threads each time
+/// number of threads each time. Each thread
+/// count gets its own warmup, which also
+/// creates the OMP threads, and the counters
+/// are summed over the threads of the team
 /// </summary>
 /// <typeparam name="Func">Type of the function</typeparam>
 /// <typeparam name="type">Hidden</typeparam>
 /// <typeparam name="IncFunc">Type of the increment function</typeparam>
 /// <param name="function">Function to benchmark</param>
 /// <param name="name">Benchmark name</param>
-/// <param name="repeat">Number of times that a test with N threads is performed</param>
+/// <param name="repeat">Minimum number of timed samples with N threads</param>
 /// <param name="inc_func">Function that returns the next number of threads</param>
 /// <param name="init">Init number of threads</param>
 /// <param name="limit">Max threads</param>
+/// <param name="bytes">Bytes read and written by a call, 0 if unknown</param>
 template <typename Func, typename IncFunc,
 	typename std::enable_if< std::is_same<decltype((std::declval<Func>())()), void>::value, bool>::type = true
 >
 void BenchmarkThreads(Func&& function, const char* name, uint32_t repeat, IncFunc&& inc_func, uint32_t init, uint32_t limit,
-	std::ofstream& out) {
+	BenchReport& out, uint64_t bytes = 0) {
 	uint32_t num_cycles = 0;
-	uint32_t curr_rep = repeat;
-	uint32_t orig_rep = repeat;
 
 	//Force the OMP runtime to use the exact number
 	//of threads that we want
@@ -113,20 +337,13 @@ void BenchmarkThreads(Func&& function, const char* name, uint32_t repeat, IncFun
 	while (init <= limit) {
 		//Set N threads
 		omp_set_num_threads(init);
-		uint32_t rep_temp = orig_rep;
-		curr_rep = orig_rep;
-		auto start = std::chrono::high_resolution_clock::now();
-
-		while (curr_rep--) {
-			function();
-		}
 
-		auto end = std::chrono::high_resolution_clock::now();
+		BenchStats stats = MeasureBenchmark(function, repeat, bytes);
 
-		auto diff = (end - start).count() / 1e6;
-		std::cout << name << " with " << init << " threads took " << diff / rep_temp << " ms" << std::endl;
+		std::cout << name << " with " << init << " threads took ";
+		PrintBenchStats(std::cout, stats);
 
-		out << init << " " << diff / rep_temp << std::endl;
+		out.Add(name, init, true, stats);
 
 		//Get next thread count
 		init = inc_func(init, num_cycles++);
@@ -145,47 +362,21 @@ void BenchmarkThreads(Func&& function, const char* name, uint32_t repeat, IncFun
 /// <typeparam name="IncFunc">Type of the increment function</typeparam>
 /// <param name="function">Function to benchmark</param>
 /// <param name="name">Benchmark name</param>
-/// <param name="repeat">Number of times that a test with N threads is performed</param>
+/// <param name="repeat">Minimum number of timed samples with N threads</param>
 /// <param name="inc_func">Function that returns the next number of threads</param>
 /// <param name="init">Init number of threads</param>
 /// <param name="limit">Max threads</param>
+/// <param name="bytes">Bytes read and written by a call, 0 if unknown</param>
 /// <returns>Function's return value</returns>
 template <typename Func, typename IncFunc,
 	typename = typename std::enable_if< !std::is_same<decltype((std::declval<Func>())()), void>::value, bool>::type
 >
 decltype((std::declval<Func>())()) BenchmarkThreads(Func&& function, const char* name, uint32_t repeat
-	, IncFunc&& inc_func, uint32_t init, uint32_t limit, std::ofstream& out) {
+	, IncFunc&& inc_func, uint32_t init, uint32_t limit, BenchReport& out, uint64_t bytes = 0) {
 	using RetType = decltype(function());
 	RetType ret{};
 
-	uint32_t curr_rep = repeat;
-	uint32_t orig_rep = repeat;
-	uint32_t num_cycles = 0;
-
-	auto dynamic = omp_get_dynamic();
-	omp_set_dynamic(0);
-
-	while (init <= limit) {
-		omp_set_num_threads(init);
-		uint32_t rep_temp = orig_rep;
-		curr_rep = orig_rep;
-		auto start = std::chrono::high_resolution_clock::now();
-
-		while (curr_rep--) {
-			ret = function();
-		}
-
-		auto end = std::chrono::high_resolution_clock::now();
-
-		auto diff = (end - start).count() / 1e6;
-		std::cout << name << " with " << init << " threads took " << diff / rep_temp << " ms" << std::endl;
-
-		out << init << " " << diff / rep_temp << std::endl;
-
-		init = inc_func(init, num_cycles++);
-	}
-
-	omp_set_dynamic(dynamic);
+	BenchmarkThreads([&]() { ret = function(); }, name, repeat, inc_func, init, limit, out, bytes);
 
 	return ret;
 }
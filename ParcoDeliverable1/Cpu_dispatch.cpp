@@ -0,0 +1,288 @@
+#include "Cpu_dispatch.h"
+#include "Matrix_utils.h"
+
+#include <cpuid.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+//Read the extended control register, which tells
+//us which register files are saved by the OS.
+//A CPU could support AVX while the OS does not
+//save the upper halves of the ymm registers
+static uint64_t ReadXCR0() {
+	uint32_t eax = 0, edx = 0;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (uint64_t(edx) << 32) | eax;
+}
+
+static CpuFeatures DetectCpuFeatures() {
+	CpuFeatures features{ false, false, false };
+
+	uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return features;
+
+	features.sse41 = (ecx & bit_SSE4_1) != 0;
+
+	bool osxsave = (ecx & bit_OSXSAVE) != 0;
+	bool avx = (ecx & bit_AVX) != 0;
+
+	if (!osxsave || !avx)
+		return features;
+
+	uint64_t xcr0 = ReadXCR0();
+
+	//xmm (bit 1) and ymm (bit 2) state
+	bool os_avx = (xcr0 & 0x6) == 0x6;
+	//opmask (bit 5), upper zmm0-15 (bit 6), zmm16-31 (bit 7)
+	bool os_avx512 = (xcr0 & 0xE6) == 0xE6;
+
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return features;
+
+	features.avx2 = os_avx && (ebx & bit_AVX2) != 0;
+	features.avx512f = os_avx512 && (ebx & bit_AVX512F) != 0;
+
+	return features;
+}
+
+CpuFeatures const& GetCpuFeatures() {
+	//Initialized once, thread safe since C++11
+	static const CpuFeatures features = DetectCpuFeatures();
+	return features;
+}
+
+static SimdLevel DetectSimdLevel() {
+	CpuFeatures const& features = GetCpuFeatures();
+
+	SimdLevel level = SimdLevel::SSE;
+
+	if (features.avx512f)
+		level = SimdLevel::AVX512;
+	else if (features.avx2)
+		level = SimdLevel::AVX2;
+
+	//Allow the user to force a narrower kernel
+	const char* cap = std::getenv("PARCO_SIMD");
+
+	if (cap != nullptr) {
+		SimdLevel max_level = level;
+
+		if (std::strcmp(cap, "sse") == 0)
+			max_level = SimdLevel::SSE;
+		else if (std::strcmp(cap, "avx2") == 0)
+			max_level = SimdLevel::AVX2;
+
+		if (uint32_t(max_level) < uint32_t(level))
+			level = max_level;
+	}
+
+	return level;
+}
+
+SimdLevel GetSimdLevel() {
+	static const SimdLevel level = DetectSimdLevel();
+	return level;
+}
+
+const char* SimdLevelName(SimdLevel level) {
+	switch (level) {
+	case SimdLevel::AVX512:
+		return "avx512";
+	case SimdLevel::AVX2:
+		return "avx2";
+	default:
+		break;
+	}
+
+	return "sse";
+}
+
+//Sizes are written as "48K", "2048K" or "300M"
+static uint32_t ParseCacheSize(std::string const& text) {
+	uint64_t size = std::strtoull(text.c_str(), nullptr, 10);
+
+	if (text.find('K') != std::string::npos)
+		size <<= 10;
+	else if (text.find('M') != std::string::npos)
+		size <<= 20;
+
+	return uint32_t(std::min<uint64_t>(size, UINT32_MAX));
+}
+
+//Ids in a cpu or node list like "0-3,8,10-11"
+static std::vector<uint32_t> ParseIdList(std::string const& text) {
+	std::vector<uint32_t> ids;
+	const char* curr = text.c_str();
+
+	while (*curr != '\0') {
+		char* end = nullptr;
+		unsigned long first = std::strtoul(curr, &end, 10);
+
+		if (end == curr)
+			break;
+
+		unsigned long last = first;
+
+		if (*end == '-')
+			last = std::strtoul(end + 1, &end, 10);
+
+		for (unsigned long id = first; id <= last; id++)
+			ids.push_back(uint32_t(id));
+
+		curr = (*end == ',') ? end + 1 : end;
+	}
+
+	return ids;
+}
+
+static bool ReadLine(std::string const& path, std::string& line) {
+	std::ifstream file(path);
+	return bool(std::getline(file, line));
+}
+
+static CacheSizes DetectCacheSizes() {
+	CacheSizes sizes{ 0, 0, 0, 1 };
+	uint32_t llc_level = 0;
+
+	//One directory per cache, until the first missing index
+	for (uint32_t index = 0;; index++) {
+		std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+		std::string level_text, type, size_text, shared;
+
+		if (!ReadLine(dir + "level", level_text) || !ReadLine(dir + "type", type)
+			|| !ReadLine(dir + "size", size_text))
+			break;
+
+		//Instruction caches do not matter here
+		if (type == "Instruction")
+			continue;
+
+		uint32_t level = uint32_t(std::strtoul(level_text.c_str(), nullptr, 10));
+		uint32_t size = ParseCacheSize(size_text);
+
+		if (level == 1)
+			sizes.l1d = size;
+		else if (level == 2)
+			sizes.l2 = size;
+
+		if (level >= 2 && level > llc_level) {
+			llc_level = level;
+			sizes.llc = size;
+			sizes.llc_shared = ReadLine(dir + "shared_cpu_list", shared)
+				? std::max(uint32_t(ParseIdList(shared).size()), 1u) : 1;
+		}
+	}
+
+	//No sysfs (or no cache directories),
+	//assume a common desktop
+	if (sizes.l1d == 0 && sizes.l2 == 0 && sizes.llc == 0) {
+		sizes.l1d = 32 << 10;
+		sizes.l2 = 1 << 20;
+		sizes.llc = 8 << 20;
+	}
+
+	return sizes;
+}
+
+CacheSizes const& GetCacheSizes() {
+	static const CacheSizes sizes = DetectCacheSizes();
+	return sizes;
+}
+
+static std::vector<uint32_t> DetectNumaNodes() {
+	std::string online;
+	std::vector<uint32_t> nodes;
+
+	if (ReadLine("/sys/devices/system/node/online", online))
+		nodes = ParseIdList(online);
+
+	//Not a NUMA kernel, everything is node 0
+	if (nodes.empty())
+		nodes.push_back(0);
+
+	return nodes;
+}
+
+std::vector<uint32_t> const& GetNumaNodes() {
+	static const std::vector<uint32_t> nodes = DetectNumaNodes();
+	return nodes;
+}
+
+//Every row of both matrices must start on the boundary
+static bool IsAligned(MatType const* M, MatType const* T, uint32_t lda, uint32_t ldb,
+	uint32_t alignment) {
+	const uint32_t ELEMS = alignment / sizeof(MatType);
+
+	return (unsigned long long)(M) % alignment == 0 && (unsigned long long)(T) % alignment == 0
+		&& lda % ELEMS == 0 && ldb % ELEMS == 0;
+}
+
+//Register tile must divide the block, otherwise
+//fall back to the narrower kernel
+static uint32_t SelectRegisterTile(uint32_t BLOCK_SIZE) {
+	SimdLevel level = GetSimdLevel();
+
+	if (level == SimdLevel::AVX512 && BLOCK_SIZE % 16 == 0)
+		return 16;
+
+	if (level != SimdLevel::SSE && BLOCK_SIZE % 8 == 0)
+		return 8;
+
+	return 4;
+}
+
+template <bool Aligned>
+BlockTransposeFunc SelectBlockTranspose(uint32_t BLOCK_SIZE) {
+	switch (SelectRegisterTile(BLOCK_SIZE)) {
+	case 16:
+		return BlockTranspose_AVX512<Aligned>;
+	case 8:
+		return BlockTranspose_AVX2<Aligned>;
+	default:
+		return BlockTranspose_SSE<Aligned>;
+	}
+}
+
+template BlockTransposeFunc SelectBlockTranspose<true>(uint32_t BLOCK_SIZE);
+template BlockTransposeFunc SelectBlockTranspose<false>(uint32_t BLOCK_SIZE);
+
+template <bool Aligned>
+BlockTransposeOMPFunc SelectBlockTransposeOMP(uint32_t BLOCK_SIZE) {
+	switch (SelectRegisterTile(BLOCK_SIZE)) {
+	case 16:
+		return BlockTranspose_AVX512_OMP<Aligned>;
+	case 8:
+		return BlockTranspose_AVX2_OMP<Aligned>;
+	default:
+		return BlockTranspose_SSE_OMP<Aligned>;
+	}
+}
+
+template BlockTransposeOMPFunc SelectBlockTransposeOMP<true>(uint32_t BLOCK_SIZE);
+template BlockTransposeOMPFunc SelectBlockTransposeOMP<false>(uint32_t BLOCK_SIZE);
+
+//Width of the register of the kernel picked above
+static bool IsTileAligned(MatType const* M, MatType const* T, uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE) {
+	return IsAligned(M, T, lda, ldb, SelectRegisterTile(BLOCK_SIZE) * sizeof(MatType));
+}
+
+BlockTransposeFunc SelectBlockTranspose(MatType const* M, MatType const* T,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE) {
+	if (IsTileAligned(M, T, lda, ldb, BLOCK_SIZE))
+		return SelectBlockTranspose<true>(BLOCK_SIZE);
+	return SelectBlockTranspose<false>(BLOCK_SIZE);
+}
+
+BlockTransposeOMPFunc SelectBlockTransposeOMP(MatType const* M, MatType const* T,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE) {
+	if (IsTileAligned(M, T, lda, ldb, BLOCK_SIZE))
+		return SelectBlockTransposeOMP<true>(BLOCK_SIZE);
+	return SelectBlockTransposeOMP<false>(BLOCK_SIZE);
+}
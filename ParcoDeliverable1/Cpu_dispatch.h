@@ -0,0 +1,134 @@
+#ifndef PARCO_CPU_DISPATCH
+#define PARCO_CPU_DISPATCH
+
+#include "Defs.h"
+
+#include <vector>
+
+/// <summary>
+/// Widest vector extension that
+/// the transpose kernels can use
+/// </summary>
+enum class SimdLevel : uint32_t {
+	SSE = 0,
+	AVX2 = 1,
+	AVX512 = 2
+};
+
+/// <summary>
+/// Features reported by CPUID, already
+/// filtered by what the OS saves on
+/// context switch (XCR0)
+/// </summary>
+struct CpuFeatures {
+	bool sse41;
+	bool avx2;
+	bool avx512f;
+};
+
+/// <summary>
+/// Runs CPUID once and caches the result
+/// </summary>
+/// <returns>Supported features</returns>
+CpuFeatures const& GetCpuFeatures();
+
+/// <summary>
+/// Returns the widest SIMD level available.
+/// The environment variable PARCO_SIMD (sse, avx2, avx512)
+/// can be used to cap the level, which is useful
+/// to benchmark the narrower kernels on
+/// the same machine
+/// </summary>
+/// <returns>Selected level</returns>
+SimdLevel GetSimdLevel();
+
+/// <summary>
+/// Human readable name of the level
+/// </summary>
+/// <param name="level">The level</param>
+/// <returns>Name</returns>
+const char* SimdLevelName(SimdLevel level);
+
+/// <summary>
+/// Data cache sizes in bytes, 0 if the level is missing
+/// </summary>
+struct CacheSizes {
+	uint32_t l1d;
+	uint32_t l2;
+	//Last level cache and number of cpus sharing it
+	uint32_t llc;
+	uint32_t llc_shared;
+};
+
+/// <summary>
+/// Reads the cache sizes of cpu0 from sysfs once and
+/// caches the result. Falls back to 32K L1, 1M L2, 8M LLC
+/// if sysfs does not list any cache
+/// </summary>
+/// <returns>Cache sizes</returns>
+CacheSizes const& GetCacheSizes();
+
+/// <summary>
+/// Online NUMA nodes, read from sysfs once.
+/// Contains only node 0 on a single node machine
+/// </summary>
+/// <returns>Node ids</returns>
+std::vector<uint32_t> const& GetNumaNodes();
+
+using BlockTransposeFunc = void(*)(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE);
+
+//OMP kernels also take the threads of their
+//parallel region (0 = OpenMP default)
+using BlockTransposeOMPFunc = void(*)(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE, uint32_t threads);
+
+/// <summary>
+/// Selects the widest blocked transpose
+/// whose register tile divides BLOCK_SIZE,
+/// and its aligned version if both matrices
+/// and leading dimensions are aligned to
+/// the width of the register
+/// </summary>
+/// <param name="M">Source matrix</param>
+/// <param name="T">Dest matrix</param>
+/// <param name="lda">Leading dimension of M</param>
+/// <param name="ldb">Leading dimension of T</param>
+/// <param name="BLOCK_SIZE">Block size, must be a multiple of 4</param>
+/// <returns>The kernel</returns>
+BlockTransposeFunc SelectBlockTranspose(MatType const* M, MatType const* T,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE);
+
+/// <summary>
+/// Same as above, with the alignment known by the caller
+/// instead of checked on the pointers. Aligned means that
+/// every row starts on a 64 byte boundary (see MatrixView),
+/// which is enough for all the kernels
+/// </summary>
+/// <param name="BLOCK_SIZE">Block size, must be a multiple of 4</param>
+/// <returns>The kernel</returns>
+template <bool Aligned>
+BlockTransposeFunc SelectBlockTranspose(uint32_t BLOCK_SIZE);
+
+/// <summary>
+/// OMP version of SelectBlockTranspose
+/// </summary>
+/// <param name="M">Source matrix</param>
+/// <param name="T">Dest matrix</param>
+/// <param name="lda">Leading dimension of M</param>
+/// <param name="ldb">Leading dimension of T</param>
+/// <param name="BLOCK_SIZE">Block size, must be a multiple of 4</param>
+/// <returns>The kernel</returns>
+BlockTransposeOMPFunc SelectBlockTransposeOMP(MatType const* M, MatType const* T,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE);
+
+/// <summary>
+/// OMP version of SelectBlockTranspose, alignment
+/// known by the caller
+/// </summary>
+/// <param name="BLOCK_SIZE">Block size, must be a multiple of 4</param>
+/// <returns>The kernel</returns>
+template <bool Aligned>
+BlockTransposeOMPFunc SelectBlockTransposeOMP(uint32_t BLOCK_SIZE);
+
+#endif // !PARCO_CPU_DISPATCH
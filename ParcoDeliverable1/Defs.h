@@ -7,12 +7,18 @@
 //type used in the program
 using MatType = float;
 
-using Matrix = float*;
-
 //Max value generated by the rand()
 static constexpr MatType VALUE_MAX = 9.0f;
 
 static constexpr uint32_t CACHE_LINE_SIZE = 64;
 static constexpr uint32_t RECOMMENDED_BLOCK_SZ = CACHE_LINE_SIZE / sizeof(MatType);
 
+//Block size used with streaming stores, must be a multiple
+//of one cache line of elements (see Transpose4x16_Stream)
+static constexpr uint32_t STREAM_BLOCK_SZ = RECOMMENDED_BLOCK_SZ * 4;
+
+//Matrix size (in bytes) after which matTransposeFinal
+//switches to streaming stores (8192x8192 floats)
+static constexpr uint64_t STREAM_THRESHOLD_BYTES = uint64_t(256) << 20;
+
 #endif // !PARCO_DEFS
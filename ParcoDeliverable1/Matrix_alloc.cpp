@@ -0,0 +1,291 @@
+#include "Matrix_alloc.h"
+#include "Cpu_dispatch.h"
+#include "Matrix_utils.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <omp.h>
+
+static constexpr size_t PAGE_SIZE_4K = size_t(4) << 10;
+static constexpr size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+static size_t RoundUp(size_t value, size_t step) {
+	return (value + step - 1) / step * step;
+}
+
+//Every mapping is remembered, munmap needs its length.
+//Small buffers come from the heap and have length 0
+struct Mapping {
+	size_t length;
+	HugePages pages;
+};
+
+struct MappingRegistry {
+	std::mutex mutex;
+	std::unordered_map<void const*, Mapping> mappings;
+};
+
+static MappingRegistry& GetRegistry() {
+	static MappingRegistry registry;
+	return registry;
+}
+
+static void* MapAnonymous(size_t length, int extra_flags) {
+	void* addr = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | extra_flags, -1, 0);
+
+	return addr == MAP_FAILED ? nullptr : addr;
+}
+
+//mmap only guarantees 4K alignment, map one huge page
+//more than needed and cut the unaligned head and tail,
+//otherwise the kernel cannot use a huge page for the
+//first and last 2 MB of the matrix
+static void* MapHugeAligned(size_t length) {
+	size_t total = length + HUGE_PAGE_SIZE;
+	char* base = static_cast<char*>(MapAnonymous(total, 0));
+
+	if (base == nullptr)
+		return nullptr;
+
+	char* aligned = reinterpret_cast<char*>(RoundUp(reinterpret_cast<size_t>(base), HUGE_PAGE_SIZE));
+
+	if (aligned != base)
+		munmap(base, aligned - base);
+
+	if (aligned + length != base + total)
+		munmap(aligned + length, (base + total) - (aligned + length));
+
+	madvise(aligned, length, MADV_HUGEPAGE);
+
+	return aligned;
+}
+
+//Placement is a hint: RowBands only prefers a node, so a
+//full node spills to the others, and if the kernel refuses
+//the policy the pages simply go where they are first touched
+static void BindPages(void* addr, size_t length, int mode, std::vector<uint32_t> const& nodes) {
+	const size_t BITS = sizeof(unsigned long) * 8;
+
+	uint32_t max_node = *std::max_element(nodes.begin(), nodes.end());
+	std::vector<unsigned long> mask(max_node / BITS + 1, 0);
+
+	for (uint32_t node : nodes)
+		mask[node / BITS] |= 1UL << (node % BITS);
+
+	//The kernel reads maxnode - 1 bits
+	syscall(SYS_mbind, addr, length, mode, mask.data(), mask.size() * BITS + 1, 0);
+}
+
+//Band of rows of each node, boundaries rounded down to
+//pages so that each page belongs to a single band
+static void BindRowBands(void* M, size_t row_bytes, uint32_t rows, size_t length, size_t page) {
+	std::vector<uint32_t> const& nodes = GetNumaNodes();
+	const size_t N_NODES = nodes.size();
+
+	char* base = reinterpret_cast<char*>(M);
+	size_t band_begin = 0;
+
+	for (size_t band = 0; band < N_NODES; band++) {
+		size_t band_end = (band + 1 == N_NODES) ? length
+			: row_bytes * (size_t(rows) * (band + 1) / N_NODES) / page * page;
+
+		band_end = std::min(band_end, length);
+
+		if (band_end > band_begin)
+			BindPages(base + band_begin, band_end - band_begin, MPOL_PREFERRED,
+				std::vector<uint32_t>{ nodes[band] });
+
+		band_begin = band_end;
+	}
+}
+
+//Block of the OMP transposes for a rows x cols MatType
+//matrix, as in TransposeBlocked: the best divisor when it
+//fits the register tiles, one cache line otherwise
+static uint32_t KernelBlockSize(uint32_t rows, uint32_t cols) {
+	uint32_t block = ComputeBlockSize(rows, cols, CACHE_LINE_SIZE);
+	return block % 4 == 0 ? block : RECOMMENDED_BLOCK_SZ;
+}
+
+//Zero the matrix, this is what actually
+//allocates the physical pages
+static void TouchPages(void* M, uint32_t rows, size_t row_bytes, NumaPolicy numa, uint32_t threads) {
+	char* bytes = static_cast<char*>(M);
+
+	if (numa == NumaPolicy::None) {
+		std::memset(bytes, 0, row_bytes * rows);
+		return;
+	}
+
+	int n_threads = threads != 0 ? int(threads) : omp_get_max_threads();
+
+	//Same loops as BlockTranspose_SSE_OMP, so every thread
+	//touches the parts of a source matrix it will read. The
+	//destination is written by rows instead, for it the touch
+	//only spreads the pages over the team. Buffers of other
+	//element types are split as if they held MatType
+	const uint32_t COLS = uint32_t(row_bytes / sizeof(MatType));
+	const uint32_t BLOCK_SIZE = KernelBlockSize(rows, std::max<uint32_t>(COLS, 1));
+	const size_t BLOCK_BYTES = size_t(BLOCK_SIZE) * sizeof(MatType);
+
+#pragma omp parallel num_threads(n_threads)
+	for (uint32_t row_idx = 0; row_idx < rows; row_idx += BLOCK_SIZE) {
+		const uint32_t ROW_BOUND = std::min(row_idx + BLOCK_SIZE, rows);
+
+#pragma omp for schedule(static)
+		for (size_t col_byte = 0; col_byte < row_bytes; col_byte += BLOCK_BYTES) {
+			const size_t WIDTH = std::min(BLOCK_BYTES, row_bytes - col_byte);
+
+			for (uint32_t row_block = row_idx; row_block < ROW_BOUND; row_block++)
+				std::memset(bytes + row_bytes * row_block + col_byte, 0, WIDTH);
+		}
+	}
+}
+
+MatrixAllocOptions DefaultAllocOptions() {
+	MatrixAllocOptions options{ HugePages::Transparent, NumaPolicy::FirstTouch, 0 };
+
+	const char* huge_pages = std::getenv("PARCO_HUGE_PAGES");
+
+	if (huge_pages != nullptr) {
+		if (std::strcmp(huge_pages, "none") == 0)
+			options.huge_pages = HugePages::None;
+		else if (std::strcmp(huge_pages, "explicit") == 0)
+			options.huge_pages = HugePages::Explicit;
+	}
+
+	const char* numa = std::getenv("PARCO_NUMA");
+
+	if (numa != nullptr) {
+		if (std::strcmp(numa, "none") == 0)
+			options.numa = NumaPolicy::None;
+		else if (std::strcmp(numa, "interleave") == 0)
+			options.numa = NumaPolicy::Interleave;
+		else if (std::strcmp(numa, "bands") == 0)
+			options.numa = NumaPolicy::RowBands;
+	}
+
+	return options;
+}
+
+//Below one huge page a mapping (at least 4K, 2 MB with
+//huge pages) wastes most of its memory and millions of
+//them hit vm.max_map_count, so small matrices come from
+//the heap, zeroed by the caller only
+static void* AllocateSmall(size_t bytes) {
+	const size_t ALIGNMENT = bytes >= PAGE_SIZE_4K ? PAGE_SIZE_4K : CACHE_LINE_SIZE;
+	void* addr = nullptr;
+
+	if (posix_memalign(&addr, ALIGNMENT, RoundUp(bytes, CACHE_LINE_SIZE)) != 0)
+		return nullptr;
+
+	std::memset(addr, 0, bytes);
+
+	MappingRegistry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	registry.mappings[addr] = Mapping{ 0, HugePages::None };
+
+	return addr;
+}
+
+void* AllocateBuffer(uint32_t rows, size_t row_bytes, MatrixAllocOptions const& options) {
+	const size_t BYTES = std::max<size_t>(row_bytes * rows, 1);
+
+	if (BYTES < HUGE_PAGE_SIZE)
+		return AllocateSmall(BYTES);
+
+	HugePages pages = options.huge_pages;
+	void* addr = nullptr;
+	size_t length = 0;
+
+	if (pages == HugePages::Explicit) {
+		length = RoundUp(BYTES, HUGE_PAGE_SIZE);
+		addr = MapAnonymous(length, MAP_HUGETLB);
+
+		if (addr == nullptr)
+			pages = HugePages::Transparent;
+	}
+
+	if (pages == HugePages::Transparent) {
+		length = RoundUp(BYTES, HUGE_PAGE_SIZE);
+		addr = MapHugeAligned(length);
+	}
+	else if (pages == HugePages::None) {
+		length = RoundUp(BYTES, PAGE_SIZE_4K);
+		addr = MapAnonymous(length, 0);
+	}
+
+	if (addr == nullptr)
+		return nullptr;
+
+	//Policies are set before the first touch,
+	//they do not move pages that already exist
+	std::vector<uint32_t> const& nodes = GetNumaNodes();
+
+	if (nodes.size() > 1) {
+		if (options.numa == NumaPolicy::Interleave)
+			BindPages(addr, length, MPOL_INTERLEAVE, nodes);
+		else if (options.numa == NumaPolicy::RowBands)
+			BindRowBands(addr, row_bytes, rows, length,
+				pages == HugePages::None ? PAGE_SIZE_4K : HUGE_PAGE_SIZE);
+	}
+
+	TouchPages(addr, rows, row_bytes, options.numa, options.threads);
+
+	MappingRegistry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	registry.mappings[addr] = Mapping{ length, pages };
+
+	return addr;
+}
+
+MatType* AllocateMatrix(uint32_t rows, uint32_t cols, MatrixAllocOptions const& options) {
+	return static_cast<MatType*>(AllocateBuffer(rows, size_t(cols) * sizeof(MatType), options));
+}
+
+MatType* AllocateMatrix(uint32_t N) {
+	return AllocateMatrix(N, N, DefaultAllocOptions());
+}
+
+void FreeMatrix(void* M) {
+	if (M == nullptr)
+		return;
+
+	MappingRegistry& registry = GetRegistry();
+	Mapping mapping{};
+
+	{
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		auto found = registry.mappings.find(M);
+
+		if (found == registry.mappings.end())
+			return;
+
+		mapping = found->second;
+		registry.mappings.erase(found);
+	}
+
+	if (mapping.length == 0)
+		std::free(M);
+	else
+		munmap(M, mapping.length);
+}
+
+HugePages GetMatrixHugePages(void const* M) {
+	MappingRegistry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	auto found = registry.mappings.find(M);
+	return found != registry.mappings.end() ? found->second.pages : HugePages::None;
+}
@@ -0,0 +1,108 @@
+#ifndef PARCO_MATRIX_ALLOC
+#define PARCO_MATRIX_ALLOC
+
+#include "Defs.h"
+
+#include <cstddef>
+
+/// <summary>
+/// Page size used to back a matrix
+/// </summary>
+enum class HugePages : uint32_t {
+	//Normal 4K pages
+	None = 0,
+	//2 MB aligned and marked with madvise, so that
+	//transparent huge pages are used when the
+	//kernel has them in "madvise" or "always" mode
+	Transparent = 1,
+	//MAP_HUGETLB, needs pages reserved with
+	//vm.nr_hugepages. Falls back to Transparent
+	//when there are not enough of them
+	Explicit = 2
+};
+
+/// <summary>
+/// Where the pages of a matrix are placed
+/// </summary>
+enum class NumaPolicy : uint32_t {
+	//Zeroed by the calling thread, so every page
+	//lands on its node
+	None = 0,
+	//Zeroed the way the OMP transposes read their
+	//source: by block rows, the column blocks of each
+	//split with schedule(static) over the team
+	FirstTouch = 1,
+	//Pages round robin on all the nodes
+	Interleave = 2,
+	//Rows split in one contiguous band per node,
+	//preferred (not required) for the band
+	RowBands = 3
+};
+
+/// <summary>
+/// Options of AllocateMatrix
+/// </summary>
+struct MatrixAllocOptions {
+	HugePages huge_pages;
+	NumaPolicy numa;
+	//Threads that touch the pages (0 = OpenMP default)
+	uint32_t threads;
+};
+
+/// <summary>
+/// Returns the options used by the benchmarks:
+/// transparent huge pages and first touch, unless
+/// changed by PARCO_HUGE_PAGES (none, thp, explicit)
+/// or PARCO_NUMA (none, first_touch, interleave, bands)
+/// </summary>
+/// <returns>Options</returns>
+MatrixAllocOptions DefaultAllocOptions();
+
+/// <summary>
+/// Allocates a zeroed rows x cols matrix. Matrices of at
+/// least 2 MB are mapped with the given page size and
+/// placement and are page aligned (2 MB with huge pages),
+/// smaller ones come from the heap, 4K aligned from 4K and
+/// 64 byte aligned below, and ignore the options. Either way
+/// they can be used by the aligned kernels with any lda
+/// that is a multiple of the register width
+/// </summary>
+/// <param name="rows">Rows</param>
+/// <param name="cols">Columns (row length in elements)</param>
+/// <param name="options">Page size and placement</param>
+/// <returns>The matrix, nullptr if the memory could not be mapped</returns>
+MatType* AllocateMatrix(uint32_t rows, uint32_t cols, MatrixAllocOptions const& options);
+
+/// <summary>
+/// Same as AllocateMatrix(N, N, DefaultAllocOptions())
+/// </summary>
+/// <param name="N">N rows and columns</param>
+/// <returns>The matrix</returns>
+MatType* AllocateMatrix(uint32_t N);
+
+/// <summary>
+/// Untyped version of AllocateMatrix, used by
+/// the Matrix class for other element types
+/// </summary>
+/// <param name="rows">Rows</param>
+/// <param name="row_bytes">Length of a row in bytes</param>
+/// <param name="options">Page size and placement</param>
+/// <returns>The buffer, nullptr if the memory could not be mapped</returns>
+void* AllocateBuffer(uint32_t rows, size_t row_bytes, MatrixAllocOptions const& options);
+
+/// <summary>
+/// Releases a matrix returned by AllocateMatrix
+/// or AllocateBuffer, nullptr is ignored
+/// </summary>
+/// <param name="M">The matrix</param>
+void FreeMatrix(void* M);
+
+/// <summary>
+/// Page size that actually backs the matrix
+/// (Explicit can fall back to Transparent)
+/// </summary>
+/// <param name="M">A matrix returned by AllocateMatrix</param>
+/// <returns>Page size</returns>
+HugePages GetMatrixHugePages(void const* M);
+
+#endif // !PARCO_MATRIX_ALLOC
@@ -0,0 +1,165 @@
+//This translation unit is compiled with -mavx2,
+//nothing in here may be called before checking
+//that the CPU supports AVX2 (see Cpu_dispatch.h)
+
+#include "Matrix_utils.h"
+
+#include <immintrin.h>
+
+#include <omp.h>
+
+//Transposes the 8 rows in place
+static inline void Transpose8x8_Regs(__m256& r0, __m256& r1, __m256& r2, __m256& r3,
+	__m256& r4, __m256& r5, __m256& r6, __m256& r7) {
+	__m256 t0{}, t1{}, t2{}, t3{}, t4{}, t5{}, t6{}, t7{};
+	__m256 s0{}, s1{}, s2{}, s3{}, s4{}, s5{}, s6{}, s7{};
+
+	/*
+	Same idea as Transpose4x4, but in three steps,
+	since AVX shuffles cannot cross the two 128 bit lanes:
+	1) Interleave pairs of rows:
+		r0 = 0 1 2 3 | 4 5 6 7
+		r1 = 8 9 a b | c d e f
+		t0 = 0 8 1 9 | 4 c 5 d
+		t1 = 2 a 3 b | 6 e 7 f
+	2) Select 64 bit pairs from two interleaved
+		rows, which gives a 4x4 transpose
+		inside each 128 bit lane
+	3) Swap the lanes with permute2f128: the low lane
+		of rows 0-3 and of rows 4-7 make the
+		first 4 transposed rows, the high lanes make
+		the last 4
+	*/
+	t0 = _mm256_unpacklo_ps(r0, r1);
+	t1 = _mm256_unpackhi_ps(r0, r1);
+	t2 = _mm256_unpacklo_ps(r2, r3);
+	t3 = _mm256_unpackhi_ps(r2, r3);
+	t4 = _mm256_unpacklo_ps(r4, r5);
+	t5 = _mm256_unpackhi_ps(r4, r5);
+	t6 = _mm256_unpacklo_ps(r6, r7);
+	t7 = _mm256_unpackhi_ps(r6, r7);
+
+	s0 = _mm256_shuffle_ps(t0, t2, 0b01000100);
+	s1 = _mm256_shuffle_ps(t0, t2, 0b11101110);
+	s2 = _mm256_shuffle_ps(t1, t3, 0b01000100);
+	s3 = _mm256_shuffle_ps(t1, t3, 0b11101110);
+	s4 = _mm256_shuffle_ps(t4, t6, 0b01000100);
+	s5 = _mm256_shuffle_ps(t4, t6, 0b11101110);
+	s6 = _mm256_shuffle_ps(t5, t7, 0b01000100);
+	s7 = _mm256_shuffle_ps(t5, t7, 0b11101110);
+
+	r0 = _mm256_permute2f128_ps(s0, s4, 0x20);
+	r1 = _mm256_permute2f128_ps(s1, s5, 0x20);
+	r2 = _mm256_permute2f128_ps(s2, s6, 0x20);
+	r3 = _mm256_permute2f128_ps(s3, s7, 0x20);
+	r4 = _mm256_permute2f128_ps(s0, s4, 0x31);
+	r5 = _mm256_permute2f128_ps(s1, s5, 0x31);
+	r6 = _mm256_permute2f128_ps(s2, s6, 0x31);
+	r7 = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+void Transpose8x8(MatType const* src, MatType* dst,
+	uint32_t row, uint32_t col, uint32_t lda, uint32_t ldb) {
+	__m256 r0 = _mm256_loadu_ps(&src[size_t(row) * lda + col]);
+	__m256 r1 = _mm256_loadu_ps(&src[size_t(row + 1) * lda + col]);
+	__m256 r2 = _mm256_loadu_ps(&src[size_t(row + 2) * lda + col]);
+	__m256 r3 = _mm256_loadu_ps(&src[size_t(row + 3) * lda + col]);
+	__m256 r4 = _mm256_loadu_ps(&src[size_t(row + 4) * lda + col]);
+	__m256 r5 = _mm256_loadu_ps(&src[size_t(row + 5) * lda + col]);
+	__m256 r6 = _mm256_loadu_ps(&src[size_t(row + 6) * lda + col]);
+	__m256 r7 = _mm256_loadu_ps(&src[size_t(row + 7) * lda + col]);
+
+	Transpose8x8_Regs(r0, r1, r2, r3, r4, r5, r6, r7);
+
+	_mm256_storeu_ps(&dst[size_t(col) * ldb + row], r0);
+	_mm256_storeu_ps(&dst[size_t(col + 1) * ldb + row], r1);
+	_mm256_storeu_ps(&dst[size_t(col + 2) * ldb + row], r2);
+	_mm256_storeu_ps(&dst[size_t(col + 3) * ldb + row], r3);
+	_mm256_storeu_ps(&dst[size_t(col + 4) * ldb + row], r4);
+	_mm256_storeu_ps(&dst[size_t(col + 5) * ldb + row], r5);
+	_mm256_storeu_ps(&dst[size_t(col + 6) * ldb + row], r6);
+	_mm256_storeu_ps(&dst[size_t(col + 7) * ldb + row], r7);
+}
+
+void Transpose8x8_Aligned(MatType const* src, MatType* dst,
+	uint32_t row, uint32_t col, uint32_t lda, uint32_t ldb) {
+	__m256 r0 = _mm256_load_ps(&src[size_t(row) * lda + col]);
+	__m256 r1 = _mm256_load_ps(&src[size_t(row + 1) * lda + col]);
+	__m256 r2 = _mm256_load_ps(&src[size_t(row + 2) * lda + col]);
+	__m256 r3 = _mm256_load_ps(&src[size_t(row + 3) * lda + col]);
+	__m256 r4 = _mm256_load_ps(&src[size_t(row + 4) * lda + col]);
+	__m256 r5 = _mm256_load_ps(&src[size_t(row + 5) * lda + col]);
+	__m256 r6 = _mm256_load_ps(&src[size_t(row + 6) * lda + col]);
+	__m256 r7 = _mm256_load_ps(&src[size_t(row + 7) * lda + col]);
+
+	Transpose8x8_Regs(r0, r1, r2, r3, r4, r5, r6, r7);
+
+	_mm256_store_ps(&dst[size_t(col) * ldb + row], r0);
+	_mm256_store_ps(&dst[size_t(col + 1) * ldb + row], r1);
+	_mm256_store_ps(&dst[size_t(col + 2) * ldb + row], r2);
+	_mm256_store_ps(&dst[size_t(col + 3) * ldb + row], r3);
+	_mm256_store_ps(&dst[size_t(col + 4) * ldb + row], r4);
+	_mm256_store_ps(&dst[size_t(col + 5) * ldb + row], r5);
+	_mm256_store_ps(&dst[size_t(col + 6) * ldb + row], r6);
+	_mm256_store_ps(&dst[size_t(col + 7) * ldb + row], r7);
+}
+
+//Same loops as BlockTranspose_SSE, with the
+//register tile as template parameter
+template <void(*Kernel)(MatType const*, MatType*, uint32_t, uint32_t, uint32_t, uint32_t)>
+static void BlockTransposeAVX2_Impl(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE) {
+	for (uint32_t row_idx = 0; row_idx < rows; row_idx += BLOCK_SIZE) {
+		for (uint32_t col_idx = 0; col_idx < cols; col_idx += BLOCK_SIZE) {
+
+			for (uint32_t row_block = row_idx; row_block < row_idx + BLOCK_SIZE; row_block += 8) {
+				for (uint32_t col_block = col_idx; col_block < col_idx + BLOCK_SIZE; col_block += 8) {
+					Kernel(M, T, row_block, col_block, lda, ldb);
+				}
+			}
+
+		}
+	}
+}
+
+template <void(*Kernel)(MatType const*, MatType*, uint32_t, uint32_t, uint32_t, uint32_t)>
+static void BlockTransposeAVX2_OMP_Impl(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE, uint32_t threads) {
+#pragma omp parallel num_threads(OmpThreads(threads))
+	for (uint32_t row_idx = 0; row_idx < rows; row_idx += BLOCK_SIZE) {
+#pragma omp for collapse(2) schedule(auto)
+		for (uint32_t col_idx = 0; col_idx < cols; col_idx += BLOCK_SIZE) {
+
+			for (uint32_t row_block = row_idx; row_block < row_idx + BLOCK_SIZE; row_block += 8) {
+				for (uint32_t col_block = col_idx; col_block < col_idx + BLOCK_SIZE; col_block += 8) {
+					Kernel(M, T, row_block, col_block, lda, ldb);
+				}
+			}
+
+		}
+	}
+}
+
+template <>
+void BlockTranspose_AVX2<true>(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE) {
+	BlockTransposeAVX2_Impl<Transpose8x8_Aligned>(M, T, rows, cols, lda, ldb, BLOCK_SIZE);
+}
+
+template <>
+void BlockTranspose_AVX2<false>(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE) {
+	BlockTransposeAVX2_Impl<Transpose8x8>(M, T, rows, cols, lda, ldb, BLOCK_SIZE);
+}
+
+template <>
+void BlockTranspose_AVX2_OMP<true>(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE, uint32_t threads) {
+	BlockTransposeAVX2_OMP_Impl<Transpose8x8_Aligned>(M, T, rows, cols, lda, ldb, BLOCK_SIZE, threads);
+}
+
+template <>
+void BlockTranspose_AVX2_OMP<false>(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE, uint32_t threads) {
+	BlockTransposeAVX2_OMP_Impl<Transpose8x8>(M, T, rows, cols, lda, ldb, BLOCK_SIZE, threads);
+}
@@ -0,0 +1,134 @@
+//This translation unit is compiled with -mavx512f,
+//nothing in here may be called before checking
+//that the CPU supports AVX-512F (see Cpu_dispatch.h)
+
+#include "Matrix_utils.h"
+
+#include <immintrin.h>
+
+#include <omp.h>
+
+//Transposes the 16 rows in place
+static inline void Transpose16x16_Regs(__m512* r) {
+	__m512 t[16];
+
+	/*
+	Extension of Transpose8x8_Regs to four 128 bit lanes:
+	1) unpacklo/hi interleave pairs of rows
+	2) shuffle_ps selects 64 bit pairs, giving a 4x4
+		transpose inside each lane
+	3) Two rounds of shuffle_f32x4 move the 4x4 lanes
+		to their transposed position.
+		0x88 selects lanes 0,2 of each source,
+		0xdd selects lanes 1,3
+	*/
+	for (uint32_t idx = 0; idx < 16; idx += 2) {
+		t[idx] = _mm512_unpacklo_ps(r[idx], r[idx + 1]);
+		t[idx + 1] = _mm512_unpackhi_ps(r[idx], r[idx + 1]);
+	}
+
+	for (uint32_t idx = 0; idx < 16; idx += 4) {
+		r[idx] = _mm512_shuffle_ps(t[idx], t[idx + 2], 0b01000100);
+		r[idx + 1] = _mm512_shuffle_ps(t[idx], t[idx + 2], 0b11101110);
+		r[idx + 2] = _mm512_shuffle_ps(t[idx + 1], t[idx + 3], 0b01000100);
+		r[idx + 3] = _mm512_shuffle_ps(t[idx + 1], t[idx + 3], 0b11101110);
+	}
+
+	for (uint32_t idx = 0; idx < 4; idx++) {
+		t[idx] = _mm512_shuffle_f32x4(r[idx], r[idx + 4], 0x88);
+		t[idx + 4] = _mm512_shuffle_f32x4(r[idx], r[idx + 4], 0xdd);
+		t[idx + 8] = _mm512_shuffle_f32x4(r[idx + 8], r[idx + 12], 0x88);
+		t[idx + 12] = _mm512_shuffle_f32x4(r[idx + 8], r[idx + 12], 0xdd);
+	}
+
+	for (uint32_t idx = 0; idx < 8; idx++) {
+		r[idx] = _mm512_shuffle_f32x4(t[idx], t[idx + 8], 0x88);
+		r[idx + 8] = _mm512_shuffle_f32x4(t[idx], t[idx + 8], 0xdd);
+	}
+}
+
+void Transpose16x16(MatType const* src, MatType* dst,
+	uint32_t row, uint32_t col, uint32_t lda, uint32_t ldb) {
+	__m512 r[16];
+
+	//Constant trip count, the compiler unrolls
+	//these and keeps everything in zmm registers
+	for (uint32_t idx = 0; idx < 16; idx++)
+		r[idx] = _mm512_loadu_ps(&src[size_t(row + idx) * lda + col]);
+
+	Transpose16x16_Regs(r);
+
+	for (uint32_t idx = 0; idx < 16; idx++)
+		_mm512_storeu_ps(&dst[size_t(col + idx) * ldb + row], r[idx]);
+}
+
+void Transpose16x16_Aligned(MatType const* src, MatType* dst,
+	uint32_t row, uint32_t col, uint32_t lda, uint32_t ldb) {
+	__m512 r[16];
+
+	for (uint32_t idx = 0; idx < 16; idx++)
+		r[idx] = _mm512_load_ps(&src[size_t(row + idx) * lda + col]);
+
+	Transpose16x16_Regs(r);
+
+	for (uint32_t idx = 0; idx < 16; idx++)
+		_mm512_store_ps(&dst[size_t(col + idx) * ldb + row], r[idx]);
+}
+
+template <void(*Kernel)(MatType const*, MatType*, uint32_t, uint32_t, uint32_t, uint32_t)>
+static void BlockTransposeAVX512_Impl(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE) {
+	for (uint32_t row_idx = 0; row_idx < rows; row_idx += BLOCK_SIZE) {
+		for (uint32_t col_idx = 0; col_idx < cols; col_idx += BLOCK_SIZE) {
+
+			for (uint32_t row_block = row_idx; row_block < row_idx + BLOCK_SIZE; row_block += 16) {
+				for (uint32_t col_block = col_idx; col_block < col_idx + BLOCK_SIZE; col_block += 16) {
+					Kernel(M, T, row_block, col_block, lda, ldb);
+				}
+			}
+
+		}
+	}
+}
+
+template <void(*Kernel)(MatType const*, MatType*, uint32_t, uint32_t, uint32_t, uint32_t)>
+static void BlockTransposeAVX512_OMP_Impl(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE, uint32_t threads) {
+#pragma omp parallel num_threads(OmpThreads(threads))
+	for (uint32_t row_idx = 0; row_idx < rows; row_idx += BLOCK_SIZE) {
+#pragma omp for collapse(2) schedule(auto)
+		for (uint32_t col_idx = 0; col_idx < cols; col_idx += BLOCK_SIZE) {
+
+			for (uint32_t row_block = row_idx; row_block < row_idx + BLOCK_SIZE; row_block += 16) {
+				for (uint32_t col_block = col_idx; col_block < col_idx + BLOCK_SIZE; col_block += 16) {
+					Kernel(M, T, row_block, col_block, lda, ldb);
+				}
+			}
+
+		}
+	}
+}
+
+template <>
+void BlockTranspose_AVX512<true>(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE) {
+	BlockTransposeAVX512_Impl<Transpose16x16_Aligned>(M, T, rows, cols, lda, ldb, BLOCK_SIZE);
+}
+
+template <>
+void BlockTranspose_AVX512<false>(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE) {
+	BlockTransposeAVX512_Impl<Transpose16x16>(M, T, rows, cols, lda, ldb, BLOCK_SIZE);
+}
+
+template <>
+void BlockTranspose_AVX512_OMP<true>(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE, uint32_t threads) {
+	BlockTransposeAVX512_OMP_Impl<Transpose16x16_Aligned>(M, T, rows, cols, lda, ldb, BLOCK_SIZE, threads);
+}
+
+template <>
+void BlockTranspose_AVX512_OMP<false>(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE, uint32_t threads) {
+	BlockTransposeAVX512_OMP_Impl<Transpose16x16>(M, T, rows, cols, lda, ldb, BLOCK_SIZE, threads);
+}
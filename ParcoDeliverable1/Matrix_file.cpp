@@ -0,0 +1,328 @@
+#include "Matrix_file.h"
+#include "Matrix_manip.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr uint64_t FNV_OFFSET = 14695981039346656037ULL;
+static constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+
+//Padded row length, same rule as Matrix
+static uint32_t PaddedLd(uint32_t cols) {
+	const uint32_t ALIGN_ELEMS = VIEW_ALIGNMENT / sizeof(MatType);
+	return (cols + ALIGN_ELEMS - 1) / ALIGN_ELEMS * ALIGN_ELEMS;
+}
+
+static uint32_t TileCount(uint32_t elems, uint32_t tile) {
+	return (elems + tile - 1) / tile;
+}
+
+//Payload size implied by the header fields
+static uint64_t PayloadBytes(MatrixFileHeader const& header) {
+	switch (MatrixLayout(header.layout)) {
+	case MatrixLayout::RowMajor:
+		return uint64_t(header.rows) * header.ld * sizeof(MatType);
+	case MatrixLayout::ColMajor:
+		return uint64_t(header.cols) * header.ld * sizeof(MatType);
+	case MatrixLayout::Tiled:
+		return uint64_t(TileCount(header.rows, header.tile)) * TileCount(header.cols, header.tile)
+			* header.tile * header.tile * sizeof(MatType);
+	}
+
+	return 0;
+}
+
+static bool IsValidHeader(MatrixFileHeader const& header, uint64_t file_size) {
+	if (std::memcmp(header.magic, MATRIX_FILE_MAGIC, sizeof(MATRIX_FILE_MAGIC)) != 0
+		|| header.version != MATRIX_FILE_VERSION
+		|| header.dtype != uint32_t(MatrixDTypeOf<MatType>::value))
+		return false;
+
+	switch (MatrixLayout(header.layout)) {
+	case MatrixLayout::RowMajor:
+		if (header.ld < header.cols || header.ld % (VIEW_ALIGNMENT / sizeof(MatType)) != 0)
+			return false;
+		break;
+	case MatrixLayout::ColMajor:
+		if (header.ld < header.rows || header.ld % (VIEW_ALIGNMENT / sizeof(MatType)) != 0)
+			return false;
+		break;
+	case MatrixLayout::Tiled:
+		if (header.tile == 0)
+			return false;
+		break;
+	default:
+		return false;
+	}
+
+	return header.payload_offset >= sizeof(MatrixFileHeader)
+		&& header.payload_offset % VIEW_ALIGNMENT == 0
+		&& header.payload_bytes == PayloadBytes(header)
+		&& header.payload_offset <= file_size
+		&& header.payload_bytes <= file_size - header.payload_offset;
+}
+
+uint64_t MatrixFileChecksum(void const* data, size_t bytes) {
+	unsigned char const* ptr = static_cast<unsigned char const*>(data);
+	uint64_t hash = FNV_OFFSET;
+
+	size_t idx = 0;
+
+	for (; idx + sizeof(uint64_t) <= bytes; idx += sizeof(uint64_t)) {
+		uint64_t word;
+		std::memcpy(&word, ptr + idx, sizeof(word));
+		hash = (hash ^ word) * FNV_PRIME;
+	}
+
+	for (; idx < bytes; idx++)
+		hash = (hash ^ ptr[idx]) * FNV_PRIME;
+
+	return hash;
+}
+
+MappedMatrixFile::MappedMatrixFile() : m_mapping(nullptr), m_length(0), m_header{} {}
+
+MappedMatrixFile::MappedMatrixFile(const char* path, bool verify_checksum) : MappedMatrixFile() {
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+		return;
+
+	struct stat file_stat;
+
+	if (fstat(fd, &file_stat) != 0 || uint64_t(file_stat.st_size) < sizeof(MatrixFileHeader)) {
+		close(fd);
+		return;
+	}
+
+	m_length = size_t(file_stat.st_size);
+	void* mapping = mmap(nullptr, m_length, PROT_READ, MAP_SHARED, fd, 0);
+
+	//The mapping keeps the file alive
+	close(fd);
+
+	if (mapping == MAP_FAILED)
+		return;
+
+	m_mapping = mapping;
+	std::memcpy(&m_header, m_mapping, sizeof(m_header));
+
+	if (!IsValidHeader(m_header, m_length)) {
+		Unmap();
+		return;
+	}
+
+	if (verify_checksum) {
+		madvise(m_mapping, m_length, MADV_SEQUENTIAL);
+
+		bool matches = MatrixFileChecksum(Payload(), size_t(m_header.payload_bytes)) == m_header.checksum;
+
+		madvise(m_mapping, m_length, MADV_NORMAL);
+
+		if (!matches)
+			Unmap();
+	}
+}
+
+MappedMatrixFile::MappedMatrixFile(MappedMatrixFile&& other) : MappedMatrixFile() {
+	Swap(other);
+}
+
+MappedMatrixFile& MappedMatrixFile::operator=(MappedMatrixFile&& other) {
+	MappedMatrixFile moved(std::move(other));
+	Swap(moved);
+	return *this;
+}
+
+MappedMatrixFile::~MappedMatrixFile() {
+	Unmap();
+}
+
+void MappedMatrixFile::Swap(MappedMatrixFile& other) {
+	std::swap(m_mapping, other.m_mapping);
+	std::swap(m_length, other.m_length);
+	std::swap(m_header, other.m_header);
+}
+
+void MappedMatrixFile::Unmap() {
+	if (m_mapping != nullptr)
+		munmap(m_mapping, m_length);
+
+	m_mapping = nullptr;
+	m_length = 0;
+	m_header = MatrixFileHeader{};
+}
+
+void const* MappedMatrixFile::Payload() const {
+	return m_mapping == nullptr ? nullptr : static_cast<char const*>(m_mapping) + m_header.payload_offset;
+}
+
+MatrixView<MatType const, true> MappedMatrixFile::View() const {
+	MatType const* payload = static_cast<MatType const*>(Payload());
+
+	if (payload == nullptr)
+		return MatrixView<MatType const, true>();
+
+	switch (Layout()) {
+	case MatrixLayout::RowMajor:
+		return MatrixView<MatType const, true>(payload, m_header.rows, m_header.cols, m_header.ld);
+	case MatrixLayout::ColMajor:
+		return MatrixView<MatType const, true>(payload, m_header.cols, m_header.rows, m_header.ld);
+	default:
+		return MatrixView<MatType const, true>();
+	}
+}
+
+//Calls copy(payload offset, row, first column, columns)
+//for each row of each block of a tiled payload
+template <typename Copy>
+static void ForEachTileRow(uint32_t rows, uint32_t cols, uint32_t tile, Copy copy) {
+	const uint32_t TILES_C = TileCount(cols, tile);
+	const size_t TILE_ELEMS = size_t(tile) * tile;
+
+	for (uint32_t ti = 0; ti < TileCount(rows, tile); ti++) {
+		for (uint32_t tj = 0; tj < TILES_C; tj++) {
+			const size_t BLOCK = (size_t(ti) * TILES_C + tj) * TILE_ELEMS;
+			const uint32_t ROW0 = ti * tile;
+			const uint32_t COL0 = tj * tile;
+			const uint32_t NR = std::min(tile, rows - ROW0);
+			const uint32_t NC = std::min(tile, cols - COL0);
+
+			for (uint32_t r = 0; r < NR; r++)
+				copy(BLOCK + size_t(r) * tile, ROW0 + r, COL0, NC);
+		}
+	}
+}
+
+bool LoadMatrixFile(const char* path, Matrix<MatType>& out, bool verify_checksum) {
+	MappedMatrixFile file(path, verify_checksum);
+
+	if (!file.IsValid())
+		return false;
+
+	MatrixFileHeader const& header = file.Header();
+	Matrix<MatType> M(header.rows, header.cols);
+
+	if (!M.IsValid())
+		return false;
+
+	switch (file.Layout()) {
+	case MatrixLayout::RowMajor:
+		for (uint32_t r = 0; r < header.rows; r++)
+			std::memcpy(M.View().Row(r), file.View().Row(r), header.cols * sizeof(MatType));
+		break;
+	case MatrixLayout::ColMajor:
+		matTransposeFinal(file.View(), M.View());
+		break;
+	case MatrixLayout::Tiled:
+	{
+		MatType const* tiles = static_cast<MatType const*>(file.Payload());
+		MatrixView<MatType, true> dst = M.View();
+
+		ForEachTileRow(header.rows, header.cols, header.tile,
+			[&](size_t offset, uint32_t row, uint32_t col, uint32_t count) {
+				std::memcpy(dst.Row(row) + col, tiles + offset, count * sizeof(MatType));
+			});
+		break;
+	}
+	}
+
+	out = std::move(M);
+	return true;
+}
+
+//Creates the file, maps it and lets fill write the payload,
+//then stores the header with the checksum
+template <typename Fill>
+static bool WriteMappedFile(const char* path, MatrixFileHeader header, Fill fill) {
+	header.payload_offset = sizeof(MatrixFileHeader);
+	header.payload_bytes = PayloadBytes(header);
+
+	const size_t LENGTH = size_t(header.payload_offset + header.payload_bytes);
+
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+	if (fd < 0)
+		return false;
+
+	if (ftruncate(fd, off_t(LENGTH)) != 0) {
+		close(fd);
+		return false;
+	}
+
+	void* mapping = mmap(nullptr, LENGTH, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+	if (mapping == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+
+	char* bytes = static_cast<char*>(mapping);
+	MatType* payload = reinterpret_cast<MatType*>(bytes + header.payload_offset);
+
+	fill(payload);
+
+	header.checksum = MatrixFileChecksum(payload, size_t(header.payload_bytes));
+	std::memcpy(bytes, &header, sizeof(header));
+
+	bool ok = msync(mapping, LENGTH, MS_SYNC) == 0;
+
+	munmap(mapping, LENGTH);
+	return close(fd) == 0 && ok;
+}
+
+static MatrixFileHeader MakeHeader(uint32_t rows, uint32_t cols, MatrixLayout layout, uint32_t tile) {
+	MatrixFileHeader header{};
+
+	std::memcpy(header.magic, MATRIX_FILE_MAGIC, sizeof(MATRIX_FILE_MAGIC));
+	header.version = MATRIX_FILE_VERSION;
+	header.dtype = uint32_t(MatrixDTypeOf<MatType>::value);
+	header.layout = uint32_t(layout);
+	header.rows = rows;
+	header.cols = cols;
+
+	if (layout == MatrixLayout::Tiled)
+		header.tile = tile;
+	else
+		header.ld = PaddedLd(layout == MatrixLayout::RowMajor ? cols : rows);
+
+	return header;
+}
+
+bool WriteMatrixFile(const char* path, MatrixView<MatType const> M, MatrixLayout layout, uint32_t tile) {
+	if (layout == MatrixLayout::Tiled && tile == 0)
+		return false;
+
+	MatrixFileHeader header = MakeHeader(M.Rows(), M.Cols(), layout, tile);
+
+	return WriteMappedFile(path, header, [&](MatType* payload) {
+		switch (layout) {
+		case MatrixLayout::RowMajor:
+			for (uint32_t r = 0; r < M.Rows(); r++)
+				std::memcpy(payload + size_t(r) * header.ld, M.Row(r), M.Cols() * sizeof(MatType));
+			break;
+		case MatrixLayout::ColMajor:
+			matTransposeFinal(M, MatrixView<MatType>(payload, M.Cols(), M.Rows(), header.ld));
+			break;
+		case MatrixLayout::Tiled:
+			ForEachTileRow(M.Rows(), M.Cols(), tile,
+				[&](size_t offset, uint32_t row, uint32_t col, uint32_t count) {
+					std::memcpy(payload + offset, M.Row(row) + col, count * sizeof(MatType));
+				});
+			break;
+		}
+	});
+}
+
+bool WriteTransposedMatrixFile(const char* path, MatrixView<MatType const> M) {
+	MatrixFileHeader header = MakeHeader(M.Cols(), M.Rows(), MatrixLayout::RowMajor, 0);
+
+	return WriteMappedFile(path, header, [&](MatType* payload) {
+		matTransposeFinal(M, MatrixView<MatType>(payload, M.Cols(), M.Rows(), header.ld));
+	});
+}
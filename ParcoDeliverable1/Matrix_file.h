@@ -0,0 +1,193 @@
+#ifndef PARCO_MATRIX_FILE
+#define PARCO_MATRIX_FILE
+
+#include "Defs.h"
+#include "Matrix_view.h"
+
+#include <complex>
+#include <cstddef>
+
+/*
+Binary matrix files (.pmat). A 64 byte MatrixFileHeader,
+then the payload at payload_offset, a multiple of 64.
+Everything is stored in the byte order of the machine
+that wrote the file (little endian on x86).
+
+Payload layouts of a rows x cols matrix:
+- RowMajor: rows rows of ld elements, (r, c) at r * ld + c
+- ColMajor: cols rows of ld elements, (r, c) at c * ld + r,
+  i.e. the transpose stored by rows
+- Tiled: tile x tile blocks stored by rows of blocks, each
+  block by rows, (r, c) in block (r / tile, c / tile) at
+  (r % tile) * tile + c % tile. The blocks on the right and
+  bottom edges are padded with zeros
+ld is a multiple of 64 bytes, since the file is mapped page
+aligned every row of the payload is aligned for the kernels
+*/
+
+static constexpr char MATRIX_FILE_MAGIC[8] = { 'P', 'A', 'R', 'C', 'O', 'M', 'A', 'T' };
+static constexpr uint32_t MATRIX_FILE_VERSION = 1;
+
+/// <summary>
+/// Element type of a matrix file
+/// </summary>
+enum class MatrixDType : uint32_t {
+	Float32 = 0,
+	Float64 = 1,
+	Int8 = 2,
+	UInt8 = 3,
+	Int16 = 4,
+	UInt16 = 5,
+	Int32 = 6,
+	UInt32 = 7,
+	Complex64 = 8
+};
+
+template <typename Elem>
+struct MatrixDTypeOf;
+
+template <> struct MatrixDTypeOf<float> { static constexpr MatrixDType value = MatrixDType::Float32; };
+template <> struct MatrixDTypeOf<double> { static constexpr MatrixDType value = MatrixDType::Float64; };
+template <> struct MatrixDTypeOf<int8_t> { static constexpr MatrixDType value = MatrixDType::Int8; };
+template <> struct MatrixDTypeOf<uint8_t> { static constexpr MatrixDType value = MatrixDType::UInt8; };
+template <> struct MatrixDTypeOf<int16_t> { static constexpr MatrixDType value = MatrixDType::Int16; };
+template <> struct MatrixDTypeOf<uint16_t> { static constexpr MatrixDType value = MatrixDType::UInt16; };
+template <> struct MatrixDTypeOf<int32_t> { static constexpr MatrixDType value = MatrixDType::Int32; };
+template <> struct MatrixDTypeOf<uint32_t> { static constexpr MatrixDType value = MatrixDType::UInt32; };
+template <> struct MatrixDTypeOf<std::complex<float>> { static constexpr MatrixDType value = MatrixDType::Complex64; };
+
+/// <summary>
+/// Order of the elements in the payload
+/// </summary>
+enum class MatrixLayout : uint32_t {
+	RowMajor = 0,
+	ColMajor = 1,
+	Tiled = 2
+};
+
+/// <summary>
+/// First 64 bytes of a matrix file
+/// </summary>
+struct MatrixFileHeader {
+	char magic[8];
+	uint32_t version;
+	//MatrixDType
+	uint32_t dtype;
+	//MatrixLayout
+	uint32_t layout;
+	//Side of the blocks, Tiled only (0 otherwise)
+	uint32_t tile;
+	uint32_t rows;
+	uint32_t cols;
+	//Elements between two payload rows, 0 when Tiled
+	uint32_t ld;
+	uint32_t reserved;
+	uint64_t payload_offset;
+	uint64_t payload_bytes;
+	//MatrixFileChecksum of the payload
+	uint64_t checksum;
+};
+
+static_assert(sizeof(MatrixFileHeader) == 64, "The header must be 64 bytes");
+
+/// <summary>
+/// Checksum stored in the header: FNV-1a over the
+/// payload taken as 64 bit words (bytes for the tail)
+/// </summary>
+/// <param name="data">Payload</param>
+/// <param name="bytes">Size of the payload</param>
+/// <returns>The checksum</returns>
+uint64_t MatrixFileChecksum(void const* data, size_t bytes);
+
+/// <summary>
+/// A matrix file of MatType mapped read only, the payload
+/// is used in place without copies. Movable, not copyable
+/// </summary>
+class MappedMatrixFile {
+public:
+	MappedMatrixFile();
+
+	/// <summary>
+	/// Maps the file, IsValid() is false if it cannot be
+	/// opened, its header is wrong, its elements are not
+	/// MatType or the checksum does not match
+	/// </summary>
+	/// <param name="path">File</param>
+	/// <param name="verify_checksum">Read the whole payload to check it</param>
+	explicit MappedMatrixFile(const char* path, bool verify_checksum = true);
+
+	MappedMatrixFile(MappedMatrixFile const&) = delete;
+	MappedMatrixFile& operator=(MappedMatrixFile const&) = delete;
+
+	MappedMatrixFile(MappedMatrixFile&& other);
+	MappedMatrixFile& operator=(MappedMatrixFile&& other);
+
+	~MappedMatrixFile();
+
+	void Swap(MappedMatrixFile& other);
+
+	bool IsValid() const { return m_mapping != nullptr; }
+
+	MatrixFileHeader const& Header() const { return m_header; }
+
+	MatrixLayout Layout() const { return MatrixLayout(m_header.layout); }
+
+	/// <summary>
+	/// The payload as it is stored: the matrix when RowMajor,
+	/// its transpose (cols x rows) when ColMajor. Symmetry does
+	/// not change, checkSym* can be used on both.
+	/// Empty for Tiled files, use LoadMatrixFile
+	/// </summary>
+	/// <returns>Aligned view of the payload</returns>
+	MatrixView<MatType const, true> View() const;
+
+	/// <summary>
+	/// Raw payload, payload_bytes long
+	/// </summary>
+	/// <returns>First byte of the payload</returns>
+	void const* Payload() const;
+
+private:
+	void Unmap();
+
+	void* m_mapping;
+	size_t m_length;
+	MatrixFileHeader m_header;
+};
+
+/// <summary>
+/// Reads a matrix file of any layout into a row major
+/// Matrix (ColMajor files are transposed, Tiled ones
+/// copied block by block)
+/// </summary>
+/// <param name="path">File</param>
+/// <param name="out">Receives the matrix</param>
+/// <param name="verify_checksum">Check the payload</param>
+/// <returns>false if the file is not a valid matrix file of MatType</returns>
+bool LoadMatrixFile(const char* path, Matrix<MatType>& out, bool verify_checksum = true);
+
+/// <summary>
+/// Writes M to path (created or truncated) with the given
+/// layout. The payload is written through a shared mapping
+/// of the file, ColMajor payloads are produced directly by
+/// matTransposeFinal
+/// </summary>
+/// <param name="path">File</param>
+/// <param name="M">Matrix</param>
+/// <param name="layout">Layout of the payload</param>
+/// <param name="tile">Side of the blocks, Tiled only</param>
+/// <returns>false if the file could not be written</returns>
+bool WriteMatrixFile(const char* path, MatrixView<MatType const> M,
+	MatrixLayout layout = MatrixLayout::RowMajor, uint32_t tile = RECOMMENDED_BLOCK_SZ);
+
+/// <summary>
+/// Writes the transpose of M (cols x rows, RowMajor),
+/// transposing with matTransposeFinal straight into
+/// the mapped file
+/// </summary>
+/// <param name="path">File</param>
+/// <param name="M">Matrix to transpose</param>
+/// <returns>false if the file could not be written</returns>
+bool WriteTransposedMatrixFile(const char* path, MatrixView<MatType const> M);
+
+#endif // !PARCO_MATRIX_FILE
@@ -0,0 +1,30 @@
+#include "Matrix_fixed.h"
+
+//The registry uses the default unroll of each size
+template <uint32_t N>
+static constexpr FixedKernels MakeFixedKernels() {
+	return FixedKernels{ N, TransposeFixed<N>, CheckSymFixed<N> };
+}
+
+//Sorted by N
+static const FixedKernels FIXED_KERNELS[] = {
+	MakeFixedKernels<4>(),
+	MakeFixedKernels<8>(),
+	MakeFixedKernels<16>(),
+	MakeFixedKernels<32>(),
+	MakeFixedKernels<64>(),
+	MakeFixedKernels<128>(),
+	MakeFixedKernels<256>()
+};
+
+FixedKernels const* GetFixedKernels(uint32_t N) {
+	for (FixedKernels const& kernels : FIXED_KERNELS) {
+		if (kernels.N == N)
+			return &kernels;
+
+		if (kernels.N > N)
+			break;
+	}
+
+	return nullptr;
+}
@@ -0,0 +1,158 @@
+#ifndef PARCO_MATRIX_FIXED
+#define PARCO_MATRIX_FIXED
+
+#include "Defs.h"
+#include "Simd_utils.h"
+
+/*
+Kernels for square contiguous N x N matrices, with N
+known at compile time: the offsets are constants and
+there is no block size to compute nor edge to handle.
+Only the loop over a row of 4x4 tiles is unrolled, by
+UNROLL tiles (FIXED_UNROLL unless N is smaller),
+unrolling the whole matrix made the code too big for
+the icache. The templates can be instantiated with
+another UNROLL to compare unroll factors.
+*/
+
+//4x4 tiles handled by one iteration of the
+//unrolled loops, one cache line of columns
+static constexpr uint32_t FIXED_UNROLL = RECOMMENDED_BLOCK_SZ / 4;
+
+//Tiles are walked in blocks of one cache line of
+//rows and columns, so that for large N each block
+//of M and T stays in L1
+static constexpr uint32_t FIXED_BLOCK_SZ = RECOMMENDED_BLOCK_SZ;
+
+//Default unroll of N: small matrices have
+//less than FIXED_UNROLL tiles per row
+static constexpr uint32_t FixedUnroll(uint32_t N) {
+	return N / 4 < FIXED_UNROLL ? N / 4 : FIXED_UNROLL;
+}
+
+static constexpr uint32_t FixedBlock(uint32_t N) {
+	return N < FIXED_BLOCK_SZ ? N : FIXED_BLOCK_SZ;
+}
+
+//UNROLL consecutive 4x4 tiles of a row of tiles,
+//expanded at compile time
+template <uint32_t N, uint32_t UNROLL>
+struct FixedTileRow {
+	static inline void Transpose(MatType const* M, MatType* T, uint32_t row, uint32_t col) {
+		__m128 row1 = _mm_loadu_ps(&M[row * N + col]);
+		__m128 row2 = _mm_loadu_ps(&M[(row + 1) * N + col]);
+		__m128 row3 = _mm_loadu_ps(&M[(row + 2) * N + col]);
+		__m128 row4 = _mm_loadu_ps(&M[(row + 3) * N + col]);
+
+		Transpose4x4_Regs(row1, row2, row3, row4);
+
+		_mm_storeu_ps(&T[col * N + row], row1);
+		_mm_storeu_ps(&T[(col + 1) * N + row], row2);
+		_mm_storeu_ps(&T[(col + 2) * N + row], row3);
+		_mm_storeu_ps(&T[(col + 3) * N + row], row4);
+
+		FixedTileRow<N, UNROLL - 1>::Transpose(M, T, row, col + 4);
+	}
+
+	//Lanes of the tiles at (row, col...) that differ
+	//from their mirrors, ORed together
+	static inline __m128 Compare(MatType const* M, uint32_t row, uint32_t col) {
+		__m128 mirror1 = _mm_loadu_ps(&M[col * N + row]);
+		__m128 mirror2 = _mm_loadu_ps(&M[(col + 1) * N + row]);
+		__m128 mirror3 = _mm_loadu_ps(&M[(col + 2) * N + row]);
+		__m128 mirror4 = _mm_loadu_ps(&M[(col + 3) * N + row]);
+
+		Transpose4x4_Regs(mirror1, mirror2, mirror3, mirror4);
+
+		__m128 diff = _mm_cmpneq_ps(_mm_loadu_ps(&M[row * N + col]), mirror1);
+		diff = _mm_or_ps(diff, _mm_cmpneq_ps(_mm_loadu_ps(&M[(row + 1) * N + col]), mirror2));
+		diff = _mm_or_ps(diff, _mm_cmpneq_ps(_mm_loadu_ps(&M[(row + 2) * N + col]), mirror3));
+		diff = _mm_or_ps(diff, _mm_cmpneq_ps(_mm_loadu_ps(&M[(row + 3) * N + col]), mirror4));
+
+		return _mm_or_ps(diff, FixedTileRow<N, UNROLL - 1>::Compare(M, row, col + 4));
+	}
+};
+
+template <uint32_t N>
+struct FixedTileRow<N, 0> {
+	static inline void Transpose(MatType const*, MatType*, uint32_t, uint32_t) {}
+
+	static inline __m128 Compare(MatType const*, uint32_t, uint32_t) { return _mm_setzero_ps(); }
+};
+
+/// <summary>
+/// Transposes the contiguous N x N matrix M into T,
+/// UNROLL 4x4 tiles per iteration of the inner loop
+/// </summary>
+/// <typeparam name="N">Rows and columns, a multiple of 4 * UNROLL</typeparam>
+/// <typeparam name="UNROLL">Tiles per iteration, one cache line by default</typeparam>
+/// <param name="M">Input matrix</param>
+/// <param name="T">Output matrix</param>
+template <uint32_t N, uint32_t UNROLL = FixedUnroll(N)>
+void TransposeFixed(MatType const* M, MatType* T) {
+	//An unroll wider than a block makes the block wider
+	constexpr uint32_t BLOCK_SIZE = FixedBlock(N) < 4 * UNROLL ? 4 * UNROLL : FixedBlock(N);
+
+	static_assert(UNROLL > 0 && N % BLOCK_SIZE == 0 && BLOCK_SIZE % (4 * UNROLL) == 0, "N must be a multiple of the unrolled tiles");
+
+	for (uint32_t row_block = 0; row_block < N; row_block += BLOCK_SIZE) {
+		for (uint32_t col_block = 0; col_block < N; col_block += BLOCK_SIZE) {
+			for (uint32_t row_idx = row_block; row_idx < row_block + BLOCK_SIZE; row_idx += 4) {
+				for (uint32_t col_idx = col_block; col_idx < col_block + BLOCK_SIZE; col_idx += 4 * UNROLL) {
+					FixedTileRow<N, UNROLL>::Transpose(M, T, row_idx, col_idx);
+				}
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Checks if the contiguous N x N matrix M is symmetric.
+/// Every row of tiles starts at the group of UNROLL tiles
+/// holding the diagonal, the tiles left of it are compared
+/// twice, which is cheaper than a scalar head. Stops at
+/// the first row of tiles with a mismatch
+/// </summary>
+/// <typeparam name="N">Rows and columns, a multiple of 4 * UNROLL</typeparam>
+/// <typeparam name="UNROLL">Tiles per iteration, one cache line by default</typeparam>
+/// <param name="M">Input matrix</param>
+/// <returns>True if M is symmetric</returns>
+template <uint32_t N, uint32_t UNROLL = FixedUnroll(N)>
+bool CheckSymFixed(MatType const* M) {
+	static_assert(UNROLL > 0 && N % (4 * UNROLL) == 0, "N must be a multiple of the unrolled tiles");
+
+	for (uint32_t row_idx = 0; row_idx < N; row_idx += 4) {
+		__m128 diff = _mm_setzero_ps();
+
+		for (uint32_t col_idx = row_idx - row_idx % (4 * UNROLL); col_idx < N; col_idx += 4 * UNROLL) {
+			diff = _mm_or_ps(diff, FixedTileRow<N, UNROLL>::Compare(M, row_idx, col_idx));
+		}
+
+		if (_mm_movemask_ps(diff) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+using FixedTransposeFunc = void(*)(MatType const* M, MatType* T);
+using FixedCheckSymFunc = bool(*)(MatType const* M);
+
+/// <summary>
+/// Kernels of one size
+/// </summary>
+struct FixedKernels {
+	uint32_t N;
+	FixedTransposeFunc transpose;
+	FixedCheckSymFunc check_sym;
+};
+
+/// <summary>
+/// Looks up the kernels compiled for N
+/// (4, 8, 16, 32, 64, 128 and 256)
+/// </summary>
+/// <param name="N">Rows and columns</param>
+/// <returns>The kernels, nullptr if N has none</returns>
+FixedKernels const* GetFixedKernels(uint32_t N);
+
+#endif // !PARCO_MATRIX_FIXED
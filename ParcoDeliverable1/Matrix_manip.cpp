@@ -1,7 +1,14 @@
 #include "Matrix_manip.h"
 #include "Matrix_utils.h"
+#include "Cpu_dispatch.h"
+#include "Simd_utils.h"
+#include "Tuning.h"
+#include "Matrix_fixed.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
 
 #include <omp.h>
 
@@ -10,7 +17,7 @@
 
 //Linear, "unoptimized" function
 //for checking if the matrix is symmetrical
-bool checkSym(MatType* M, uint32_t N) {
+bool checkSym(MatType const* M, uint32_t N) {
 	bool is_symm = true;
 
 	for (uint32_t row_idx = 0; row_idx < N; row_idx++) {
@@ -26,7 +33,7 @@ bool checkSym(MatType* M, uint32_t N) {
 				//of magnitude in 99.9% of cases.
 				//However, here we are trying to compare the
 				//performance of different implementations,
-				//so we cannot do that
+				//so we cannot do that (checkSymFast does)
 				is_symm = false;
 			}
 		}
@@ -54,8 +61,12 @@ bool checkSym(MatType* M, uint32_t N) {
 * of the time, since this function
 * quits as soon as it finds one
 * element that does not match
+*
+* Turns out the strided reads on the
+* mirrored side are what costs, see
+* checkSymSIMD below
 */
-bool checkSymImp(MatType* M, uint32_t N) {
+bool checkSymImp(MatType const* M, uint32_t N) {
 	bool is_symm = true;
 
 	uint32_t BLOCK_SIZE = ComputeBlockSize(N, CACHE_LINE_SIZE);
@@ -79,7 +90,7 @@ bool checkSymImp(MatType* M, uint32_t N) {
 	return is_symm;
 }
 
-bool checkSymOMP(MatType* M, uint32_t N) {
+bool checkSymOMP(MatType const* M, uint32_t N) {
 	uint32_t BLOCK_SIZE = ComputeBlockSize(N, CACHE_LINE_SIZE);
 
 	uint32_t num_errors = 0;
@@ -103,25 +114,535 @@ bool checkSymOMP(MatType* M, uint32_t N) {
 	return num_errors == 0;
 }
 
+//Transposes the 4x4 tile at (col, row) in registers and
+//compares it with the tile at (row, col), both read by rows.
+//Returns the lanes that differ
+static inline __m128 CompareTile4x4(MatType const* M, uint32_t ld, uint32_t row, uint32_t col) {
+	__m128 mirror1 = _mm_loadu_ps(&M[size_t(col) * ld + row]);
+	__m128 mirror2 = _mm_loadu_ps(&M[size_t(col + 1) * ld + row]);
+	__m128 mirror3 = _mm_loadu_ps(&M[size_t(col + 2) * ld + row]);
+	__m128 mirror4 = _mm_loadu_ps(&M[size_t(col + 3) * ld + row]);
+
+	Transpose4x4_Regs(mirror1, mirror2, mirror3, mirror4);
+
+	//cmpneq is true for NaN, same as the scalar !=
+	__m128 diff = _mm_cmpneq_ps(_mm_loadu_ps(&M[size_t(row) * ld + col]), mirror1);
+	diff = _mm_or_ps(diff, _mm_cmpneq_ps(_mm_loadu_ps(&M[size_t(row + 1) * ld + col]), mirror2));
+	diff = _mm_or_ps(diff, _mm_cmpneq_ps(_mm_loadu_ps(&M[size_t(row + 2) * ld + col]), mirror3));
+	diff = _mm_or_ps(diff, _mm_cmpneq_ps(_mm_loadu_ps(&M[size_t(row + 3) * ld + col]), mirror4));
+
+	return diff;
+}
+
+//4x4 tiles of the upper triangle of a block row,
+//diagonal tiles included. Returns the OR of all the masks
+static inline __m128 CompareBlockRow4x4(MatType const* M, uint32_t ld, uint32_t row_idx,
+	uint32_t N_TILES, uint32_t BLOCK_SIZE) {
+	__m128 diff = _mm_setzero_ps();
+
+	uint32_t row_bound = std::min(row_idx + BLOCK_SIZE, N_TILES);
+
+	for (uint32_t col_idx = row_idx; col_idx < N_TILES; col_idx += BLOCK_SIZE) {
+		uint32_t col_bound = std::min(col_idx + BLOCK_SIZE, N_TILES);
+
+		for (uint32_t row_block = row_idx; row_block < row_bound; row_block += 4) {
+			for (uint32_t col_block = std::max(col_idx, row_block); col_block < col_bound; col_block += 4) {
+				diff = _mm_or_ps(diff, CompareTile4x4(M, ld, row_block, col_block));
+			}
+		}
+	}
+
+	return diff;
+}
+
+//Elements right of the last full tile column, scalar
+static bool CheckSymEdge(MatType const* M, uint32_t N, uint32_t ld, uint32_t N_TILES,
+	uint32_t row_begin, uint32_t row_end) {
+	bool is_symm = true;
+
+	for (uint32_t row_idx = row_begin; row_idx < row_end; row_idx++) {
+		for (uint32_t col_idx = std::max(N_TILES, row_idx + 1); col_idx < N; col_idx++) {
+			if (M[size_t(row_idx) * ld + col_idx] != M[size_t(col_idx) * ld + row_idx])
+				is_symm = false;
+		}
+	}
+
+	return is_symm;
+}
+
+//Full scan like checkSymImp, so the two can be compared
+static bool CheckSymSIMD(MatType const* M, uint32_t N, uint32_t ld) {
+	const uint32_t BLOCK_SIZE = RECOMMENDED_BLOCK_SZ;
+	const uint32_t N_TILES = N - N % 4;
+
+	__m128 diff = _mm_setzero_ps();
+
+	for (uint32_t row_idx = 0; row_idx < N_TILES; row_idx += BLOCK_SIZE) {
+		diff = _mm_or_ps(diff, CompareBlockRow4x4(M, ld, row_idx, N_TILES, BLOCK_SIZE));
+	}
+
+	bool is_symm = _mm_movemask_ps(diff) == 0;
+
+	return CheckSymEdge(M, N, ld, N_TILES, 0, N) && is_symm;
+}
+
+static bool CheckSymSIMD_OMP(MatType const* M, uint32_t N, uint32_t ld) {
+	const uint32_t BLOCK_SIZE = RECOMMENDED_BLOCK_SZ;
+	const uint32_t N_TILES = N - N % 4;
+
+	int mismatch = 0;
+
+	//Block rows get shorter going down, dynamic
+	//hands them out as threads become free
+#pragma omp parallel reduction(|:mismatch)
+	{
+#pragma omp for schedule(dynamic) nowait
+		for (uint32_t row_idx = 0; row_idx < N_TILES; row_idx += BLOCK_SIZE) {
+			mismatch |= _mm_movemask_ps(CompareBlockRow4x4(M, ld, row_idx, N_TILES, BLOCK_SIZE));
+		}
+
+#pragma omp for schedule(static)
+		for (uint32_t row_idx = 0; row_idx < N; row_idx += BLOCK_SIZE) {
+			if (!CheckSymEdge(M, N, ld, N_TILES, row_idx, std::min(row_idx + BLOCK_SIZE, N)))
+				mismatch = 1;
+		}
+	}
+
+	return mismatch == 0;
+}
+
+bool checkSymSIMD(MatType const* M, uint32_t N) {
+	return CheckSymSIMD(M, N, N);
+}
+
+bool checkSymSIMD_OMP(MatType const* M, uint32_t N) {
+	return CheckSymSIMD_OMP(M, N, N);
+}
+
+//Tile rows and edge of a block row are one iteration,
+//handed out dynamically like in CheckSymSIMD_OMP
+static bool CheckSymPool(ThreadPool& pool, uint32_t threads, MatType const* M, uint32_t N, uint32_t ld) {
+	const uint32_t BLOCK_SIZE = RECOMMENDED_BLOCK_SZ;
+	const uint32_t N_TILES = N - N % 4;
+
+	std::atomic<bool> mismatch(false);
+
+	pool.ParallelFor((N + BLOCK_SIZE - 1) / BLOCK_SIZE, [&](uint32_t block_idx) {
+		if (mismatch.load(std::memory_order_relaxed))
+			return;
+
+		uint32_t row_idx = block_idx * BLOCK_SIZE;
+		bool is_symm = true;
+
+		if (row_idx < N_TILES)
+			is_symm = _mm_movemask_ps(CompareBlockRow4x4(M, ld, row_idx, N_TILES, BLOCK_SIZE)) == 0;
+
+		if (!is_symm || !CheckSymEdge(M, N, ld, N_TILES, row_idx, std::min(row_idx + BLOCK_SIZE, N)))
+			mismatch.store(true, std::memory_order_relaxed);
+	}, threads);
+
+	return !mismatch.load();
+}
+
+bool checkSymPool(MatType const* M, uint32_t N) {
+	return CheckSymPool(GetDefaultThreadPool(), uint32_t(omp_get_max_threads()), M, N, N);
+}
+
+bool checkSymPool(ThreadPool& pool, MatType const* M, uint32_t N) {
+	return CheckSymPool(pool, 0, M, N, N);
+}
+
+//Compares the part of the tile above the main diagonal
+//with its mirror, stops at the first mismatch
+static bool IsTileSymmetric(MatType const* M, uint32_t N, uint32_t ld, uint32_t row_idx, uint32_t col_idx,
+	uint32_t BLOCK_SIZE) {
+	uint32_t row_bound = std::min(row_idx + BLOCK_SIZE, N);
+	uint32_t col_bound = std::min(col_idx + BLOCK_SIZE, N);
+
+	for (uint32_t row_block = row_idx; row_block < row_bound; row_block++) {
+		for (uint32_t col_block = std::max(col_idx, row_block + 1); col_block < col_bound; col_block++) {
+			if (M[size_t(row_block) * ld + col_block] != M[size_t(col_block) * ld + row_block])
+				return false;
+		}
+	}
+
+	return true;
+}
+
+//Early exit versions: same walk as checkSymImp, but they
+//return as soon as a mismatch is found. Tiles don't have
+//to divide N, so the block size is fixed
+static bool CheckSymFast(MatType const* M, uint32_t N, uint32_t ld) {
+	const uint32_t BLOCK_SIZE = RECOMMENDED_BLOCK_SZ;
+
+	for (uint32_t row_idx = 0; row_idx < N; row_idx += BLOCK_SIZE) {
+		for (uint32_t col_idx = row_idx; col_idx < N; col_idx += BLOCK_SIZE) {
+			if (!IsTileSymmetric(M, N, ld, row_idx, col_idx, BLOCK_SIZE))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static bool CheckSymFastOMP(MatType const* M, uint32_t N, uint32_t ld) {
+	const uint32_t BLOCK_SIZE = RECOMMENDED_BLOCK_SZ;
+
+	//A thread that finds a mismatch raises the flag, the others
+	//poll it before every tile and skip what is left.
+	//#pragma omp cancel would do the same, but it is a no-op
+	//unless OMP_CANCELLATION=true is set in the environment
+	std::atomic<bool> mismatch(false);
+
+	//Block rows have less work the further down they are,
+	//dynamic keeps the threads busy until the end
+#pragma omp parallel for schedule(dynamic)
+	for (uint32_t row_idx = 0; row_idx < N; row_idx += BLOCK_SIZE) {
+		for (uint32_t col_idx = row_idx; col_idx < N; col_idx += BLOCK_SIZE) {
+			if (mismatch.load(std::memory_order_relaxed))
+				break;
+
+			if (!IsTileSymmetric(M, N, ld, row_idx, col_idx, BLOCK_SIZE))
+				mismatch.store(true, std::memory_order_relaxed);
+		}
+	}
+
+	return !mismatch.load();
+}
+
+bool checkSymFast(MatType const* M, uint32_t N) {
+	return CheckSymFast(M, N, N);
+}
+
+bool checkSymFastOMP(MatType const* M, uint32_t N) {
+	return CheckSymFastOMP(M, N, N);
+}
+
+//|a - b|, 0 for equal elements: two infinities of
+//the same sign are symmetric but their difference is NaN
+static inline MatType PairDeviation(MatType a, MatType b) {
+	return a == b ? MatType(0) : std::fabs(a - b);
+}
+
+//a == b or |a - b| <= max(abs_tol, rel_tol * max(|a|, |b|)),
+//false if either is NaN
+static inline bool IsWithinTol(MatType a, MatType b, MatType abs_tol, MatType rel_tol) {
+	if (a == b)
+		return true;
+
+	MatType dev = std::fabs(a - b);
+	return dev <= std::max(abs_tol, rel_tol * std::max(std::fabs(a), std::fabs(b)));
+}
+
+//A pair with a NaN counts as an infinite deviation,
+//otherwise no comparison would ever record it
+static inline void UpdateDeviation(SymDeviation& deviation, MatType dev, uint32_t row, uint32_t col) {
+	if (std::isnan(dev))
+		dev = std::numeric_limits<MatType>::infinity();
+
+	if (dev > deviation.max_dev) {
+		deviation.max_dev = dev;
+		deviation.row = row;
+		deviation.col = col;
+	}
+}
+
+bool checkSymTol(MatType const* M, uint32_t N, MatType abs_tol, MatType rel_tol,
+	SymDeviation* deviation) {
+	bool is_symm = true;
+	SymDeviation max_dev{ 0, 0, 0 };
+
+	for (uint32_t row_idx = 0; row_idx < N; row_idx++) {
+		for (uint32_t col_idx = row_idx + 1; col_idx < N; col_idx++) {
+			MatType a = M[size_t(row_idx) * N + col_idx];
+			MatType b = M[size_t(col_idx) * N + row_idx];
+
+			if (!IsWithinTol(a, b, abs_tol, rel_tol))
+				is_symm = false;
+			UpdateDeviation(max_dev, PairDeviation(a, b), row_idx, col_idx);
+		}
+	}
+
+	if (deviation != nullptr)
+		*deviation = max_dev;
+
+	return is_symm;
+}
+
+//Same as CompareTile4x4, but with the tolerance test.
+//The deviations are only stored and scanned when one
+//of them beats the current maximum, which after the
+//first few tiles is rare
+static inline __m128 CompareTileTol4x4(MatType const* M, uint32_t N, uint32_t row, uint32_t col,
+	__m128 abs_tol, __m128 rel_tol, SymDeviation& deviation) {
+	const __m128 sign_mask = _mm_set1_ps(-0.0f);
+	const __m128 inf = _mm_set1_ps(std::numeric_limits<MatType>::infinity());
+
+	__m128 mirror[4];
+
+	for (uint32_t idx = 0; idx < 4; idx++)
+		mirror[idx] = _mm_loadu_ps(&M[size_t(col + idx) * N + row]);
+
+	Transpose4x4_Regs(mirror[0], mirror[1], mirror[2], mirror[3]);
+
+	__m128 fail = _mm_setzero_ps();
+	__m128 dev[4];
+
+	for (uint32_t idx = 0; idx < 4; idx++) {
+		__m128 a = _mm_loadu_ps(&M[size_t(row + idx) * N + col]);
+
+		//Equal lanes pass with 0 deviation, equal
+		//infinities would give inf - inf = NaN
+		__m128 equal = _mm_cmpeq_ps(a, mirror[idx]);
+
+		dev[idx] = _mm_andnot_ps(equal, _mm_andnot_ps(sign_mask, _mm_sub_ps(a, mirror[idx])));
+		__m128 mag = _mm_max_ps(_mm_andnot_ps(sign_mask, a), _mm_andnot_ps(sign_mask, mirror[idx]));
+		__m128 tol = _mm_max_ps(abs_tol, _mm_mul_ps(rel_tol, mag));
+
+		//Not less or equal, so NaN fails
+		fail = _mm_or_ps(fail, _mm_andnot_ps(equal, _mm_cmpnle_ps(dev[idx], tol)));
+
+		//NaN as +inf (see UpdateDeviation), max and cmpgt
+		//below would drop it
+		__m128 nan = _mm_cmpunord_ps(dev[idx], dev[idx]);
+		dev[idx] = _mm_or_ps(_mm_andnot_ps(nan, dev[idx]), _mm_and_ps(nan, inf));
+	}
+
+	__m128 tile_max = _mm_max_ps(_mm_max_ps(dev[0], dev[1]), _mm_max_ps(dev[2], dev[3]));
+
+	if (_mm_movemask_ps(_mm_cmpgt_ps(tile_max, _mm_set1_ps(deviation.max_dev))) != 0) {
+		alignas(16) MatType lanes[4];
+
+		for (uint32_t idx = 0; idx < 4; idx++) {
+			_mm_store_ps(lanes, dev[idx]);
+
+			for (uint32_t lane = 0; lane < 4; lane++)
+				UpdateDeviation(deviation, lanes[lane], row + idx, col + lane);
+		}
+	}
+
+	return fail;
+}
+
+//CompareBlockRow4x4 with tolerance
+static inline __m128 CompareBlockRowTol4x4(MatType const* M, uint32_t N, uint32_t row_idx,
+	uint32_t N_TILES, uint32_t BLOCK_SIZE, __m128 abs_tol, __m128 rel_tol, SymDeviation& deviation) {
+	__m128 fail = _mm_setzero_ps();
+
+	uint32_t row_bound = std::min(row_idx + BLOCK_SIZE, N_TILES);
+
+	for (uint32_t col_idx = row_idx; col_idx < N_TILES; col_idx += BLOCK_SIZE) {
+		uint32_t col_bound = std::min(col_idx + BLOCK_SIZE, N_TILES);
+
+		for (uint32_t row_block = row_idx; row_block < row_bound; row_block += 4) {
+			for (uint32_t col_block = std::max(col_idx, row_block); col_block < col_bound; col_block += 4) {
+				fail = _mm_or_ps(fail, CompareTileTol4x4(M, N, row_block, col_block, abs_tol, rel_tol,
+					deviation));
+			}
+		}
+	}
+
+	return fail;
+}
+
+//CheckSymEdge with tolerance
+static bool CheckSymTolEdge(MatType const* M, uint32_t N, uint32_t N_TILES,
+	uint32_t row_begin, uint32_t row_end, MatType abs_tol, MatType rel_tol, SymDeviation& deviation) {
+	bool is_symm = true;
+
+	for (uint32_t row_idx = row_begin; row_idx < row_end; row_idx++) {
+		for (uint32_t col_idx = std::max(N_TILES, row_idx + 1); col_idx < N; col_idx++) {
+			MatType a = M[size_t(row_idx) * N + col_idx];
+			MatType b = M[size_t(col_idx) * N + row_idx];
+
+			if (!IsWithinTol(a, b, abs_tol, rel_tol))
+				is_symm = false;
+			UpdateDeviation(deviation, PairDeviation(a, b), row_idx, col_idx);
+		}
+	}
+
+	return is_symm;
+}
+
+bool checkSymTolImp(MatType const* M, uint32_t N, MatType abs_tol, MatType rel_tol,
+	SymDeviation* deviation) {
+	const uint32_t BLOCK_SIZE = RECOMMENDED_BLOCK_SZ;
+	const uint32_t N_TILES = N - N % 4;
+
+	const __m128 abs_tol_v = _mm_set1_ps(abs_tol);
+	const __m128 rel_tol_v = _mm_set1_ps(rel_tol);
+
+	SymDeviation max_dev{ 0, 0, 0 };
+	__m128 fail = _mm_setzero_ps();
+
+	for (uint32_t row_idx = 0; row_idx < N_TILES; row_idx += BLOCK_SIZE) {
+		fail = _mm_or_ps(fail, CompareBlockRowTol4x4(M, N, row_idx, N_TILES, BLOCK_SIZE,
+			abs_tol_v, rel_tol_v, max_dev));
+	}
+
+	bool is_symm = CheckSymTolEdge(M, N, N_TILES, 0, N, abs_tol, rel_tol, max_dev);
+
+	if (deviation != nullptr)
+		*deviation = max_dev;
+
+	return is_symm && _mm_movemask_ps(fail) == 0;
+}
+
+bool checkSymTolOMP(MatType const* M, uint32_t N, MatType abs_tol, MatType rel_tol,
+	SymDeviation* deviation) {
+	const uint32_t BLOCK_SIZE = RECOMMENDED_BLOCK_SZ;
+	const uint32_t N_TILES = N - N % 4;
+
+	SymDeviation max_dev{ 0, 0, 0 };
+	int mismatch = 0;
+
+#pragma omp parallel reduction(|:mismatch)
+	{
+		const __m128 abs_tol_v = _mm_set1_ps(abs_tol);
+		const __m128 rel_tol_v = _mm_set1_ps(rel_tol);
+
+		SymDeviation thread_dev{ 0, 0, 0 };
+
+#pragma omp for schedule(dynamic) nowait
+		for (uint32_t row_idx = 0; row_idx < N_TILES; row_idx += BLOCK_SIZE) {
+			mismatch |= _mm_movemask_ps(CompareBlockRowTol4x4(M, N, row_idx, N_TILES, BLOCK_SIZE,
+				abs_tol_v, rel_tol_v, thread_dev));
+		}
+
+#pragma omp for schedule(static) nowait
+		for (uint32_t row_idx = 0; row_idx < N; row_idx += BLOCK_SIZE) {
+			if (!CheckSymTolEdge(M, N, N_TILES, row_idx, std::min(row_idx + BLOCK_SIZE, N),
+				abs_tol, rel_tol, thread_dev))
+				mismatch = 1;
+		}
+
+#pragma omp critical
+		UpdateDeviation(max_dev, thread_dev.max_dev, thread_dev.row, thread_dev.col);
+	}
+
+	if (deviation != nullptr)
+		*deviation = max_dev;
+
+	return mismatch == 0;
+}
+
 //////////////////////////////////////////
 //TRANSPOSE
 
 //Unoptimized matrix transpose
 void matTranspose(MatType const* M, MatType* T, uint32_t N) {
-	for (uint32_t row_idx = 0; row_idx < N; row_idx++) {
-		for (uint32_t col_idx = 0; col_idx < N; col_idx++) {
-			T[col_idx * N + row_idx] = M[row_idx * N + col_idx];
+	matTranspose(M, T, N, N, N, N);
+}
+
+void matTranspose(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	for (uint32_t row_idx = 0; row_idx < rows; row_idx++) {
+		for (uint32_t col_idx = 0; col_idx < cols; col_idx++) {
+			T[size_t(col_idx) * ldb + row_idx] = M[size_t(row_idx) * lda + col_idx];
 		}
 	}
 	//Alternative approach: do col major, 
 	//keep write line longer in the cache
-	/*for (uint32_t col_idx = 0; col_idx < N; col_idx++) {
-		for (uint32_t row_idx = 0; row_idx < N; row_idx++) {
-			T[col_idx * N + row_idx] = M[row_idx * N + col_idx];
+	/*for (uint32_t col_idx = 0; col_idx < cols; col_idx++) {
+		for (uint32_t row_idx = 0; row_idx < rows; row_idx++) {
+			T[size_t(col_idx) * ldb + row_idx] = M[size_t(row_idx) * lda + col_idx];
 		}
 	}*/
 }
 
+//How the transposes pick the aligned kernels: by looking
+//at the pointers, or from the type of a MatrixView
+enum class AlignMode {
+	Runtime,
+	Aligned,
+	Unaligned
+};
+
+template <AlignMode Mode>
+static BlockTransposeFunc SelectKernel(MatType const* M, MatType const* T, uint32_t lda, uint32_t ldb,
+	uint32_t BLOCK_SIZE) {
+	if (Mode == AlignMode::Runtime)
+		return SelectBlockTranspose(M, T, lda, ldb, BLOCK_SIZE);
+
+	return SelectBlockTranspose<Mode == AlignMode::Aligned>(BLOCK_SIZE);
+}
+
+//Widest blocked kernel, serial or with OMP. threads is
+//passed to the parallel regions of the OMP kernels
+//(0 = OpenMP default) and ignored by the serial ones
+template <AlignMode Mode>
+static void RunBlockKernel(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE, bool use_omp, uint32_t threads) {
+	if (!use_omp) {
+		SelectKernel<Mode>(M, T, lda, ldb, BLOCK_SIZE)(M, T, rows, cols, lda, ldb, BLOCK_SIZE);
+		return;
+	}
+
+	BlockTransposeOMPFunc kernel = Mode == AlignMode::Runtime
+		? SelectBlockTransposeOMP(M, T, lda, ldb, BLOCK_SIZE)
+		: SelectBlockTransposeOMP<Mode == AlignMode::Aligned>(BLOCK_SIZE);
+
+	kernel(M, T, rows, cols, lda, ldb, BLOCK_SIZE, threads);
+}
+
+static void TransposeEdgeStrip(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, bool use_omp, uint32_t threads) {
+	if (use_omp)
+		TransposeEdge_OMP(M, T, rows, cols, lda, ldb, threads);
+	else
+		TransposeEdge(M, T, rows, cols, lda, ldb);
+}
+
+//Right and bottom strips left out of the
+//rows_main x cols_main area (see below)
+static void TransposeStrips(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t rows_main, uint32_t cols_main, uint32_t lda, uint32_t ldb, bool use_omp, uint32_t threads) {
+	if (cols_main != cols) {
+		TransposeEdgeStrip(M + cols_main, T + size_t(cols_main) * ldb, rows, cols - cols_main, lda, ldb,
+			use_omp, threads);
+	}
+
+	if (rows_main != rows && cols_main != 0) {
+		TransposeEdgeStrip(M + size_t(rows_main) * lda, T + rows_main, rows - rows_main, cols_main, lda, ldb,
+			use_omp, threads);
+	}
+}
+
+//Fixed tile for the bulk of the matrix plus edge kernel
+//for the remainder strips, used when no block size that is
+//a multiple of 4 divides both dimensions.
+//
+//    cols_main       cols
+//  +-----------+----+
+//  |           |    |
+//  |   main    | R  |  R: right strip, rows x (cols - cols_main)
+//  |           |    |
+//  +-----------+----+  rows_main
+//  |     B     |       B: bottom strip, (rows - rows_main) x cols_main
+//  +-----------+       rows
+//
+//The main area uses the widest kernel from SelectBlockTranspose,
+//or the non temporal one in STREAM_BLOCK_SZ blocks if stream is set
+template <AlignMode Mode = AlignMode::Runtime>
+static void TransposeTilesAndEdges(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, bool use_omp, uint32_t threads = 0, bool stream = false) {
+	const uint32_t BLOCK_SIZE = stream ? STREAM_BLOCK_SZ : RECOMMENDED_BLOCK_SZ;
+
+	uint32_t rows_main = rows - rows % BLOCK_SIZE;
+	uint32_t cols_main = cols - cols % BLOCK_SIZE;
+
+	if (rows_main != 0 && cols_main != 0) {
+		if (!stream)
+			RunBlockKernel<Mode>(M, T, rows_main, cols_main, lda, ldb, BLOCK_SIZE, use_omp, threads);
+		else if (use_omp)
+			BlockTranspose_SSE_Stream_OMP(M, T, rows_main, cols_main, lda, ldb, BLOCK_SIZE, threads);
+		else
+			BlockTranspose_SSE_Stream(M, T, rows_main, cols_main, lda, ldb, BLOCK_SIZE);
+	}
+
+	TransposeStrips(M, T, rows, cols, rows_main, cols_main, lda, ldb, use_omp, threads);
+}
+
 /// Do transposition by dividing matrix in blocks of non-fixed size.
 /// Fixed size blocks would lead to loop unrolling by the compiler,
 /// which is good, but would not work for matrices with size
@@ -132,74 +653,725 @@ void matTranspose(MatType const* M, MatType* T, uint32_t N) {
 /// the size of the matrix type (float or double)
 /// 
 /// 
-/// Matrices with N being a prime number (unlikely)
-/// will result in massive slowdown since the block
-/// size will be equal to 1. Alternatively, the implementation
-/// could use a big block size until the boundary of the matrix is
-/// reached, and the remaining elements are copied one by one
+/// Matrices with N being a prime number (or any N whose
+/// best divisor is not a multiple of 4) would result in
+/// massive slowdown, since the block size would be 1 or
+/// would not fit the vector kernels. In that case
+/// we use a fixed block size of one cache line until
+/// the boundary of the matrix is reached, and the
+/// remaining strips are transposed by the edge kernel
+/// (see TransposeTilesAndEdges)
 void matTransposeImp(MatType const* M, MatType* T, uint32_t N) {
-	uint32_t BLOCK_SIZE = ComputeBlockSize(N, CACHE_LINE_SIZE);
+	matTransposeImp(M, T, N, N, N, N);
+}
+
+//For rectangular matrices the block must divide both
+//rows and columns
+template <AlignMode Mode>
+static void TransposeBlocked(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, bool use_omp, uint32_t threads = 0) {
+	uint32_t BLOCK_SIZE = ComputeBlockSize(rows, cols, CACHE_LINE_SIZE);
 
 	if (BLOCK_SIZE % 4 == 0) {
 		//Block size is perfectly divisible by 4,
-		//use block size, divide block size by 4
-		//and use sse enhanced transposition
-		if ((unsigned long long)(M) % 16 == 0 && (unsigned long long)(T) % 16 == 0) {
-			//Matrix is aligned to 16 byte boundary
-			//Each 4x4 block will also be aligned
-			//Use aligned version of sse matrix transpose
-			BlockTranspose_SSE<true>(M, T, N, BLOCK_SIZE);
+		//use the widest vector transposition
+		//supported by the CPU whose register tile
+		//divides the block (AVX-512 16x16, AVX2 8x8,
+		//SSE 4x4). If the matrices are aligned to 
+		//the width of the register, each tile
+		//will also be aligned, and the aligned
+		//version is selected
+		RunBlockKernel<Mode>(M, T, rows, cols, lda, ldb, BLOCK_SIZE, use_omp, threads);
+	}
+	else {
+		TransposeTilesAndEdges<Mode>(M, T, rows, cols, lda, ldb, use_omp, threads);
+	}
+}
+
+void matTransposeImp(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	TransposeBlocked<AlignMode::Runtime>(M, T, rows, cols, lda, ldb, false);
+}
+
+void matTransposeOMP(MatType const* M, MatType* T, uint32_t N) {
+	matTransposeOMP(M, T, N, N, N, N);
+}
+
+void matTransposeOMP(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	TransposeBlocked<AlignMode::Runtime>(M, T, rows, cols, lda, ldb, true);
+}
+
+//////////////////////////////////////////
+//THREAD POOL
+
+//Rows of a band are a multiple of the widest register
+//tile, so every band starts as aligned as the matrix
+static constexpr uint32_t POOL_BAND_STEP = 16;
+
+//A few bands per thread, so the dynamic hand out
+//can even out threads that start late
+static constexpr uint32_t POOL_BANDS_PER_THREAD = 4;
+
+static void TransposePool(ThreadPool& pool, uint32_t threads, MatType const* M, MatType* T,
+	uint32_t rows, uint32_t cols, uint32_t lda, uint32_t ldb) {
+	const uint32_t N_THREADS = (threads == 0 || threads > pool.Threads()) ? pool.Threads() : threads;
+
+	uint32_t band = (rows + N_THREADS * POOL_BANDS_PER_THREAD - 1) / (N_THREADS * POOL_BANDS_PER_THREAD);
+	band = std::max((band + POOL_BAND_STEP - 1) / POOL_BAND_STEP * POOL_BAND_STEP, POOL_BAND_STEP);
+
+	const uint32_t N_BANDS = (rows + band - 1) / band;
+
+	if (N_THREADS == 1 || N_BANDS <= 1) {
+		TransposeBlocked<AlignMode::Runtime>(M, T, rows, cols, lda, ldb, false);
+		return;
+	}
+
+	//Band b is rows [b * band, b * band + band) of M,
+	//the same columns of T
+	pool.ParallelFor(N_BANDS, [&](uint32_t band_idx) {
+		uint32_t row_begin = band_idx * band;
+		uint32_t band_rows = std::min(band, rows - row_begin);
+
+		TransposeBlocked<AlignMode::Runtime>(M + size_t(row_begin) * lda, T + row_begin, band_rows, cols,
+			lda, ldb, false);
+	}, N_THREADS);
+}
+
+void matTransposePool(MatType const* M, MatType* T, uint32_t N) {
+	matTransposePool(M, T, N, N, N, N);
+}
+
+void matTransposePool(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	TransposePool(GetDefaultThreadPool(), uint32_t(omp_get_max_threads()), M, T, rows, cols, lda, ldb);
+}
+
+void matTransposePool(ThreadPool& pool, MatType const* M, MatType* T, uint32_t N) {
+	matTransposePool(pool, M, T, N, N, N, N);
+}
+
+void matTransposePool(ThreadPool& pool, MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	TransposePool(pool, 0, M, T, rows, cols, lda, ldb);
+}
+
+//////////////////////////////////////////
+//BATCHED TRANSPOSE
+
+//One matrix of the batch, always on the calling thread
+static void TransposeSmall(MatType const* M, MatType* T, uint32_t N) {
+	FixedKernels const* fixed = GetFixedKernels(N);
+
+	if (fixed != nullptr)
+		fixed->transpose(M, T);
+	else
+		TransposeBlocked<AlignMode::Runtime>(M, T, N, N, N, N, false);
+}
+
+//Items of the batch cost from tens of ns to hundreds of us,
+//guided hands out big chunks first and small ones at the end
+void matTransposeBatched(MatType const* const* M, MatType* const* T, uint32_t const* N, uint32_t count) {
+#pragma omp parallel for schedule(guided) if(count > 1)
+	for (uint32_t idx = 0; idx < count; idx++) {
+		TransposeSmall(M[idx], T[idx], N[idx]);
+	}
+}
+
+void matTransposeBatchedStrided(MatType const* M, MatType* T, uint32_t N, uint32_t count,
+	size_t stride_M, size_t stride_T) {
+	const size_t STRIDE_M = stride_M != 0 ? stride_M : size_t(N) * N;
+	const size_t STRIDE_T = stride_T != 0 ? stride_T : size_t(N) * N;
+
+	//Same cost for every item, static is enough
+#pragma omp parallel for schedule(static) if(count > 1)
+	for (uint32_t idx = 0; idx < count; idx++) {
+		TransposeSmall(M + idx * STRIDE_M, T + idx * STRIDE_T, N);
+	}
+}
+
+//Without results the first asymmetric matrix
+//makes the other threads skip what is left
+template <typename GetMatrix>
+static bool CheckSymBatch(GetMatrix get_matrix, uint32_t count, bool* results) {
+	std::atomic<bool> mismatch(false);
+
+#pragma omp parallel for schedule(guided) if(count > 1)
+	for (uint32_t idx = 0; idx < count; idx++) {
+		if (results == nullptr && mismatch.load(std::memory_order_relaxed))
+			continue;
+
+		MatType const* matrix = nullptr;
+		uint32_t N = 0;
+		get_matrix(idx, matrix, N);
+
+		FixedKernels const* fixed = GetFixedKernels(N);
+		bool is_symm = fixed != nullptr ? fixed->check_sym(matrix) : CheckSymSIMD(matrix, N, N);
+
+		if (results != nullptr)
+			results[idx] = is_symm;
+
+		if (!is_symm)
+			mismatch.store(true, std::memory_order_relaxed);
+	}
+
+	return !mismatch.load();
+}
+
+bool checkSymBatched(MatType const* const* M, uint32_t const* N, uint32_t count, bool* results) {
+	return CheckSymBatch([&](uint32_t idx, MatType const*& matrix, uint32_t& size) {
+		matrix = M[idx];
+		size = N[idx];
+	}, count, results);
+}
+
+bool checkSymBatchedStrided(MatType const* M, uint32_t N, uint32_t count, size_t stride, bool* results) {
+	const size_t STRIDE = stride != 0 ? stride : size_t(N) * N;
+
+	return CheckSymBatch([&](uint32_t idx, MatType const*& matrix, uint32_t& size) {
+		matrix = M + idx * STRIDE;
+		size = N;
+	}, count, results);
+}
+
+//////////////////////////////////////////
+//TWO LEVEL TILING
+
+//Both levels are multiples of the widest register tile
+//(16x16 with AVX-512), so that every kernel can be used
+//on every tile and aligned tiles stay aligned
+static constexpr uint32_t HIER_REG_TILE = 16;
+
+struct HierTileSizes {
+	uint32_t inner;
+	uint32_t outer;
+};
+
+//Largest multiple of step whose square tile of M, plus the
+//same tile of T, takes half of the cache. The other half is
+//left for prefetched lines and everything else
+static uint32_t HierTileSide(uint32_t cache_bytes, uint32_t step) {
+	uint32_t side = uint32_t(std::sqrt(double(cache_bytes) / (4 * sizeof(MatType))));
+	return std::max(side - side % step, step);
+}
+
+static HierTileSizes ComputeHierTileSizes() {
+	CacheSizes const& caches = GetCacheSizes();
+
+	uint32_t l1 = caches.l1d != 0 ? caches.l1d : 32 << 10;
+	//Private L2 if there is one, else the slice of
+	//the last level that each core gets
+	uint32_t l2 = caches.l2 != 0 ? caches.l2 : caches.llc / caches.llc_shared;
+
+	HierTileSizes sizes;
+	sizes.inner = HierTileSide(l1, HIER_REG_TILE);
+	sizes.outer = HierTileSide(std::max(l2, l1), sizes.inner);
+	return sizes;
+}
+
+static HierTileSizes const& GetHierTileSizes() {
+	static const HierTileSizes sizes = ComputeHierTileSizes();
+	return sizes;
+}
+
+//One outer tile, rows and cols are multiples of HIER_REG_TILE.
+//The kernel walks it in L1 sized blocks, which are then
+//split in register tiles. Only the last tiles of the matrix
+//are not multiples of the inner size, their remainders
+//use register sized blocks
+static void TransposeOuterTile(BlockTransposeFunc kernel, MatType const* M, MatType* T,
+	uint32_t rows, uint32_t cols, uint32_t lda, uint32_t ldb, uint32_t INNER) {
+	uint32_t rows_inner = rows - rows % INNER;
+	uint32_t cols_inner = cols - cols % INNER;
+
+	if (rows_inner != 0 && cols_inner != 0)
+		kernel(M, T, rows_inner, cols_inner, lda, ldb, INNER);
+
+	if (cols_inner != cols)
+		kernel(M + cols_inner, T + size_t(cols_inner) * ldb, rows, cols - cols_inner, lda, ldb, HIER_REG_TILE);
+
+	if (rows_inner != rows && cols_inner != 0)
+		kernel(M + size_t(rows_inner) * lda, T + rows_inner, rows - rows_inner, cols_inner, lda, ldb, HIER_REG_TILE);
+}
+
+//Unlike matTransposeImp the block does not have to divide
+//N, so odd sizes get the same tiles as powers of two,
+//and unlike the cache oblivious recursion the tiles do not
+//shrink to the leaf size, so that the whole L2 tile is
+//reused before moving on
+template <AlignMode Mode>
+static void TransposeHier(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, bool use_omp, uint32_t threads = 0) {
+	HierTileSizes const& tiles = GetHierTileSizes();
+	const uint32_t OUTER = tiles.outer;
+
+	uint32_t rows_main = rows - rows % HIER_REG_TILE;
+	uint32_t cols_main = cols - cols % HIER_REG_TILE;
+
+	if (rows_main != 0 && cols_main != 0) {
+		//Tiles are run in parallel, each one with the serial kernel
+		BlockTransposeFunc kernel = SelectKernel<Mode>(M, T, lda, ldb, HIER_REG_TILE);
+
+#pragma omp parallel for collapse(2) schedule(dynamic) num_threads(OmpThreads(threads)) if(use_omp)
+		for (uint32_t row_idx = 0; row_idx < rows_main; row_idx += OUTER) {
+			for (uint32_t col_idx = 0; col_idx < cols_main; col_idx += OUTER) {
+				TransposeOuterTile(kernel, M + size_t(row_idx) * lda + col_idx, T + size_t(col_idx) * ldb + row_idx,
+					std::min(OUTER, rows_main - row_idx), std::min(OUTER, cols_main - col_idx), lda, ldb, tiles.inner);
+			}
+		}
+	}
+
+	TransposeStrips(M, T, rows, cols, rows_main, cols_main, lda, ldb, use_omp, threads);
+}
+
+void matTransposeHier(MatType const* M, MatType* T, uint32_t N) {
+	matTransposeHier(M, T, N, N, N, N);
+}
+
+void matTransposeHier(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	TransposeHier<AlignMode::Runtime>(M, T, rows, cols, lda, ldb, false);
+}
+
+void matTransposeHierOMP(MatType const* M, MatType* T, uint32_t N) {
+	matTransposeHierOMP(M, T, N, N, N, N);
+}
+
+void matTransposeHierOMP(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	TransposeHier<AlignMode::Runtime>(M, T, rows, cols, lda, ldb, true);
+}
+
+//Aligned loads in the recursion need every row
+//of both matrices to start on a 16 byte boundary
+template <AlignMode Mode>
+static bool IsAligned16(MatType const* M, MatType const* T, uint32_t lda, uint32_t ldb) {
+	if (Mode != AlignMode::Runtime)
+		return Mode == AlignMode::Aligned;
+
+	return (unsigned long long)(M) % 16 == 0 && (unsigned long long)(T) % 16 == 0
+		&& lda % 4 == 0 && ldb % 4 == 0;
+}
+
+template <AlignMode Mode>
+static void TransposeOblivious(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	uint32_t LEAF_SIZE = GetTuningProfile().leaf_size;
+
+	if (IsAligned16<Mode>(M, T, lda, ldb))
+		matTransposeCacheObliviousImp<true>(M, T, lda, ldb, rows, cols, 0, 0, LEAF_SIZE);
+	else
+		matTransposeCacheObliviousImp<false>(M, T, lda, ldb, rows, cols, 0, 0, LEAF_SIZE);
+}
+
+template <AlignMode Mode>
+static void TransposeObliviousOMP(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t threads = 0) {
+	bool aligned = IsAligned16<Mode>(M, T, lda, ldb);
+
+	const int N_THREADS = OmpThreads(threads);
+	uint32_t LEAF_SIZE_OMP = GetTuningProfile().leaf_size_omp;
+	uint32_t LEAF_SIZE = GetTuningProfile().leaf_size;
+	uint32_t task_depth = CacheObliviousTaskDepth(uint32_t(N_THREADS));
+
+#pragma omp parallel num_threads(N_THREADS)
+#pragma omp single nowait
+	{
+		if (aligned)
+			matTransposeCacheObliviousImpOMP<true>(M, T, lda, ldb, rows, cols, 0, 0, LEAF_SIZE_OMP, LEAF_SIZE,
+				task_depth);
+		else
+			matTransposeCacheObliviousImpOMP<false>(M, T, lda, ldb, rows, cols, 0, 0, LEAF_SIZE_OMP, LEAF_SIZE,
+				task_depth);
+	}
+}
+
+void matTransposeCacheOblivious(MatType const* M, MatType* T, uint32_t N) {
+	matTransposeCacheOblivious(M, T, N, N, N, N);
+}
+
+void matTransposeCacheOblivious(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	TransposeOblivious<AlignMode::Runtime>(M, T, rows, cols, lda, ldb);
+}
+
+void matTransposeCacheObliviousOMP(MatType const* M, MatType* T, uint32_t N) {
+	matTransposeCacheObliviousOMP(M, T, N, N, N, N);
+}
+
+void matTransposeCacheObliviousOMP(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	TransposeObliviousOMP<AlignMode::Runtime>(M, T, rows, cols, lda, ldb);
+}
+
+//Non temporal stores bypass the cache, which avoids 
+//reading each line of T before writing it (read for ownership)
+//and keeps the lines of M in the cache.
+//Only worth it when the matrices do not fit in the LLC,
+//otherwise T would be evicted to memory for nothing.
+//Streaming stores need T rows aligned to 16 bytes,
+//if that is not the case use the normal kernels
+void matTransposeStream(MatType const* M, MatType* T, uint32_t N) {
+	matTransposeStream(M, T, N, N, N, N);
+}
+
+void matTransposeStream(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	if ((unsigned long long)(T) % 16 != 0 || ldb % 4 != 0) {
+		matTransposeImp(M, T, rows, cols, lda, ldb);
+		return;
+	}
+
+	TransposeTilesAndEdges(M, T, rows, cols, lda, ldb, false, 0, true);
+}
+
+void matTransposeStreamOMP(MatType const* M, MatType* T, uint32_t N) {
+	matTransposeStreamOMP(M, T, N, N, N, N);
+}
+
+static void TransposeStreamOMP(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t threads) {
+	if ((unsigned long long)(T) % 16 != 0 || ldb % 4 != 0) {
+		TransposeBlocked<AlignMode::Runtime>(M, T, rows, cols, lda, ldb, true, threads);
+		return;
+	}
+
+	TransposeTilesAndEdges(M, T, rows, cols, lda, ldb, true, threads, true);
+}
+
+void matTransposeStreamOMP(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	TransposeStreamOMP(M, T, rows, cols, lda, ldb, 0);
+}
+
+void matTransposeFinal(MatType const* M, MatType* T, uint32_t N) {
+	matTransposeFinal(M, T, N, N, N, N);
+}
+
+void matTransposeFinal(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	//Thresholds and kernels come from the tuning profile,
+	//the defaults are: Imp below 512x512 elements, OMP above,
+	//cache oblivious versions if both dimensions are
+	//powers of two
+	TuningProfile const& profile = GetTuningProfile();
+
+#ifdef CONSTEXPR_N
+	//Square contiguous matrices of a size with
+	//a fixed kernel skip ComputeBlockSize and edges
+	if (rows == cols && lda == rows && ldb == rows) {
+		FixedKernels const* fixed = GetFixedKernels(rows);
+
+		if (fixed != nullptr) {
+			fixed->transpose(M, T);
+			return;
+		}
+	}
+#endif // CONSTEXPR_N
+
+	uint64_t elements = uint64_t(rows) * cols;
+
+	//Way bigger than the LLC, the stores to T
+	//would only waste bandwidth on RFO
+	if (elements * sizeof(MatType) >= profile.stream_bytes) {
+		matTransposeStreamOMP(M, T, rows, cols, lda, ldb);
+		return;
+	}
+
+	uint32_t size_class = uint32_t(elements >= profile.large_elements) << 1;
+	size_class |= uint32_t((rows & (rows - 1)) == 0 && (cols & (cols - 1)) == 0);
+
+	//The tuned count is an upper bound, a caller
+	//that asks for fewer threads still gets them
+	uint32_t threads = profile.threads[size_class];
+
+	if (threads != 0)
+		threads = std::min(threads, uint32_t(omp_get_max_threads()));
+
+	matTransposeKernel(profile.kernels[size_class], M, T, rows, cols, lda, ldb, threads);
+}
+
+void matTransposeKernel(TransposeKernel kernel, MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t threads) {
+	switch (kernel) {
+	case TransposeKernel::Oblivious:
+		TransposeOblivious<AlignMode::Runtime>(M, T, rows, cols, lda, ldb);
+		break;
+	case TransposeKernel::OMP:
+		TransposeBlocked<AlignMode::Runtime>(M, T, rows, cols, lda, ldb, true, threads);
+		break;
+	case TransposeKernel::ObliviousOMP:
+		TransposeObliviousOMP<AlignMode::Runtime>(M, T, rows, cols, lda, ldb, threads);
+		break;
+	case TransposeKernel::StreamOMP:
+		TransposeStreamOMP(M, T, rows, cols, lda, ldb, threads);
+		break;
+	case TransposeKernel::Hier:
+		TransposeHier<AlignMode::Runtime>(M, T, rows, cols, lda, ldb, false);
+		break;
+	case TransposeKernel::HierOMP:
+		TransposeHier<AlignMode::Runtime>(M, T, rows, cols, lda, ldb, true, threads);
+		break;
+	case TransposeKernel::Pool:
+		TransposePool(GetDefaultThreadPool(), uint32_t(OmpThreads(threads)), M, T, rows, cols, lda, ldb);
+		break;
+	default:
+		TransposeBlocked<AlignMode::Runtime>(M, T, rows, cols, lda, ldb, false);
+		break;
+	}
+}
+
+//////////////////////////////////////////
+//MATRIX VIEWS
+
+//Rows and cols come from M, each view brings its own
+//leading dimension. The alignment is part of the type,
+//so the kernel is picked without looking at the pointers
+
+void matTranspose(MatrixView<MatType const> M, MatrixView<MatType> T) {
+	matTranspose(M.Data(), T.Data(), M.Rows(), M.Cols(), M.LeadingDim(), T.LeadingDim());
+}
+
+void matTransposeImp(MatrixView<MatType const, true> M, MatrixView<MatType, true> T) {
+	TransposeBlocked<AlignMode::Aligned>(M.Data(), T.Data(), M.Rows(), M.Cols(), M.LeadingDim(), T.LeadingDim(), false);
+}
+
+void matTransposeImp(MatrixView<MatType const> M, MatrixView<MatType> T) {
+	TransposeBlocked<AlignMode::Unaligned>(M.Data(), T.Data(), M.Rows(), M.Cols(), M.LeadingDim(), T.LeadingDim(), false);
+}
+
+void matTransposeOMP(MatrixView<MatType const, true> M, MatrixView<MatType, true> T) {
+	TransposeBlocked<AlignMode::Aligned>(M.Data(), T.Data(), M.Rows(), M.Cols(), M.LeadingDim(), T.LeadingDim(), true);
+}
+
+void matTransposeOMP(MatrixView<MatType const> M, MatrixView<MatType> T) {
+	TransposeBlocked<AlignMode::Unaligned>(M.Data(), T.Data(), M.Rows(), M.Cols(), M.LeadingDim(), T.LeadingDim(), true);
+}
+
+void matTransposeCacheOblivious(MatrixView<MatType const, true> M, MatrixView<MatType, true> T) {
+	TransposeOblivious<AlignMode::Aligned>(M.Data(), T.Data(), M.Rows(), M.Cols(), M.LeadingDim(), T.LeadingDim());
+}
+
+void matTransposeCacheOblivious(MatrixView<MatType const> M, MatrixView<MatType> T) {
+	TransposeOblivious<AlignMode::Unaligned>(M.Data(), T.Data(), M.Rows(), M.Cols(), M.LeadingDim(), T.LeadingDim());
+}
+
+void matTransposeCacheObliviousOMP(MatrixView<MatType const, true> M, MatrixView<MatType, true> T) {
+	TransposeObliviousOMP<AlignMode::Aligned>(M.Data(), T.Data(), M.Rows(), M.Cols(), M.LeadingDim(), T.LeadingDim());
+}
+
+void matTransposeCacheObliviousOMP(MatrixView<MatType const> M, MatrixView<MatType> T) {
+	TransposeObliviousOMP<AlignMode::Unaligned>(M.Data(), T.Data(), M.Rows(), M.Cols(), M.LeadingDim(), T.LeadingDim());
+}
+
+void matTransposeHier(MatrixView<MatType const, true> M, MatrixView<MatType, true> T) {
+	TransposeHier<AlignMode::Aligned>(M.Data(), T.Data(), M.Rows(), M.Cols(), M.LeadingDim(), T.LeadingDim(), false);
+}
+
+void matTransposeHier(MatrixView<MatType const> M, MatrixView<MatType> T) {
+	TransposeHier<AlignMode::Unaligned>(M.Data(), T.Data(), M.Rows(), M.Cols(), M.LeadingDim(), T.LeadingDim(), false);
+}
+
+void matTransposeHierOMP(MatrixView<MatType const, true> M, MatrixView<MatType, true> T) {
+	TransposeHier<AlignMode::Aligned>(M.Data(), T.Data(), M.Rows(), M.Cols(), M.LeadingDim(), T.LeadingDim(), true);
+}
+
+void matTransposeHierOMP(MatrixView<MatType const> M, MatrixView<MatType> T) {
+	TransposeHier<AlignMode::Unaligned>(M.Data(), T.Data(), M.Rows(), M.Cols(), M.LeadingDim(), T.LeadingDim(), true);
+}
+
+//Kernels come from the tuning profile,
+//the profile kernels check the pointers
+void matTransposeFinal(MatrixView<MatType const> M, MatrixView<MatType> T) {
+	matTransposeFinal(M.Data(), T.Data(), M.Rows(), M.Cols(), M.LeadingDim(), T.LeadingDim());
+}
+
+//A matrix that is not square is not symmetric
+
+bool checkSymFast(MatrixView<MatType const> M) {
+	return M.IsSquare() && CheckSymFast(M.Data(), M.Rows(), M.LeadingDim());
+}
+
+bool checkSymFastOMP(MatrixView<MatType const> M) {
+	return M.IsSquare() && CheckSymFastOMP(M.Data(), M.Rows(), M.LeadingDim());
+}
+
+bool checkSymSIMD(MatrixView<MatType const> M) {
+	return M.IsSquare() && CheckSymSIMD(M.Data(), M.Rows(), M.LeadingDim());
+}
+
+bool checkSymSIMD_OMP(MatrixView<MatType const> M) {
+	return M.IsSquare() && CheckSymSIMD_OMP(M.Data(), M.Rows(), M.LeadingDim());
+}
+
+//////////////////////////////////////////
+//IN PLACE TRANSPOSE
+
+//Unoptimized in place transpose, 
+//swap each element above the diagonal
+//with its mirror
+void matTransposeInPlace(MatType* M, uint32_t N) {
+	for (uint32_t row_idx = 0; row_idx < N; row_idx++) {
+		for (uint32_t col_idx = row_idx + 1; col_idx < N; col_idx++) {
+			std::swap(M[row_idx * N + col_idx], M[col_idx * N + row_idx]);
+		}
+	}
+}
+
+//Same tiling as matTransposeImp, but each block
+//in the upper triangle is swapped with its mirror,
+//so that no second N*N buffer is needed
+//and every element is read and written once
+void matTransposeInPlaceImp(MatType* M, uint32_t N) {
+	uint32_t BLOCK_SIZE = ComputeBlockSize(N, CACHE_LINE_SIZE);
+
+	if (BLOCK_SIZE % 4 == 0) {
+		if ((unsigned long long)(M) % 16 == 0) {
+			BlockTransposeInPlace_SSE<true>(M, N, BLOCK_SIZE);
 		}
 		else {
-			BlockTranspose_SSE<false>(M, T, N, BLOCK_SIZE);
+			BlockTransposeInPlace_SSE<false>(M, N, BLOCK_SIZE);
 		}
 	}
 	else {
-		BlockTranspose_NoSSE(M, T, N, BLOCK_SIZE);
+		BlockTransposeInPlace_NoSSE(M, N, BLOCK_SIZE);
 	}
 }
 
-void matTransposeOMP(MatType const* M, MatType* T, uint32_t N) {
+void matTransposeInPlaceOMP(MatType* M, uint32_t N) {
 	uint32_t BLOCK_SIZE = ComputeBlockSize(N, CACHE_LINE_SIZE);
 
 	if (BLOCK_SIZE % 4 == 0) {
-		if ((unsigned long long)(M) % 16 == 0 && (unsigned long long)(T) % 16 == 0) {
-			BlockTranspose_SSE_OMP<true>(M, T, N, BLOCK_SIZE);
+		if ((unsigned long long)(M) % 16 == 0) {
+			BlockTransposeInPlace_SSE_OMP<true>(M, N, BLOCK_SIZE);
 		}
 		else {
-			BlockTranspose_SSE_OMP<false>(M, T, N, BLOCK_SIZE);
+			BlockTransposeInPlace_SSE_OMP<false>(M, N, BLOCK_SIZE);
 		}
 	}
 	else {
-		BlockTranspose_NoSSE_OMP(M, T, N, BLOCK_SIZE);
+		BlockTransposeInPlace_NoSSE_OMP(M, N, BLOCK_SIZE);
 	}
 }
 
-void matTransposeCacheOblivious(MatType const* M, MatType* T, uint32_t N) {
-	matTransposeCacheObliviousImp(M, T, N, N, 0, 0);
+//////////////////////////////////////////
+//SYMMETRIC / SKEW-SYMMETRIC PARTS
+
+//Reads the tile at (row, col) and its mirror at (col, row)
+//once, transposes both in registers and writes
+//S = (A + A^T) / 2 and K = (A - A^T) / 2 for both tiles.
+//Every load happens before the first store,
+//so S can be the same matrix as M
+template <bool Sym, bool Skew>
+static inline void SymSkewTile4x4(MatType const* M, MatType* S, MatType* K, uint32_t N,
+	uint32_t row, uint32_t col) {
+	const __m128 half = _mm_set1_ps(0.5f);
+
+	__m128 upper[4], lower[4], upper_t[4], lower_t[4];
+
+	for (uint32_t idx = 0; idx < 4; idx++) {
+		upper[idx] = upper_t[idx] = _mm_loadu_ps(&M[size_t(row + idx) * N + col]);
+		lower[idx] = lower_t[idx] = _mm_loadu_ps(&M[size_t(col + idx) * N + row]);
+	}
+
+	Transpose4x4_Regs(upper_t[0], upper_t[1], upper_t[2], upper_t[3]);
+	Transpose4x4_Regs(lower_t[0], lower_t[1], lower_t[2], lower_t[3]);
+
+	for (uint32_t idx = 0; idx < 4; idx++) {
+		if (Sym) {
+			_mm_storeu_ps(&S[size_t(row + idx) * N + col], _mm_mul_ps(_mm_add_ps(upper[idx], lower_t[idx]), half));
+			_mm_storeu_ps(&S[size_t(col + idx) * N + row], _mm_mul_ps(_mm_add_ps(lower[idx], upper_t[idx]), half));
+		}
+
+		if (Skew) {
+			_mm_storeu_ps(&K[size_t(row + idx) * N + col], _mm_mul_ps(_mm_sub_ps(upper[idx], lower_t[idx]), half));
+			_mm_storeu_ps(&K[size_t(col + idx) * N + row], _mm_mul_ps(_mm_sub_ps(lower[idx], upper_t[idx]), half));
+		}
+	}
 }
 
-void matTransposeCacheObliviousOMP(MatType const* M, MatType* T, uint32_t N) {
-#pragma omp parallel
-#pragma omp single nowait
-	{
-		matTransposeCacheObliviousImpOMP(M, T, N, N, 0, 0);
+//Tile pairs of a block row of the upper triangle,
+//same walk as CompareBlockRow4x4
+template <bool Sym, bool Skew>
+static void SymSkewBlockRow(MatType const* M, MatType* S, MatType* K, uint32_t N,
+	uint32_t row_idx, uint32_t N_TILES, uint32_t BLOCK_SIZE) {
+	uint32_t row_bound = std::min(row_idx + BLOCK_SIZE, N_TILES);
+
+	for (uint32_t col_idx = row_idx; col_idx < N_TILES; col_idx += BLOCK_SIZE) {
+		uint32_t col_bound = std::min(col_idx + BLOCK_SIZE, N_TILES);
+
+		for (uint32_t row_block = row_idx; row_block < row_bound; row_block += 4) {
+			for (uint32_t col_block = std::max(col_idx, row_block); col_block < col_bound; col_block += 4) {
+				SymSkewTile4x4<Sym, Skew>(M, S, K, N, row_block, col_block);
+			}
+		}
 	}
 }
 
-void matTransposeFinal(MatType const* M, MatType* T, uint32_t N) {
-	using Dispatch = void(*)(MatType const* M, MatType* T, uint32_t N);
+//Pairs with the column past the last full tile, scalar
+template <bool Sym, bool Skew>
+static void SymSkewEdge(MatType const* M, MatType* S, MatType* K, uint32_t N, uint32_t N_TILES,
+	uint32_t row_begin, uint32_t row_end) {
+	for (uint32_t row_idx = row_begin; row_idx < row_end; row_idx++) {
+		for (uint32_t col_idx = std::max(N_TILES, row_idx); col_idx < N; col_idx++) {
+			MatType a = M[size_t(row_idx) * N + col_idx];
+			MatType b = M[size_t(col_idx) * N + row_idx];
+
+			if (Sym) {
+				S[size_t(row_idx) * N + col_idx] = (a + b) * 0.5f;
+				S[size_t(col_idx) * N + row_idx] = (b + a) * 0.5f;
+			}
 
-	static const Dispatch jmp_table[] =
+			if (Skew) {
+				K[size_t(row_idx) * N + col_idx] = (a - b) * 0.5f;
+				K[size_t(col_idx) * N + row_idx] = (b - a) * 0.5f;
+			}
+		}
+	}
+}
+
+template <bool Sym, bool Skew>
+static void SymSkewImpl(MatType const* M, MatType* S, MatType* K, uint32_t N, bool use_omp) {
+	const uint32_t BLOCK_SIZE = RECOMMENDED_BLOCK_SZ;
+	const uint32_t N_TILES = N - N % 4;
+
+#pragma omp parallel if(use_omp)
 	{
-		matTransposeImp,
-		matTransposeCacheOblivious,
-		matTransposeOMP,
-		matTransposeCacheObliviousOMP
-	};
+		//Block rows get shorter going down
+#pragma omp for schedule(dynamic) nowait
+		for (uint32_t row_idx = 0; row_idx < N_TILES; row_idx += BLOCK_SIZE) {
+			SymSkewBlockRow<Sym, Skew>(M, S, K, N, row_idx, N_TILES, BLOCK_SIZE);
+		}
 
-	uint32_t index = uint32_t(N >= 512) << 1;
-	index |= uint32_t((N & (N - 1)) == 0);
+		//Disjoint from the tiles, no need to wait
+#pragma omp for schedule(static)
+		for (uint32_t row_idx = 0; row_idx < N; row_idx += BLOCK_SIZE) {
+			SymSkewEdge<Sym, Skew>(M, S, K, N, N_TILES, row_idx, std::min(row_idx + BLOCK_SIZE, N));
+		}
+	}
+}
 
-	jmp_table[index](M, T, N);
-}
\ No newline at end of file
+static void SymSkewDispatch(MatType const* M, MatType* S, MatType* K, uint32_t N, bool use_omp) {
+	if (S != nullptr && K != nullptr)
+		SymSkewImpl<true, true>(M, S, K, N, use_omp);
+	else if (S != nullptr)
+		SymSkewImpl<true, false>(M, S, K, N, use_omp);
+	else if (K != nullptr)
+		SymSkewImpl<false, true>(M, S, K, N, use_omp);
+}
+
+void matSymSkew(MatType const* M, MatType* S, MatType* K, uint32_t N) {
+	SymSkewDispatch(M, S, K, N, false);
+}
+
+void matSymSkewOMP(MatType const* M, MatType* S, MatType* K, uint32_t N) {
+	SymSkewDispatch(M, S, K, N, true);
+}
+
+void matSymmetrizeInPlace(MatType* M, uint32_t N) {
+	SymSkewImpl<true, false>(M, M, nullptr, N, false);
+}
+
+void matSymmetrizeInPlaceOMP(MatType* M, uint32_t N) {
+	SymSkewImpl<true, false>(M, M, nullptr, N, true);
+}
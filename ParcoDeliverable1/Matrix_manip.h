@@ -2,12 +2,66 @@
 #define PARCO_MANIP
 
 #include "Defs.h"
+#include "Matrix_view.h"
+#include "Thread_pool.h"
+#include "Tuning.h"
 
-bool checkSym(MatType* M, uint32_t N);
+bool checkSym(MatType const* M, uint32_t N);
 
-bool checkSymImp(MatType* M, uint32_t N);
+bool checkSymImp(MatType const* M, uint32_t N);
 
-bool checkSymOMP(MatType* M, uint32_t N);
+bool checkSymOMP(MatType const* M, uint32_t N);
+
+//The versions above scan the whole matrix even after
+//a mismatch, to compare the implementations fairly.
+//These ones stop at the first mismatch, in the OMP
+//version every thread stops at its next tile
+
+bool checkSymFast(MatType const* M, uint32_t N);
+
+bool checkSymFastOMP(MatType const* M, uint32_t N);
+
+//Full scan, 4x4 tiles of the upper triangle are compared
+//with the mirrored tiles transposed in registers,
+//instead of reading the lower triangle by columns
+
+bool checkSymSIMD(MatType const* M, uint32_t N);
+
+bool checkSymSIMD_OMP(MatType const* M, uint32_t N);
+
+//Same tiles as checkSymSIMD, block rows spread over the
+//threads of a ThreadPool, every thread stops at its next
+//block row after a mismatch. Without a pool the default
+//one is used, with omp_get_max_threads() threads
+
+bool checkSymPool(MatType const* M, uint32_t N);
+
+bool checkSymPool(ThreadPool& pool, MatType const* M, uint32_t N);
+
+//Largest |M[row][col] - M[col][row]| found by
+//the tolerance checks, with row < col.
+//On ties it can be any of the pairs
+struct SymDeviation {
+	MatType max_dev;
+	uint32_t row;
+	uint32_t col;
+};
+
+//Symmetry up to rounding: every pair must satisfy
+//|a - b| <= max(abs_tol, rel_tol * max(|a|, |b|)).
+//NaN never passes. If deviation is not null it receives
+//the largest deviation, from the same pass over the matrix,
+//a pair with a NaN is reported as an infinite deviation.
+//Imp and OMP compare 4x4 tiles like checkSymSIMD
+
+bool checkSymTol(MatType const* M, uint32_t N, MatType abs_tol, MatType rel_tol,
+	SymDeviation* deviation = nullptr);
+
+bool checkSymTolImp(MatType const* M, uint32_t N, MatType abs_tol, MatType rel_tol,
+	SymDeviation* deviation = nullptr);
+
+bool checkSymTolOMP(MatType const* M, uint32_t N, MatType abs_tol, MatType rel_tol,
+	SymDeviation* deviation = nullptr);
 
 void matTranspose(MatType const* M, MatType* T, uint32_t N);
 
@@ -21,4 +75,223 @@ void matTransposeCacheObliviousOMP(MatType const* M, MatType* T, uint32_t N);
 
 void matTransposeFinal(MatType const* M, MatType* T, uint32_t N);
 
+//Rectangular versions: M has rows x cols elements,
+//row r starting at M + r * lda, and T receives
+//the cols x rows transpose, row c starting at
+//T + c * ldb. The square versions above are
+//the same as calling these with (N, N, N, N)
+
+void matTranspose(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb);
+
+void matTransposeImp(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb);
+
+void matTransposeOMP(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb);
+
+void matTransposeCacheOblivious(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb);
+
+void matTransposeCacheObliviousOMP(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb);
+
+void matTransposeFinal(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb);
+
+//One of the kernels matTransposeFinal dispatches to. threads goes
+//to the num_threads of its parallel regions (or is the number of
+//pool threads), 0 is the OpenMP default, the serial kernels ignore it
+
+void matTransposeKernel(TransposeKernel kernel, MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t threads);
+
+//Two level tiling: outer tiles sized for the L2 (detected
+//at runtime, see GetCacheSizes), walked in L1 sized blocks
+//of register tiles. Any N gets full tiles, the strips
+//left are done by the edge kernel
+
+void matTransposeHier(MatType const* M, MatType* T, uint32_t N);
+
+void matTransposeHier(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb);
+
+void matTransposeHierOMP(MatType const* M, MatType* T, uint32_t N);
+
+void matTransposeHierOMP(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb);
+
+void matTransposeStream(MatType const* M, MatType* T, uint32_t N);
+
+void matTransposeStream(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb);
+
+void matTransposeStreamOMP(MatType const* M, MatType* T, uint32_t N);
+
+void matTransposeStreamOMP(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb);
+
+//Bands of rows transposed by the serial blocked kernels
+//on the threads of a ThreadPool, which stay alive between
+//calls: no parallel region is opened, so small and medium
+//matrices gain from more cores too. Without a pool the
+//default one is used, with omp_get_max_threads() threads
+
+void matTransposePool(MatType const* M, MatType* T, uint32_t N);
+
+void matTransposePool(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb);
+
+void matTransposePool(ThreadPool& pool, MatType const* M, MatType* T, uint32_t N);
+
+void matTransposePool(ThreadPool& pool, MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb);
+
+//Many small square matrices: the threads split the batch,
+//every matrix is transposed by a single thread with 4x4
+//register tiles. N = 4, 8, 16, 32, 64, 128 and 256 use the
+//fixed size kernels (Matrix_fixed.h), the others the
+//matTransposeImp path.
+//M[i] (N[i] x N[i]) is transposed into T[i]
+
+void matTransposeBatched(MatType const* const* M, MatType* const* T, uint32_t const* N, uint32_t count);
+
+//count N x N matrices, the i-th one at M + i * stride_M
+//and T + i * stride_T (a stride of 0 means N * N)
+
+void matTransposeBatchedStrided(MatType const* M, MatType* T, uint32_t N, uint32_t count,
+	size_t stride_M = 0, size_t stride_T = 0);
+
+//true if every matrix is symmetric. If results is not null
+//results[i] receives the answer for M[i], otherwise the
+//checks stop at the first asymmetric matrix
+
+bool checkSymBatched(MatType const* const* M, uint32_t const* N, uint32_t count, bool* results = nullptr);
+
+bool checkSymBatchedStrided(MatType const* M, uint32_t N, uint32_t count, size_t stride = 0,
+	bool* results = nullptr);
+
+void matTransposeInPlace(MatType* M, uint32_t N);
+
+void matTransposeInPlaceImp(MatType* M, uint32_t N);
+
+void matTransposeInPlaceOMP(MatType* M, uint32_t N);
+
+//S = (M + M^T) / 2 and K = (M - M^T) / 2 in a single
+//pass over M, without the intermediate transpose.
+//Either S or K can be null to skip that part.
+//S is exactly symmetric, K exactly skew-symmetric
+
+void matSymSkew(MatType const* M, MatType* S, MatType* K, uint32_t N);
+
+void matSymSkewOMP(MatType const* M, MatType* S, MatType* K, uint32_t N);
+
+//M = (M + M^T) / 2
+
+void matSymmetrizeInPlace(MatType* M, uint32_t N);
+
+void matSymmetrizeInPlaceOMP(MatType* M, uint32_t N);
+
+//MatrixView versions: M is rows x cols, T receives the
+//cols x rows transpose, each view with its own leading
+//dimension. With two aligned views (e.g. two Matrix objects)
+//the aligned kernels are selected at compile time, with
+//any other view the unaligned ones, the pointers
+//are never checked
+
+void matTranspose(MatrixView<MatType const> M, MatrixView<MatType> T);
+
+void matTransposeImp(MatrixView<MatType const, true> M, MatrixView<MatType, true> T);
+
+void matTransposeImp(MatrixView<MatType const> M, MatrixView<MatType> T);
+
+void matTransposeOMP(MatrixView<MatType const, true> M, MatrixView<MatType, true> T);
+
+void matTransposeOMP(MatrixView<MatType const> M, MatrixView<MatType> T);
+
+void matTransposeCacheOblivious(MatrixView<MatType const, true> M, MatrixView<MatType, true> T);
+
+void matTransposeCacheOblivious(MatrixView<MatType const> M, MatrixView<MatType> T);
+
+void matTransposeCacheObliviousOMP(MatrixView<MatType const, true> M, MatrixView<MatType, true> T);
+
+void matTransposeCacheObliviousOMP(MatrixView<MatType const> M, MatrixView<MatType> T);
+
+void matTransposeHier(MatrixView<MatType const, true> M, MatrixView<MatType, true> T);
+
+void matTransposeHier(MatrixView<MatType const> M, MatrixView<MatType> T);
+
+void matTransposeHierOMP(MatrixView<MatType const, true> M, MatrixView<MatType, true> T);
+
+void matTransposeHierOMP(MatrixView<MatType const> M, MatrixView<MatType> T);
+
+void matTransposeFinal(MatrixView<MatType const> M, MatrixView<MatType> T);
+
+//Symmetry checks of a square view, false if it is not square
+
+bool checkSymFast(MatrixView<MatType const> M);
+
+bool checkSymFastOMP(MatrixView<MatType const> M);
+
+bool checkSymSIMD(MatrixView<MatType const> M);
+
+bool checkSymSIMD_OMP(MatrixView<MatType const> M);
+
+//Versions for other element types, defined in Matrix_typed.cpp
+//and instantiated for int8_t, uint8_t, int16_t, uint16_t,
+//int32_t, uint32_t, double and std::complex<float>.
+//For MatType the functions above are picked instead, with
+//const and non const pointers alike, they have the AVX kernels
+
+template <typename Elem>
+bool checkSym(Elem const* M, uint32_t N);
+
+template <typename Elem>
+bool checkSymImp(Elem const* M, uint32_t N);
+
+template <typename Elem>
+bool checkSymOMP(Elem const* M, uint32_t N);
+
+template <typename Elem>
+void matTranspose(Elem const* M, Elem* T, uint32_t N);
+
+template <typename Elem>
+void matTranspose(Elem const* M, Elem* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb);
+
+template <typename Elem>
+void matTransposeImp(Elem const* M, Elem* T, uint32_t N);
+
+template <typename Elem>
+void matTransposeImp(Elem const* M, Elem* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb);
+
+template <typename Elem>
+void matTransposeOMP(Elem const* M, Elem* T, uint32_t N);
+
+template <typename Elem>
+void matTransposeOMP(Elem const* M, Elem* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb);
+
+template <typename Elem>
+void matTransposeCacheOblivious(Elem const* M, Elem* T, uint32_t N);
+
+template <typename Elem>
+void matTransposeCacheOblivious(Elem const* M, Elem* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb);
+
+template <typename Elem>
+void matTransposeCacheObliviousOMP(Elem const* M, Elem* T, uint32_t N);
+
+template <typename Elem>
+void matTransposeCacheObliviousOMP(Elem const* M, Elem* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb);
+
+template <typename Elem>
+void matTransposeFinal(Elem const* M, Elem* T, uint32_t N);
+
+template <typename Elem>
+void matTransposeFinal(Elem const* M, Elem* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb);
+
 #endif // !PARCO_MANIP
@@ -0,0 +1,227 @@
+#include "Matrix_ooc.h"
+#include "Matrix_manip.h"
+#include "Matrix_alloc.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//Sides of a tile are a multiple of the register
+//tiles, so only the last tiles have edge strips
+static constexpr uint32_t OOC_TILE_STEP = 16;
+
+OutOfCoreOptions DefaultOutOfCoreOptions() {
+	return OutOfCoreOptions{ uint64_t(1) << 30, true };
+}
+
+struct TileSize {
+	uint32_t rows;
+	uint32_t cols;
+};
+
+//Elements of a side that fit in the budget, rounded
+//down to the step, at least one step and at most size
+static uint32_t TileSide(uint64_t elements, uint32_t size) {
+	uint64_t side = elements >= OOC_TILE_STEP ? elements / OOC_TILE_STEP * OOC_TILE_STEP : OOC_TILE_STEP;
+	return uint32_t(std::min<uint64_t>(side, size));
+}
+
+//The mapped input tile and the two transposed buffers
+//(one transposed, one written) share the budget. Tiles
+//are square so that the runs read (one per row of the
+//tile) and the runs written (one per column) are equally
+//long, a thin matrix gives its spare side to the other
+static TileSize ComputeTileSize(uint32_t rows, uint32_t cols, uint64_t max_buffer_bytes) {
+	const uint64_t ELEMENTS = max_buffer_bytes / (3 * sizeof(MatType));
+
+	TileSize tile;
+	tile.cols = TileSide(uint64_t(std::sqrt(double(ELEMENTS))), cols);
+	tile.rows = TileSide(ELEMENTS / tile.cols, rows);
+
+	if (tile.rows == rows)
+		tile.cols = TileSide(ELEMENTS / tile.rows, cols);
+
+	return tile;
+}
+
+//pwrite can write less than asked
+static bool WriteAll(int fd, char const* data, size_t bytes, off_t offset) {
+	while (bytes > 0) {
+		ssize_t written = pwrite(fd, data, bytes, offset);
+
+		if (written <= 0)
+			return false;
+
+		data += written;
+		bytes -= size_t(written);
+		offset += written;
+	}
+
+	return true;
+}
+
+//Row c of the transposed tile is the piece
+//[r0, r0 + tile_rows) of row c0 + c of the output
+static bool WriteTile(int fd, MatType const* tile, uint32_t tile_rows, uint32_t tile_cols,
+	uint32_t rows, uint32_t r0, uint32_t c0) {
+	for (uint32_t c = 0; c < tile_cols; c++) {
+		off_t offset = off_t((uint64_t(c0 + c) * rows + r0) * sizeof(MatType));
+
+		if (!WriteAll(fd, reinterpret_cast<char const*>(tile + size_t(c) * tile_rows),
+			size_t(tile_rows) * sizeof(MatType), offset))
+			return false;
+	}
+
+	return true;
+}
+
+//Calls madvise on the piece of each row of the tile, widened
+//to whole pages. Pages shared with the next tile are faulted
+//again from the page cache, which is cheap
+static void AdviseTile(char const* in_bytes, uint32_t r0, uint32_t c0, uint32_t tile_rows, uint32_t tile_cols,
+	uint32_t cols, uint64_t page, int advice) {
+	for (uint32_t r = r0; r < r0 + tile_rows; r++) {
+		uint64_t begin = (uint64_t(r) * cols + c0) * sizeof(MatType);
+		uint64_t end = begin + uint64_t(tile_cols) * sizeof(MatType);
+
+		begin = begin / page * page;
+		end = (end + page - 1) / page * page;
+
+		madvise(const_cast<char*>(in_bytes) + begin, end - begin, advice);
+	}
+}
+
+bool matTransposeFile(const char* in_path, const char* out_path, uint32_t rows, uint32_t cols,
+	OutOfCoreOptions const& options) {
+	const uint64_t BYTES = uint64_t(rows) * cols * sizeof(MatType);
+
+	int in_fd = open(in_path, O_RDONLY);
+
+	if (in_fd < 0)
+		return false;
+
+	struct stat in_stat;
+
+	if (fstat(in_fd, &in_stat) != 0 || uint64_t(in_stat.st_size) != BYTES) {
+		close(in_fd);
+		return false;
+	}
+
+	int out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (out_fd < 0) {
+		close(in_fd);
+		return false;
+	}
+
+	if (BYTES == 0) {
+		close(in_fd);
+		return close(out_fd) == 0;
+	}
+
+	//Allocate the whole output now, the tiles
+	//fill it in no particular order
+	bool ok = ftruncate(out_fd, off_t(BYTES)) == 0;
+
+	void* mapped = ok ? mmap(nullptr, BYTES, PROT_READ, MAP_SHARED, in_fd, 0) : MAP_FAILED;
+	ok = mapped != MAP_FAILED;
+
+	const TileSize TILE = ComputeTileSize(rows, cols, options.max_buffer_bytes);
+	const uint64_t PAGE = uint64_t(sysconf(_SC_PAGESIZE));
+
+	//Not touched by first touch, they are only
+	//written by the transposes
+	MatrixAllocOptions buffer_options{ HugePages::Transparent, NumaPolicy::None, 0 };
+	MatType* buffers[2] = { nullptr, nullptr };
+
+	if (ok) {
+		buffers[0] = AllocateMatrix(TILE.cols, TILE.rows, buffer_options);
+		buffers[1] = AllocateMatrix(TILE.cols, TILE.rows, buffer_options);
+		ok = buffers[0] != nullptr && buffers[1] != nullptr;
+	}
+
+	char const* in_bytes = static_cast<char const*>(mapped);
+	MatType const* in = static_cast<MatType const*>(mapped);
+
+	//At most one tile is being written, while the
+	//next one is transposed in the other buffer
+	std::thread writer;
+	bool write_ok = true;
+	uint64_t dropped = 0;
+	uint32_t tile_idx = 0;
+
+	if (ok)
+		AdviseTile(in_bytes, 0, 0, TILE.rows, TILE.cols, cols, PAGE, MADV_WILLNEED);
+
+	//Tiles in row major order, the input is read
+	//one band of tile rows at a time
+	for (uint32_t r0 = 0; ok && write_ok && r0 < rows; r0 += TILE.rows) {
+		const uint32_t NR = std::min(TILE.rows, rows - r0);
+
+		for (uint32_t c0 = 0; c0 < cols; c0 += TILE.cols, tile_idx++) {
+			const uint32_t NC = std::min(TILE.cols, cols - c0);
+
+			//Start reading the next tile while this one is transposed
+			uint32_t next_r0 = c0 + NC < cols ? r0 : r0 + NR;
+			uint32_t next_c0 = c0 + NC < cols ? c0 + NC : 0;
+
+			if (next_r0 < rows) {
+				AdviseTile(in_bytes, next_r0, next_c0, std::min(TILE.rows, rows - next_r0),
+					std::min(TILE.cols, cols - next_c0), cols, PAGE, MADV_WILLNEED);
+			}
+
+			MatType* buffer = buffers[tile_idx % 2];
+			MatType const* tile = in + size_t(r0) * cols + c0;
+
+			if (options.use_omp)
+				matTransposeOMP(tile, buffer, NR, NC, cols, NR);
+			else
+				matTransposeImp(tile, buffer, NR, NC, cols, NR);
+
+			//Unmap the pages of the tile, the resident input
+			//stays at about one tile
+			AdviseTile(in_bytes, r0, c0, NR, NC, cols, PAGE, MADV_DONTNEED);
+
+			if (writer.joinable())
+				writer.join();
+
+			if (!write_ok)
+				break;
+
+			writer = std::thread([=, &write_ok]() {
+				write_ok = WriteTile(out_fd, buffer, NR, NC, rows, r0, c0);
+			});
+		}
+
+		//The band is done, drop it from the page cache, only
+		//whole pages: the last one can still hold rows of the next band
+		const uint64_t END = uint64_t(r0 + NR) * cols * sizeof(MatType);
+		uint64_t drop_end = END == BYTES ? BYTES : END / PAGE * PAGE;
+
+		if (drop_end > dropped) {
+			posix_fadvise(in_fd, off_t(dropped), off_t(drop_end - dropped), POSIX_FADV_DONTNEED);
+			dropped = drop_end;
+		}
+	}
+
+	if (writer.joinable())
+		writer.join();
+
+	ok = ok && write_ok;
+
+	FreeMatrix(buffers[0]);
+	FreeMatrix(buffers[1]);
+
+	if (mapped != MAP_FAILED)
+		munmap(mapped, BYTES);
+
+	close(in_fd);
+	ok = close(out_fd) == 0 && ok;
+
+	return ok;
+}
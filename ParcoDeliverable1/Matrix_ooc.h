@@ -0,0 +1,50 @@
+#ifndef PARCO_MATRIX_OOC
+#define PARCO_MATRIX_OOC
+
+#include "Defs.h"
+
+/// <summary>
+/// Options of the out of core transpose
+/// </summary>
+struct OutOfCoreOptions {
+	//Memory used for the mapped input tile plus the two
+	//transposed buffers. Tiles are at least 16 x 16
+	//(or the whole matrix, if it is smaller)
+	uint64_t max_buffer_bytes;
+	//Transpose the tiles with matTransposeOMP
+	//instead of matTransposeImp
+	bool use_omp;
+};
+
+/// <summary>
+/// 1 GB of buffers, OMP kernels
+/// </summary>
+/// <returns>Default options</returns>
+OutOfCoreOptions DefaultOutOfCoreOptions();
+
+/// <summary>
+/// Transposes a raw row major file of rows x cols MatType
+/// elements into out_path (cols x rows), for matrices that
+/// do not fit in memory. The input is mapped and read one
+/// square tile at a time, each tile is transposed in memory
+/// by the blocked SIMD kernels and written by a second
+/// thread while the next tile is transposed. A tile of
+/// S x S floats, S = sqrt(max_buffer_bytes / 12), is read
+/// as S float runs of its rows and written as S float runs
+/// of the output rows, about 37 KB with the default 1 GB:
+/// enough to keep both files sequential without the tiny
+/// pwrite per output row that bands of full input rows
+/// would need on wide matrices. Pages of the input are
+/// dropped after each tile, so the resident memory stays
+/// within the options
+/// </summary>
+/// <param name="in_path">Input file, rows * cols * sizeof(MatType) bytes</param>
+/// <param name="out_path">Output file, created or truncated</param>
+/// <param name="rows">Rows of the input</param>
+/// <param name="cols">Columns of the input</param>
+/// <param name="options">Memory bound and kernel</param>
+/// <returns>false if a file could not be opened, has the wrong size or an I/O call failed</returns>
+bool matTransposeFile(const char* in_path, const char* out_path, uint32_t rows, uint32_t cols,
+	OutOfCoreOptions const& options);
+
+#endif // !PARCO_MATRIX_OOC
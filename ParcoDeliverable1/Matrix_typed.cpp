@@ -0,0 +1,383 @@
+#include "Matrix_manip.h"
+#include "Matrix_utils.h"
+#include "Matrix_typed.h"
+
+#include <algorithm>
+#include <complex>
+
+#include <omp.h>
+
+/*
+Same algorithms as Matrix_manip.cpp for element types
+other than MatType. The register tile comes from TileKernel,
+based on the size of the element, everything else
+(block size, edges, recursion) follows the float versions.
+*/
+
+template <typename Elem>
+using Kernel = TileKernel<sizeof(Elem)>;
+
+///////////////////////////////////////////////////////
+//SYMMETRY CHECKS
+
+template <typename Elem>
+bool checkSym(Elem const* M, uint32_t N) {
+	bool is_symm = true;
+
+	for (uint32_t row_idx = 0; row_idx < N; row_idx++) {
+		for (uint32_t col_idx = row_idx + 1; col_idx < N; col_idx++) {
+			if (M[size_t(row_idx) * N + col_idx] != M[size_t(col_idx) * N + row_idx]) {
+				is_symm = false;
+			}
+		}
+	}
+
+	return is_symm;
+}
+
+template <typename Elem>
+bool checkSymImp(Elem const* M, uint32_t N) {
+	bool is_symm = true;
+
+	uint32_t BLOCK_SIZE = ComputeElemBlockSize(N, N, CACHE_LINE_SIZE, sizeof(Elem));
+
+	for (uint32_t row_idx = 0; row_idx < N; row_idx += BLOCK_SIZE) {
+		for (uint32_t col_idx = row_idx + 1; col_idx < N; col_idx += BLOCK_SIZE) {
+
+			uint32_t row_bound = std::min(row_idx + BLOCK_SIZE, N);
+			uint32_t col_bound = std::min(col_idx + BLOCK_SIZE, N);
+
+			for (uint32_t row_block = row_idx; row_block < row_bound; row_block++) {
+				for (uint32_t col_block = col_idx; col_block < col_bound; col_block++) {
+					if (M[size_t(row_block) * N + col_block] != M[size_t(col_block) * N + row_block])
+						is_symm = false;
+				}
+			}
+
+		}
+	}
+
+	return is_symm;
+}
+
+template <typename Elem>
+bool checkSymOMP(Elem const* M, uint32_t N) {
+	uint32_t BLOCK_SIZE = ComputeElemBlockSize(N, N, CACHE_LINE_SIZE, sizeof(Elem));
+
+	uint32_t num_errors = 0;
+
+#pragma omp parallel reduction(+:num_errors)
+	{
+		for (uint32_t row_idx = 0; row_idx < N; row_idx += BLOCK_SIZE) {
+#pragma omp for collapse(2) schedule(auto)
+			for (uint32_t col_idx = row_idx + 1; col_idx < N; col_idx += BLOCK_SIZE) {
+
+				for (uint32_t row_block = row_idx; row_block < std::min(row_idx + BLOCK_SIZE, N); row_block++) {
+					for (uint32_t col_block = col_idx; col_block < std::min(col_idx + BLOCK_SIZE, N); col_block++) {
+						if (M[size_t(row_block) * N + col_block] != M[size_t(col_block) * N + row_block]) ++num_errors;
+					}
+				}
+
+			}
+		}
+	}
+
+	return num_errors == 0;
+}
+
+//////////////////////////////////////////
+//KERNELS
+
+//BLOCK_SIZE must be a multiple of the tile and divide rows and cols
+template <typename Elem>
+static void BlockTransposeTiles(Elem const* M, Elem* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE) {
+	const uint32_t TILE = Kernel<Elem>::TILE;
+
+	for (uint32_t row_idx = 0; row_idx < rows; row_idx += BLOCK_SIZE) {
+		for (uint32_t col_idx = 0; col_idx < cols; col_idx += BLOCK_SIZE) {
+
+			for (uint32_t row_block = row_idx; row_block < row_idx + BLOCK_SIZE; row_block += TILE) {
+				for (uint32_t col_block = col_idx; col_block < col_idx + BLOCK_SIZE; col_block += TILE) {
+					Kernel<Elem>::Transpose(M, T, row_block, col_block, lda, ldb);
+				}
+			}
+
+		}
+	}
+}
+
+template <typename Elem>
+static void BlockTransposeTiles_OMP(Elem const* M, Elem* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE) {
+	const uint32_t TILE = Kernel<Elem>::TILE;
+
+#pragma omp parallel
+	for (uint32_t row_idx = 0; row_idx < rows; row_idx += BLOCK_SIZE) {
+#pragma omp for collapse(2) schedule(auto)
+		for (uint32_t col_idx = 0; col_idx < cols; col_idx += BLOCK_SIZE) {
+
+			for (uint32_t row_block = row_idx; row_block < row_idx + BLOCK_SIZE; row_block += TILE) {
+				for (uint32_t col_block = col_idx; col_block < col_idx + BLOCK_SIZE; col_block += TILE) {
+					Kernel<Elem>::Transpose(M, T, row_block, col_block, lda, ldb);
+				}
+			}
+
+		}
+	}
+}
+
+//Full tiles with the SIMD kernel, single elements
+//for the right and bottom strips
+template <typename Elem>
+static void TransposeLeaf(Elem const* M, Elem* T, uint32_t lda, uint32_t ldb,
+	uint32_t rows_rem, uint32_t cols_rem, uint32_t col_offset, uint32_t row_offset) {
+	const uint32_t TILE = Kernel<Elem>::TILE;
+
+	uint32_t rows_tile = rows_rem - rows_rem % TILE;
+	uint32_t cols_tile = cols_rem - cols_rem % TILE;
+
+	for (uint32_t row_idx = 0; row_idx < rows_tile; row_idx += TILE) {
+		for (uint32_t col_idx = 0; col_idx < cols_tile; col_idx += TILE) {
+			Kernel<Elem>::Transpose(M, T, row_offset + row_idx, col_offset + col_idx, lda, ldb);
+		}
+	}
+
+	for (uint32_t row_idx = 0; row_idx < rows_rem; row_idx++) {
+		for (uint32_t col_idx = cols_tile; col_idx < cols_rem; col_idx++) {
+			T[size_t(col_idx + col_offset) * ldb + (row_offset + row_idx)] =
+				M[size_t(row_offset + row_idx) * lda + (col_offset + col_idx)];
+		}
+	}
+
+	for (uint32_t row_idx = rows_tile; row_idx < rows_rem; row_idx++) {
+		for (uint32_t col_idx = 0; col_idx < cols_tile; col_idx++) {
+			T[size_t(col_idx + col_offset) * ldb + (row_offset + row_idx)] =
+				M[size_t(row_offset + row_idx) * lda + (col_offset + col_idx)];
+		}
+	}
+}
+
+//See TransposeTilesAndEdges in Matrix_manip.cpp,
+//the fixed block is one cache line of elements
+template <typename Elem>
+static void TransposeTilesAndEdgesT(Elem const* M, Elem* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, bool use_omp) {
+	const uint32_t TILE = Kernel<Elem>::TILE;
+	const uint32_t BLOCK_SIZE = std::max(TILE, uint32_t(CACHE_LINE_SIZE / sizeof(Elem)) / TILE * TILE);
+
+	uint32_t rows_main = rows - rows % BLOCK_SIZE;
+	uint32_t cols_main = cols - cols % BLOCK_SIZE;
+
+	if (rows_main != 0 && cols_main != 0) {
+		if (use_omp)
+			BlockTransposeTiles_OMP(M, T, rows_main, cols_main, lda, ldb, BLOCK_SIZE);
+		else
+			BlockTransposeTiles(M, T, rows_main, cols_main, lda, ldb, BLOCK_SIZE);
+	}
+
+	//Right strip, all rows
+#pragma omp parallel for schedule(auto) if(use_omp)
+	for (uint32_t row_idx = 0; row_idx < rows; row_idx += BLOCK_SIZE) {
+		TransposeLeaf(M, T, lda, ldb, std::min(BLOCK_SIZE, rows - row_idx), cols - cols_main,
+			cols_main, row_idx);
+	}
+
+	//Bottom strip, without the corner
+#pragma omp parallel for schedule(auto) if(use_omp)
+	for (uint32_t col_idx = 0; col_idx < cols_main; col_idx += BLOCK_SIZE) {
+		TransposeLeaf(M, T, lda, ldb, rows - rows_main, BLOCK_SIZE, col_idx, rows_main);
+	}
+}
+
+//Split point of a dimension, first half multiple of the tile
+template <typename Elem>
+static inline uint32_t SplitSize(uint32_t size) {
+	const uint32_t TILE = Kernel<Elem>::TILE;
+
+	uint32_t half_size = size / 2;
+	return half_size >= TILE ? (half_size - half_size % TILE) : half_size;
+}
+
+template <typename Elem>
+static void CacheObliviousT(Elem const* M, Elem* T, uint32_t lda, uint32_t ldb,
+	uint32_t rows_rem, uint32_t cols_rem, uint32_t col_offset, uint32_t row_offset) {
+	if (rows_rem <= 32 && cols_rem <= 32) {
+		TransposeLeaf(M, T, lda, ldb, rows_rem, cols_rem, col_offset, row_offset);
+	}
+	else if (rows_rem >= cols_rem) {
+		uint32_t half_size = SplitSize<Elem>(rows_rem);
+		CacheObliviousT(M, T, lda, ldb, half_size, cols_rem, col_offset, row_offset);
+		CacheObliviousT(M, T, lda, ldb, rows_rem - half_size, cols_rem, col_offset, row_offset + half_size);
+	}
+	else {
+		uint32_t half_size = SplitSize<Elem>(cols_rem);
+		CacheObliviousT(M, T, lda, ldb, rows_rem, half_size, col_offset, row_offset);
+		CacheObliviousT(M, T, lda, ldb, rows_rem, cols_rem - half_size, col_offset + half_size, row_offset);
+	}
+}
+
+//Recursive tasks like matTransposeCacheObliviousImpOMP:
+//one half is a task, the other is recursed into, until
+//task_depth levels are done or the matrix is small
+template <typename Elem>
+static void CacheObliviousT_OMP(Elem const* M, Elem* T, uint32_t lda, uint32_t ldb,
+	uint32_t rows_rem, uint32_t cols_rem, uint32_t col_offset, uint32_t row_offset, uint32_t task_depth) {
+	if (task_depth == 0 || (rows_rem <= 64 && cols_rem <= 64)) {
+		CacheObliviousT(M, T, lda, ldb, rows_rem, cols_rem, col_offset, row_offset);
+		return;
+	}
+
+	if (rows_rem >= cols_rem) {
+		uint32_t half_size = SplitSize<Elem>(rows_rem);
+#pragma omp task priority(task_depth)
+		CacheObliviousT_OMP(M, T, lda, ldb, half_size, cols_rem, col_offset, row_offset, task_depth - 1);
+		CacheObliviousT_OMP(M, T, lda, ldb, rows_rem - half_size, cols_rem, col_offset, row_offset + half_size,
+			task_depth - 1);
+	}
+	else {
+		uint32_t half_size = SplitSize<Elem>(cols_rem);
+#pragma omp task priority(task_depth)
+		CacheObliviousT_OMP(M, T, lda, ldb, rows_rem, half_size, col_offset, row_offset, task_depth - 1);
+		CacheObliviousT_OMP(M, T, lda, ldb, rows_rem, cols_rem - half_size, col_offset + half_size, row_offset,
+			task_depth - 1);
+	}
+
+#pragma omp taskwait
+}
+
+//////////////////////////////////////////
+//TRANSPOSE
+
+template <typename Elem>
+void matTranspose(Elem const* M, Elem* T, uint32_t N) {
+	matTranspose(M, T, N, N, N, N);
+}
+
+template <typename Elem>
+void matTranspose(Elem const* M, Elem* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	for (uint32_t row_idx = 0; row_idx < rows; row_idx++) {
+		for (uint32_t col_idx = 0; col_idx < cols; col_idx++) {
+			T[size_t(col_idx) * ldb + row_idx] = M[size_t(row_idx) * lda + col_idx];
+		}
+	}
+}
+
+template <typename Elem>
+void matTransposeImp(Elem const* M, Elem* T, uint32_t N) {
+	matTransposeImp(M, T, N, N, N, N);
+}
+
+template <typename Elem>
+void matTransposeImp(Elem const* M, Elem* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	uint32_t BLOCK_SIZE = ComputeElemBlockSize(rows, cols, CACHE_LINE_SIZE, sizeof(Elem));
+
+	if (BLOCK_SIZE % Kernel<Elem>::TILE == 0)
+		BlockTransposeTiles(M, T, rows, cols, lda, ldb, BLOCK_SIZE);
+	else
+		TransposeTilesAndEdgesT(M, T, rows, cols, lda, ldb, false);
+}
+
+template <typename Elem>
+void matTransposeOMP(Elem const* M, Elem* T, uint32_t N) {
+	matTransposeOMP(M, T, N, N, N, N);
+}
+
+template <typename Elem>
+void matTransposeOMP(Elem const* M, Elem* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	uint32_t BLOCK_SIZE = ComputeElemBlockSize(rows, cols, CACHE_LINE_SIZE, sizeof(Elem));
+
+	if (BLOCK_SIZE % Kernel<Elem>::TILE == 0)
+		BlockTransposeTiles_OMP(M, T, rows, cols, lda, ldb, BLOCK_SIZE);
+	else
+		TransposeTilesAndEdgesT(M, T, rows, cols, lda, ldb, true);
+}
+
+template <typename Elem>
+void matTransposeCacheOblivious(Elem const* M, Elem* T, uint32_t N) {
+	matTransposeCacheOblivious(M, T, N, N, N, N);
+}
+
+template <typename Elem>
+void matTransposeCacheOblivious(Elem const* M, Elem* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	CacheObliviousT(M, T, lda, ldb, rows, cols, 0, 0);
+}
+
+template <typename Elem>
+void matTransposeCacheObliviousOMP(Elem const* M, Elem* T, uint32_t N) {
+	matTransposeCacheObliviousOMP(M, T, N, N, N, N);
+}
+
+template <typename Elem>
+void matTransposeCacheObliviousOMP(Elem const* M, Elem* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	uint32_t task_depth = CacheObliviousTaskDepth(uint32_t(omp_get_max_threads()));
+
+#pragma omp parallel
+#pragma omp single nowait
+	{
+		CacheObliviousT_OMP(M, T, lda, ldb, rows, cols, 0, 0, task_depth);
+	}
+}
+
+template <typename Elem>
+void matTransposeFinal(Elem const* M, Elem* T, uint32_t N) {
+	matTransposeFinal(M, T, N, N, N, N);
+}
+
+template <typename Elem>
+void matTransposeFinal(Elem const* M, Elem* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	using Dispatch = void(*)(Elem const* M, Elem* T, uint32_t rows, uint32_t cols,
+		uint32_t lda, uint32_t ldb);
+
+	static const Dispatch jmp_table[] =
+	{
+		matTransposeImp<Elem>,
+		matTransposeCacheOblivious<Elem>,
+		matTransposeOMP<Elem>,
+		matTransposeCacheObliviousOMP<Elem>
+	};
+
+	//Same thresholds as the float version, in bytes
+	//instead of elements
+	uint64_t bytes = uint64_t(rows) * cols * sizeof(Elem);
+
+	uint32_t index = uint32_t(bytes >= 512 * 512 * sizeof(MatType)) << 1;
+	index |= uint32_t((rows & (rows - 1)) == 0 && (cols & (cols - 1)) == 0);
+
+	jmp_table[index](M, T, rows, cols, lda, ldb);
+}
+
+//////////////////////////////////////////
+//INSTANTIATIONS
+
+#define PARCO_INSTANTIATE_TYPED(Elem) \
+	template bool checkSym<Elem>(Elem const* M, uint32_t N); \
+	template bool checkSymImp<Elem>(Elem const* M, uint32_t N); \
+	template bool checkSymOMP<Elem>(Elem const* M, uint32_t N); \
+	template void matTranspose<Elem>(Elem const* M, Elem* T, uint32_t N); \
+	template void matTranspose<Elem>(Elem const* M, Elem* T, uint32_t rows, uint32_t cols, uint32_t lda, uint32_t ldb); \
+	template void matTransposeImp<Elem>(Elem const* M, Elem* T, uint32_t N); \
+	template void matTransposeImp<Elem>(Elem const* M, Elem* T, uint32_t rows, uint32_t cols, uint32_t lda, uint32_t ldb); \
+	template void matTransposeOMP<Elem>(Elem const* M, Elem* T, uint32_t N); \
+	template void matTransposeOMP<Elem>(Elem const* M, Elem* T, uint32_t rows, uint32_t cols, uint32_t lda, uint32_t ldb); \
+	template void matTransposeCacheOblivious<Elem>(Elem const* M, Elem* T, uint32_t N); \
+	template void matTransposeCacheOblivious<Elem>(Elem const* M, Elem* T, uint32_t rows, uint32_t cols, uint32_t lda, uint32_t ldb); \
+	template void matTransposeCacheObliviousOMP<Elem>(Elem const* M, Elem* T, uint32_t N); \
+	template void matTransposeCacheObliviousOMP<Elem>(Elem const* M, Elem* T, uint32_t rows, uint32_t cols, uint32_t lda, uint32_t ldb); \
+	template void matTransposeFinal<Elem>(Elem const* M, Elem* T, uint32_t N); \
+	template void matTransposeFinal<Elem>(Elem const* M, Elem* T, uint32_t rows, uint32_t cols, uint32_t lda, uint32_t ldb);
+
+PARCO_INSTANTIATE_TYPED(int8_t)
+PARCO_INSTANTIATE_TYPED(uint8_t)
+PARCO_INSTANTIATE_TYPED(int16_t)
+PARCO_INSTANTIATE_TYPED(uint16_t)
+PARCO_INSTANTIATE_TYPED(int32_t)
+PARCO_INSTANTIATE_TYPED(uint32_t)
+PARCO_INSTANTIATE_TYPED(double)
+PARCO_INSTANTIATE_TYPED(std::complex<float>)
@@ -0,0 +1,178 @@
+#ifndef PARCO_MATRIX_TYPED
+#define PARCO_MATRIX_TYPED
+
+#include "Defs.h"
+#include "Simd_utils.h"
+
+#include <cstddef>
+
+/*
+Register transposes for element types other than MatType.
+The shuffles only move bits around, so the kernel depends
+on the size of the element and not on its type:
+int32 goes through the same float shuffles as Transpose4x4,
+double, int64 and complex<float> are all 64 bit elements.
+
+Every kernel uses unaligned loads, on recent cpus
+they are as fast as the aligned ones when the
+address happens to be aligned.
+*/
+
+/// <summary>
+/// Fallback for sizes without a SIMD kernel:
+/// 1x1 tiles, plain copy
+/// </summary>
+template <size_t ElemSize>
+struct TileKernel {
+	static constexpr uint32_t TILE = 1;
+
+	template <typename Elem>
+	static void Transpose(Elem const* src, Elem* dst,
+		uint32_t row, uint32_t col, uint32_t lda, uint32_t ldb) {
+		dst[size_t(col) * ldb + row] = src[size_t(row) * lda + col];
+	}
+};
+
+/// <summary>
+/// 16x16 tiles of 8 bit elements, four rounds
+/// of unpack (8, 16, 32, 64 bits)
+/// </summary>
+template <>
+struct TileKernel<1> {
+	static constexpr uint32_t TILE = 16;
+
+	template <typename Elem>
+	static void Transpose(Elem const* src, Elem* dst,
+		uint32_t row, uint32_t col, uint32_t lda, uint32_t ldb) {
+		__m128i r[16], t[16];
+
+		for (uint32_t idx = 0; idx < 16; idx++)
+			r[idx] = _mm_loadu_si128(reinterpret_cast<__m128i const*>(&src[size_t(row + idx) * lda + col]));
+
+		/*
+		Each round doubles the number of rows interleaved
+		in a register:
+		1) t[2i], t[2i+1]: rows 2i, 2i+1, cols 0-7 and 8-15
+		2) r[4g+m]: rows 4g..4g+3, cols 4m..4m+3
+		3) t[8g+j]: rows 8g..8g+7, cols 2j, 2j+1
+		4) r[c]: all 16 rows of column c
+		*/
+		for (uint32_t idx = 0; idx < 16; idx += 2) {
+			t[idx] = _mm_unpacklo_epi8(r[idx], r[idx + 1]);
+			t[idx + 1] = _mm_unpackhi_epi8(r[idx], r[idx + 1]);
+		}
+
+		for (uint32_t idx = 0; idx < 16; idx += 4) {
+			r[idx] = _mm_unpacklo_epi16(t[idx], t[idx + 2]);
+			r[idx + 1] = _mm_unpackhi_epi16(t[idx], t[idx + 2]);
+			r[idx + 2] = _mm_unpacklo_epi16(t[idx + 1], t[idx + 3]);
+			r[idx + 3] = _mm_unpackhi_epi16(t[idx + 1], t[idx + 3]);
+		}
+
+		for (uint32_t group = 0; group < 16; group += 8) {
+			for (uint32_t idx = 0; idx < 4; idx++) {
+				t[group + 2 * idx] = _mm_unpacklo_epi32(r[group + idx], r[group + 4 + idx]);
+				t[group + 2 * idx + 1] = _mm_unpackhi_epi32(r[group + idx], r[group + 4 + idx]);
+			}
+		}
+
+		for (uint32_t idx = 0; idx < 8; idx++) {
+			r[2 * idx] = _mm_unpacklo_epi64(t[idx], t[idx + 8]);
+			r[2 * idx + 1] = _mm_unpackhi_epi64(t[idx], t[idx + 8]);
+		}
+
+		for (uint32_t idx = 0; idx < 16; idx++)
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[size_t(col + idx) * ldb + row]), r[idx]);
+	}
+};
+
+/// <summary>
+/// 8x8 tiles of 16 bit elements, three rounds
+/// of unpack (16, 32, 64 bits)
+/// </summary>
+template <>
+struct TileKernel<2> {
+	static constexpr uint32_t TILE = 8;
+
+	template <typename Elem>
+	static void Transpose(Elem const* src, Elem* dst,
+		uint32_t row, uint32_t col, uint32_t lda, uint32_t ldb) {
+		__m128i r[8], t[8];
+
+		for (uint32_t idx = 0; idx < 8; idx++)
+			r[idx] = _mm_loadu_si128(reinterpret_cast<__m128i const*>(&src[size_t(row + idx) * lda + col]));
+
+		//t[2i], t[2i+1]: rows 2i, 2i+1 interleaved, cols 0-3 and 4-7
+		for (uint32_t idx = 0; idx < 8; idx += 2) {
+			t[idx] = _mm_unpacklo_epi16(r[idx], r[idx + 1]);
+			t[idx + 1] = _mm_unpackhi_epi16(r[idx], r[idx + 1]);
+		}
+
+		//r[4g+m]: rows 4g..4g+3, cols 2m, 2m+1
+		for (uint32_t idx = 0; idx < 8; idx += 4) {
+			r[idx] = _mm_unpacklo_epi32(t[idx], t[idx + 2]);
+			r[idx + 1] = _mm_unpackhi_epi32(t[idx], t[idx + 2]);
+			r[idx + 2] = _mm_unpacklo_epi32(t[idx + 1], t[idx + 3]);
+			r[idx + 3] = _mm_unpackhi_epi32(t[idx + 1], t[idx + 3]);
+		}
+
+		//Join the upper and lower 4 rows of each column
+		for (uint32_t idx = 0; idx < 4; idx++) {
+			t[2 * idx] = _mm_unpacklo_epi64(r[idx], r[idx + 4]);
+			t[2 * idx + 1] = _mm_unpackhi_epi64(r[idx], r[idx + 4]);
+		}
+
+		for (uint32_t idx = 0; idx < 8; idx++)
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[size_t(col + idx) * ldb + row]), t[idx]);
+	}
+};
+
+/// <summary>
+/// 4x4 tiles of 32 bit elements, same
+/// shuffles as Transpose4x4
+/// </summary>
+template <>
+struct TileKernel<4> {
+	static constexpr uint32_t TILE = 4;
+
+	template <typename Elem>
+	static void Transpose(Elem const* src, Elem* dst,
+		uint32_t row, uint32_t col, uint32_t lda, uint32_t ldb) {
+		__m128 row1 = _mm_loadu_ps(reinterpret_cast<float const*>(&src[size_t(row) * lda + col]));
+		__m128 row2 = _mm_loadu_ps(reinterpret_cast<float const*>(&src[size_t(row + 1) * lda + col]));
+		__m128 row3 = _mm_loadu_ps(reinterpret_cast<float const*>(&src[size_t(row + 2) * lda + col]));
+		__m128 row4 = _mm_loadu_ps(reinterpret_cast<float const*>(&src[size_t(row + 3) * lda + col]));
+
+		Transpose4x4_Regs(row1, row2, row3, row4);
+
+		_mm_storeu_ps(reinterpret_cast<float*>(&dst[size_t(col) * ldb + row]), row1);
+		_mm_storeu_ps(reinterpret_cast<float*>(&dst[size_t(col + 1) * ldb + row]), row2);
+		_mm_storeu_ps(reinterpret_cast<float*>(&dst[size_t(col + 2) * ldb + row]), row3);
+		_mm_storeu_ps(reinterpret_cast<float*>(&dst[size_t(col + 3) * ldb + row]), row4);
+	}
+};
+
+/// <summary>
+/// 2x2 tiles of 64 bit elements
+/// (double, int64, complex float)
+/// </summary>
+template <>
+struct TileKernel<8> {
+	static constexpr uint32_t TILE = 2;
+
+	template <typename Elem>
+	static void Transpose(Elem const* src, Elem* dst,
+		uint32_t row, uint32_t col, uint32_t lda, uint32_t ldb) {
+		__m128d row1 = _mm_loadu_pd(reinterpret_cast<double const*>(&src[size_t(row) * lda + col]));
+		__m128d row2 = _mm_loadu_pd(reinterpret_cast<double const*>(&src[size_t(row + 1) * lda + col]));
+
+		//Low halves are the first column, high halves the second
+		__m128d col1 = _mm_unpacklo_pd(row1, row2);
+		__m128d col2 = _mm_unpackhi_pd(row1, row2);
+
+		_mm_storeu_pd(reinterpret_cast<double*>(&dst[size_t(col) * ldb + row]), col1);
+		_mm_storeu_pd(reinterpret_cast<double*>(&dst[size_t(col + 1) * ldb + row]), col2);
+	}
+};
+
+#endif // !PARCO_MATRIX_TYPED
@@ -1,4 +1,6 @@
 #include "Matrix_utils.h"
+#include "Simd_utils.h"
+#include "Tuning.h"
 
 #include <xmmintrin.h>
 #include <immintrin.h>
@@ -7,12 +9,35 @@
 
 #include <omp.h>
 
+int OmpThreads(uint32_t threads) {
+	return threads != 0 ? int(threads) : omp_get_max_threads();
+}
+
 uint32_t ComputeBlockSize(uint32_t N, uint32_t CACHE_LINE) {
+	return ComputeElemBlockSize(N, N, CACHE_LINE, sizeof(MatType));
+}
+
+uint32_t ComputeBlockSize(uint32_t rows, uint32_t cols, uint32_t CACHE_LINE) {
+	return ComputeElemBlockSize(rows, cols, CACHE_LINE, sizeof(MatType));
+}
+
+uint32_t ComputeElemBlockSize(uint32_t rows, uint32_t cols, uint32_t CACHE_LINE, uint32_t ELEM_SIZE) {
+	//Any block size that divides the greatest common
+	//divisor divides both dimensions
+	uint32_t N = rows, b = cols;
+
+	while (b != 0) {
+		uint32_t rem = N % b;
+		N = b;
+		b = rem;
+	}
+
 	uint32_t curr_block_sz = 1;
 	uint32_t block_sz = 1;
 
-	//Set max block size as (CACHE_LINE_SIZE / 4) * 1.5
-	uint32_t upper_bound = uint32_t(float(CACHE_LINE / sizeof(MatType)) * 1.5f);
+	//Set max block size as (CACHE_LINE_SIZE / ELEM_SIZE) * block_ratio,
+	//1.5 unless the tuning profile says otherwise
+	uint32_t upper_bound = uint32_t(float(CACHE_LINE / ELEM_SIZE) * GetTuningProfile().block_ratio);
 
 	while (curr_block_sz <= N && curr_block_sz <= upper_bound) {
 		if (N % curr_block_sz == 0) block_sz = curr_block_sz; //accept only 
@@ -24,126 +49,47 @@ uint32_t ComputeBlockSize(uint32_t N, uint32_t CACHE_LINE) {
 }
 
 void Transpose4x4(MatType const* src, MatType* dst,
-	uint32_t row, uint32_t col, uint32_t N) {
+	uint32_t row, uint32_t col, uint32_t lda, uint32_t ldb) {
 	__m128 row1{}, row2{}, row3{}, row4{};
-	__m128 t1{}, t2{}, t3{}, t4{};
 
 	//Load the entire 4x4 block by using unaligned
 	//packed float loads
-	row1 = _mm_loadu_ps(&src[row * N + col]);
-	row2 = _mm_loadu_ps(&src[(row + 1) * N + col]);
-	row3 = _mm_loadu_ps(&src[(row + 2) * N + col]);
-	row4 = _mm_loadu_ps(&src[(row + 3) * N + col]);
-
-	//For each row:
-	//Select two elements from position N 
-	//(where N is the destination row number)
-	//from alternating rows
-	t1 = _mm_shuffle_ps(row1, row3, 0b00000000);
-	//Select the other two elements from the 
-	//the remaining rows
-	t2 = _mm_shuffle_ps(row2, row4, 0b00000000);
-	//Blend the two vectors together, by
-	//using an alternating pattern for selection
-	t1 = _mm_blend_ps(t1, t2, 0b1010);
-
-	t2 = _mm_shuffle_ps(row1, row3, 0b00010001);
-	t3 = _mm_shuffle_ps(row2, row4, 0b01000100);
-	t2 = _mm_blend_ps(t2, t3, 0b1010);
-
-	t3 = _mm_shuffle_ps(row1, row3, 0b00100010);
-	t4 = _mm_shuffle_ps(row2, row4, 0b10001000);
-	t3 = _mm_blend_ps(t3, t4, 0b1010);
-
-	t4 = _mm_shuffle_ps(row1, row3, 0b00110011);
-	row1 = _mm_shuffle_ps(row2, row4, 0b11001100);
-	t4 = _mm_blend_ps(t4, row1, 0b1010);
-
-	/*
-	To why we are using alternating rows in the shuffle:
-	https://www.intel.com/content/www/us/en/docs/intrinsics-guide/index.html#text=_mm_shuffle_&ig_expand=6047
-
-	In short: Adjacent elements are taken from the same
-	row, so we cannot get, for example, elements 0 and 0
-	of the first two rows and put them as elements 0, 1
-	in the transposed row
-
-	Step by step approach:
-
-	We need to transpose
-	0 1 2 3
-	4 5 6 7
-	8 9 a b
-	c d e f
-
-	1) Start by loading all 4 rows into xmm registers by using _mm_loadu_ps
-	2) First row shuffle:
-		Select element 0 from row0 and row3, putting them in a temp register,
-		which gives 0 - 8 -
-		Then select element 0 from row1 and row2, store them in a second register
-		giving - 4 - c
-		(Note that the - are don't care)
-	3) First row blend:
-		The immediate value in the blend instruction is 4 bits,
-		where bit N is used to decide from which variable
-		the value of the N float is taken
-		For reference:
-		https://www.intel.com/content/www/us/en/docs/intrinsics-guide/index.html#text=_mm_blend_ps&ig_expand=6047,482
-		By using the pattern 1010, we see that we are selecting
-		T[0] from the first temp. value,
-		T[1] from the second and so on
-		The resulting operation is:
-			0 - 8 -
-			- 4 - c
-		=   0 4 8 c
-	4) Repeat same approach used for row 0 but instead of selecting
-		element 0 from the rows in the shuffle, select
-		element N
-	5) Store each row one at a time
-	*/
+	row1 = _mm_loadu_ps(&src[size_t(row) * lda + col]);
+	row2 = _mm_loadu_ps(&src[size_t(row + 1) * lda + col]);
+	row3 = _mm_loadu_ps(&src[size_t(row + 2) * lda + col]);
+	row4 = _mm_loadu_ps(&src[size_t(row + 3) * lda + col]);
+
+	//See Simd_utils.h for the step by step approach
+	Transpose4x4_Regs(row1, row2, row3, row4);
 
 	//Store transposed rows
-	_mm_storeu_ps(&dst[col * N + row], t1);
-	_mm_storeu_ps(&dst[(col + 1) * N + row], t2);
-	_mm_storeu_ps(&dst[(col + 2) * N + row], t3);
-	_mm_storeu_ps(&dst[(col + 3) * N + row], t4);
+	_mm_storeu_ps(&dst[size_t(col) * ldb + row], row1);
+	_mm_storeu_ps(&dst[size_t(col + 1) * ldb + row], row2);
+	_mm_storeu_ps(&dst[size_t(col + 2) * ldb + row], row3);
+	_mm_storeu_ps(&dst[size_t(col + 3) * ldb + row], row4);
 }
 
 void Transpose4x4_Aligned(MatType const* src, MatType* dst,
-	uint32_t row, uint32_t col, uint32_t N) {
+	uint32_t row, uint32_t col, uint32_t lda, uint32_t ldb) {
 	__m128 row1{}, row2{}, row3{}, row4{};
-	__m128 t1{}, t2{}, t3{}, t4{};
-
-	row1 = _mm_load_ps(&src[row * N + col]);
-	row2 = _mm_load_ps(&src[(row + 1) * N + col]);
-	row3 = _mm_load_ps(&src[(row + 2) * N + col]);
-	row4 = _mm_load_ps(&src[(row + 3) * N + col]);
-
-	t1 = _mm_shuffle_ps(row1, row3, 0b00000000);
-	t2 = _mm_shuffle_ps(row2, row4, 0b00000000);
-	t1 = _mm_blend_ps(t1, t2, 0b1010);
-
-	t2 = _mm_shuffle_ps(row1, row3, 0b00010001);
-	t3 = _mm_shuffle_ps(row2, row4, 0b01000100);
-	t2 = _mm_blend_ps(t2, t3, 0b1010);
 
-	t3 = _mm_shuffle_ps(row1, row3, 0b00100010);
-	t4 = _mm_shuffle_ps(row2, row4, 0b10001000);
-	t3 = _mm_blend_ps(t3, t4, 0b1010);
+	row1 = _mm_load_ps(&src[size_t(row) * lda + col]);
+	row2 = _mm_load_ps(&src[size_t(row + 1) * lda + col]);
+	row3 = _mm_load_ps(&src[size_t(row + 2) * lda + col]);
+	row4 = _mm_load_ps(&src[size_t(row + 3) * lda + col]);
 
-	t4 = _mm_shuffle_ps(row1, row3, 0b00110011);
-	row1 = _mm_shuffle_ps(row2, row4, 0b11001100);
-	t4 = _mm_blend_ps(t4, row1, 0b1010);
+	Transpose4x4_Regs(row1, row2, row3, row4);
 
-	_mm_store_ps(&dst[col * N + row], t1);
-	_mm_store_ps(&dst[(col + 1) * N + row], t2);
-	_mm_store_ps(&dst[(col + 2) * N + row], t3);
-	_mm_store_ps(&dst[(col + 3) * N + row], t4);
+	_mm_store_ps(&dst[size_t(col) * ldb + row], row1);
+	_mm_store_ps(&dst[size_t(col + 1) * ldb + row], row2);
+	_mm_store_ps(&dst[size_t(col + 2) * ldb + row], row3);
+	_mm_store_ps(&dst[size_t(col + 3) * ldb + row], row4);
 }
 
-void BlockTranspose_NoSSE(MatType const* M, MatType* T, uint32_t N, uint32_t BLOCK_SIZE) {
-	for (uint32_t row_idx = 0; row_idx < N; row_idx += BLOCK_SIZE) {
-		for (uint32_t col_idx = 0; col_idx < N; col_idx += BLOCK_SIZE) {
+void BlockTranspose_NoSSE(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE) {
+	for (uint32_t row_idx = 0; row_idx < rows; row_idx += BLOCK_SIZE) {
+		for (uint32_t col_idx = 0; col_idx < cols; col_idx += BLOCK_SIZE) {
 
 			/*
 			Testing prefetch:
@@ -160,13 +106,13 @@ void BlockTranspose_NoSSE(MatType const* M, MatType* T, uint32_t N, uint32_t BLO
 			in a strict loop. In any case, the performance gain is negligible
 			*/
 
-			//Compute row and column bounds (necessary if N % BLOCK_SIZE != 0)
-			uint32_t row_bound = std::min(row_idx + BLOCK_SIZE, N);
-			uint32_t col_bound = std::min(col_idx + BLOCK_SIZE, N);
+			//Compute row and column bounds (necessary if rows or cols % BLOCK_SIZE != 0)
+			uint32_t row_bound = std::min(row_idx + BLOCK_SIZE, rows);
+			uint32_t col_bound = std::min(col_idx + BLOCK_SIZE, cols);
 
 			for (uint32_t row_block = row_idx; row_block < row_bound; row_block++) {
 				for (uint32_t col_block = col_idx; col_block < col_bound; col_block++) {
-					T[col_block * N + row_block] = M[row_block * N + col_block];
+					T[size_t(col_block) * ldb + row_block] = M[size_t(row_block) * lda + col_block];
 				}
 			}
 
@@ -174,21 +120,22 @@ void BlockTranspose_NoSSE(MatType const* M, MatType* T, uint32_t N, uint32_t BLO
 	}
 }
 
-void BlockTranspose_NoSSE_OMP(MatType const* M, MatType* T, uint32_t N, uint32_t BLOCK_SIZE) {
+void BlockTranspose_NoSSE_OMP(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE) {
 	//I noted that putting the parallel here and the for
 	//inside the first loop drastically improves performance
 #pragma omp parallel
 	{
-		for (uint32_t row_idx = 0; row_idx < N; row_idx += BLOCK_SIZE) {
+		for (uint32_t row_idx = 0; row_idx < rows; row_idx += BLOCK_SIZE) {
 			//Use schedule(auto) so that we can change scheduling
 			//by using env variable OMP_SCHEDULE
 #pragma omp for collapse(2) schedule(auto)
-			for (uint32_t col_idx = 0; col_idx < N; col_idx += BLOCK_SIZE) {
+			for (uint32_t col_idx = 0; col_idx < cols; col_idx += BLOCK_SIZE) {
 				//We can compute the bounds only in the loop conditions
 				//Otherwise collapse fails
-				for (uint32_t row_block = row_idx; row_block < std::min(row_idx + BLOCK_SIZE, N); row_block++) {
-					for (uint32_t col_block = col_idx; col_block < std::min(col_idx + BLOCK_SIZE, N); col_block++) {
-						T[col_block * N + row_block] = M[row_block * N + col_block];
+				for (uint32_t row_block = row_idx; row_block < std::min(row_idx + BLOCK_SIZE, rows); row_block++) {
+					for (uint32_t col_block = col_idx; col_block < std::min(col_idx + BLOCK_SIZE, cols); col_block++) {
+						T[size_t(col_block) * ldb + row_block] = M[size_t(row_block) * lda + col_block];
 					}
 				}
 
@@ -205,117 +152,189 @@ and we cannot use if constexpr for conditional template generation
 if constexpr is available starting from C++17
 */
 
-void matTransposeCacheObliviousImp(MatType const* M, MatType* T, uint32_t N,
-	uint32_t N_rem, uint32_t col_offset, uint32_t row_offset) {
-	if (N_rem <= 32) {
-		//End condition, size is small enough
+//Leaf of the cache oblivious recursion.
+//Full 4x4 tiles use sse, the strips on the right
+//and bottom edge (if rows or cols are not multiples 
+//of 4) are copied one element at a time
+template <bool Aligned>
+static void CacheObliviousLeaf(MatType const* M, MatType* T, uint32_t lda, uint32_t ldb,
+	uint32_t rows_rem, uint32_t cols_rem, uint32_t col_offset, uint32_t row_offset) {
+	uint32_t rows_sse = rows_rem & ~3u;
+	uint32_t cols_sse = cols_rem & ~3u;
+
+	for (uint32_t row_idx = 0; row_idx < rows_sse; row_idx += 4) {
+		for (uint32_t col_idx = 0; col_idx < cols_sse; col_idx += 4) {
+			//The branch is resolved at compile time
+			if (Aligned)
+				Transpose4x4_Aligned(M, T, row_offset + row_idx, col_offset + col_idx, lda, ldb);
+			else
+				Transpose4x4(M, T, row_offset + row_idx, col_offset + col_idx, lda, ldb);
+		}
+	}
 
-		if (N_rem % 4 == 0) { //Use sse
-			//We trust the caller and expect the matrix to be
-			//16-bytes aligned
-			for (uint32_t row_idx = 0; row_idx < N_rem; row_idx += 4) {
-				for (uint32_t col_idx = 0; col_idx < N_rem; col_idx += 4) {
-					Transpose4x4_Aligned(M, T, row_offset + row_idx,
-						col_offset + col_idx, N);
-				}
-			}
+	//Right strip, for all rows
+	for (uint32_t row_idx = 0; row_idx < rows_rem; row_idx++) {
+		for (uint32_t col_idx = cols_sse; col_idx < cols_rem; col_idx++) {
+			T[size_t(col_idx + col_offset) * ldb + (row_offset + row_idx)] =
+				M[size_t(row_offset + row_idx) * lda + (col_offset + col_idx)];
 		}
-		else {
-			//Use normal transpose
-			for (uint32_t row_idx = 0; row_idx < N_rem; row_idx++) {
-				for (uint32_t col_idx = 0; col_idx < N_rem; col_idx++) {
-					T[(col_idx + col_offset) * N + (row_offset + row_idx)] =
-						M[(row_offset + row_idx) * N + (col_offset + col_idx)];
-				}
-			}
+	}
+
+	//Bottom strip, without the corner already copied above
+	for (uint32_t row_idx = rows_sse; row_idx < rows_rem; row_idx++) {
+		for (uint32_t col_idx = 0; col_idx < cols_sse; col_idx++) {
+			T[size_t(col_idx + col_offset) * ldb + (row_offset + row_idx)] =
+				M[size_t(row_offset + row_idx) * lda + (col_offset + col_idx)];
 		}
+	}
+}
 
+//Split point of a dimension in the recursion.
+//The first half is kept a multiple of 4, so that every
+//sub matrix starts on a 4x4 tile boundary, which keeps
+//the aligned loads valid for every N
+static inline uint32_t CacheObliviousSplit(uint32_t size) {
+	uint32_t half_size = size / 2;
+	return half_size >= 4 ? (half_size & ~3u) : half_size;
+}
+
+template <bool Aligned>
+void matTransposeCacheObliviousImp(MatType const* M, MatType* T, uint32_t lda, uint32_t ldb,
+	uint32_t rows_rem, uint32_t cols_rem, uint32_t col_offset, uint32_t row_offset, uint32_t LEAF_SIZE) {
+	if (rows_rem <= LEAF_SIZE && cols_rem <= LEAF_SIZE) {
+		//End condition, size is small enough
+		CacheObliviousLeaf<Aligned>(M, T, lda, ldb, rows_rem, cols_rem, col_offset, row_offset);
+	}
+	else if (rows_rem >= cols_rem) {
+		//Divide and conquer by splitting the largest dimension,
+		//so that tall or wide matrices keep getting
+		//closer to a square instead of degenerating
+		//into single rows/columns.
+		//For square matrices two levels of recursion
+		//are the same as splitting in 4 submatrices
+		uint32_t half_size = CacheObliviousSplit(rows_rem);
+		matTransposeCacheObliviousImp<Aligned>(M, T, lda, ldb, half_size, cols_rem, col_offset, row_offset,
+			LEAF_SIZE);
+		matTransposeCacheObliviousImp<Aligned>(M, T, lda, ldb, rows_rem - half_size, cols_rem,
+			col_offset, row_offset + half_size, LEAF_SIZE);
 	}
 	else {
-		//Divide and conquer in 4 submatrices
-		uint32_t half_size = N_rem / 2;
-		matTransposeCacheObliviousImp(M, T, N, half_size, col_offset, row_offset);
-		matTransposeCacheObliviousImp(M, T, N, half_size, col_offset + half_size, row_offset);
-
-		matTransposeCacheObliviousImp(M, T, N, half_size, col_offset, row_offset + half_size);
-		matTransposeCacheObliviousImp(M, T, N, half_size, col_offset + half_size, row_offset + half_size);
-
-		if (N_rem & 1) {
-			//Size is not even, must transpose last row and column
-			for (uint32_t row_idx = 0; row_idx < N_rem; row_idx++) {
-				T[(col_offset + N_rem - 1) * N + (row_offset + row_idx)] =
-					M[(row_offset + row_idx) * N + (col_offset + N_rem - 1)];
-
-				T[(col_offset + row_idx) * N + (row_offset + N_rem - 1)] =
-					M[(row_offset + N_rem - 1) * N + (col_offset + row_idx)];
-			}
-		}
+		uint32_t half_size = CacheObliviousSplit(cols_rem);
+		matTransposeCacheObliviousImp<Aligned>(M, T, lda, ldb, rows_rem, half_size, col_offset, row_offset,
+			LEAF_SIZE);
+		matTransposeCacheObliviousImp<Aligned>(M, T, lda, ldb, rows_rem, cols_rem - half_size,
+			col_offset + half_size, row_offset, LEAF_SIZE);
 	}
 }
 
-void matTransposeCacheObliviousImpOMP(MatType const* M, MatType* T, uint32_t N,
-	uint32_t N_rem, uint32_t col_offset, uint32_t row_offset) {
+template void matTransposeCacheObliviousImp<true>(MatType const* M, MatType* T, uint32_t lda, uint32_t ldb,
+	uint32_t rows_rem, uint32_t cols_rem, uint32_t col_offset, uint32_t row_offset, uint32_t LEAF_SIZE);
+template void matTransposeCacheObliviousImp<false>(MatType const* M, MatType* T, uint32_t lda, uint32_t ldb,
+	uint32_t rows_rem, uint32_t cols_rem, uint32_t col_offset, uint32_t row_offset, uint32_t LEAF_SIZE);
 
-	if (N_rem <= 64) {
+//2^3 tasks per thread
+static constexpr uint32_t TASK_DEPTH_PER_THREAD = 3;
 
-		if (N_rem % 4 == 0) {
-			for (uint32_t row_idx = 0; row_idx < N_rem; row_idx += 4) {
-				for (uint32_t col_idx = 0; col_idx < N_rem; col_idx += 4) {
-					Transpose4x4_Aligned(M, T, row_offset + row_idx,
-						col_offset + col_idx, N);
-				}
-			}
-		}
-		else {
-			for (uint32_t row_idx = 0; row_idx < N_rem; row_idx++) {
-				for (uint32_t col_idx = 0; col_idx < N_rem; col_idx++) {
-					T[(col_idx + col_offset) * N + (row_offset + row_idx)] =
-						M[(row_offset + row_idx) * N + (col_offset + col_idx)];
-				}
-			}
-		}
+uint32_t CacheObliviousTaskDepth(uint32_t threads) {
+	uint32_t depth = 0;
+
+	while ((1u << depth) < threads)
+		depth++;
+
+	return depth + TASK_DEPTH_PER_THREAD;
+}
+
+template <bool Aligned>
+void matTransposeCacheObliviousImpOMP(MatType const* M, MatType* T, uint32_t lda, uint32_t ldb,
+	uint32_t rows_rem, uint32_t cols_rem, uint32_t col_offset, uint32_t row_offset,
+	uint32_t LEAF_SIZE_OMP, uint32_t LEAF_SIZE, uint32_t task_depth) {
+
+	//Past the cutoff the rest of the subtree is one task,
+	//run by the serial recursion (edges included)
+	if (task_depth == 0 || (rows_rem <= LEAF_SIZE_OMP && cols_rem <= LEAF_SIZE_OMP)) {
+		matTransposeCacheObliviousImp<Aligned>(M, T, lda, ldb, rows_rem, cols_rem, col_offset, row_offset,
+			LEAF_SIZE);
+		return;
+	}
 
+	//Same split as the serial recursion. The first half
+	//becomes a task that idle threads can pick up, the
+	//second one is recursed into by this thread.
+	//Higher levels have bigger tasks and a higher priority,
+	//so threads start on them before the small ones
+	//(only honoured with OMP_MAX_TASK_PRIORITY set)
+	uint32_t half_rows = rows_rem, half_cols = cols_rem;
+	uint32_t second_row_offset = row_offset, second_col_offset = col_offset;
+
+	if (rows_rem >= cols_rem) {
+		half_rows = CacheObliviousSplit(rows_rem);
+		second_row_offset += half_rows;
 	}
 	else {
-		uint32_t half_size = N_rem / 2;
-
-//Run 4 different tasks. Top level will spawn 
-//4 different threads. Whether the other levels
-//add new threads or not depends on external factors
-		{
-#pragma omp task 
-			matTransposeCacheObliviousImp(M, T, N, half_size, col_offset, row_offset);
-#pragma omp task 
-			matTransposeCacheObliviousImp(M, T, N, half_size, col_offset + half_size, row_offset);
-#pragma omp task 
-			matTransposeCacheObliviousImp(M, T, N, half_size, col_offset, row_offset + half_size);
-#pragma omp task 
-			matTransposeCacheObliviousImp(M, T, N, half_size, col_offset + half_size, row_offset + half_size);
+		half_cols = CacheObliviousSplit(cols_rem);
+		second_col_offset += half_cols;
+	}
+
+#pragma omp task priority(task_depth)
+	matTransposeCacheObliviousImpOMP<Aligned>(M, T, lda, ldb, half_rows, half_cols, col_offset, row_offset,
+		LEAF_SIZE_OMP, LEAF_SIZE, task_depth - 1);
+
+	matTransposeCacheObliviousImpOMP<Aligned>(M, T, lda, ldb,
+		rows_rem >= cols_rem ? rows_rem - half_rows : rows_rem,
+		rows_rem >= cols_rem ? cols_rem : cols_rem - half_cols,
+		second_col_offset, second_row_offset, LEAF_SIZE_OMP, LEAF_SIZE, task_depth - 1);
+
 #pragma omp taskwait
-		}
+}
 
-		if (N_rem & 1) {
-			for (uint32_t row_idx = 0; row_idx < N_rem; row_idx++) {
-				T[(col_offset + N_rem - 1) * N + (row_offset + row_idx)] =
-					M[(row_offset + row_idx) * N + (col_offset + N_rem - 1)];
+template void matTransposeCacheObliviousImpOMP<true>(MatType const* M, MatType* T, uint32_t lda, uint32_t ldb,
+	uint32_t rows_rem, uint32_t cols_rem, uint32_t col_offset, uint32_t row_offset,
+	uint32_t LEAF_SIZE_OMP, uint32_t LEAF_SIZE, uint32_t task_depth);
+template void matTransposeCacheObliviousImpOMP<false>(MatType const* M, MatType* T, uint32_t lda, uint32_t ldb,
+	uint32_t rows_rem, uint32_t cols_rem, uint32_t col_offset, uint32_t row_offset,
+	uint32_t LEAF_SIZE_OMP, uint32_t LEAF_SIZE, uint32_t task_depth);
+
+void TransposeEdge(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	//Same as a leaf of the cache oblivious recursion:
+	//4x4 tiles where possible, single elements for the rest
+	CacheObliviousLeaf<false>(M, T, lda, ldb, rows, cols, 0, 0);
+}
 
-				T[(col_offset + row_idx) * N + (row_offset + N_rem - 1)] =
-					M[(row_offset + N_rem - 1) * N + (col_offset + row_idx)];
-			}
+void TransposeEdge_OMP(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t threads) {
+	//Edges are thin strips, split them along
+	//the long dimension in chunks of 64 (multiple of
+	//4, so that only the last chunk has partial tiles)
+	static constexpr uint32_t CHUNK = 64;
+
+	if (rows >= cols) {
+#pragma omp parallel for schedule(auto) num_threads(OmpThreads(threads))
+		for (uint32_t row_idx = 0; row_idx < rows; row_idx += CHUNK) {
+			CacheObliviousLeaf<false>(M, T, lda, ldb, std::min(CHUNK, rows - row_idx), cols,
+				0, row_idx);
+		}
+	}
+	else {
+#pragma omp parallel for schedule(auto) num_threads(OmpThreads(threads))
+		for (uint32_t col_idx = 0; col_idx < cols; col_idx += CHUNK) {
+			CacheObliviousLeaf<false>(M, T, lda, ldb, rows, std::min(CHUNK, cols - col_idx),
+				col_idx, 0);
 		}
 	}
 }
 
 //These functions below follow the same principle as the blocked non-sse transform
 
-template <>
-void BlockTranspose_SSE<true>(MatType const* M, MatType* T, uint32_t N, uint32_t BLOCK_SIZE) {
-	for (uint32_t row_idx = 0; row_idx < N; row_idx += BLOCK_SIZE) {
-		for (uint32_t col_idx = 0; col_idx < N; col_idx += BLOCK_SIZE) {
+template <void(*Kernel)(MatType const*, MatType*, uint32_t, uint32_t, uint32_t, uint32_t)>
+static void BlockTransposeSSE_Impl(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE) {
+	for (uint32_t row_idx = 0; row_idx < rows; row_idx += BLOCK_SIZE) {
+		for (uint32_t col_idx = 0; col_idx < cols; col_idx += BLOCK_SIZE) {
 
 			for (uint32_t row_block = row_idx; row_block < row_idx + BLOCK_SIZE; row_block += 4) {
 				for (uint32_t col_block = col_idx; col_block < col_idx + BLOCK_SIZE; col_block += 4) {
-					Transpose4x4_Aligned(M, T, row_block, col_block, N);
+					Kernel(M, T, row_block, col_block, lda, ldb);
 				}
 			}
 
@@ -323,14 +342,17 @@ void BlockTranspose_SSE<true>(MatType const* M, MatType* T, uint32_t N, uint32_t
 	}
 }
 
-template <>
-void BlockTranspose_SSE<false>(MatType const* M, MatType* T, uint32_t N, uint32_t BLOCK_SIZE) {
-	for (uint32_t row_idx = 0; row_idx < N; row_idx += BLOCK_SIZE) {
-		for (uint32_t col_idx = 0; col_idx < N; col_idx += BLOCK_SIZE) {
+template <void(*Kernel)(MatType const*, MatType*, uint32_t, uint32_t, uint32_t, uint32_t)>
+static void BlockTransposeSSE_OMP_Impl(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE, uint32_t threads) {
+#pragma omp parallel num_threads(OmpThreads(threads))
+	for (uint32_t row_idx = 0; row_idx < rows; row_idx += BLOCK_SIZE) {
+#pragma omp for collapse(2) schedule(auto)
+		for (uint32_t col_idx = 0; col_idx < cols; col_idx += BLOCK_SIZE) {
 
 			for (uint32_t row_block = row_idx; row_block < row_idx + BLOCK_SIZE; row_block += 4) {
 				for (uint32_t col_block = col_idx; col_block < col_idx + BLOCK_SIZE; col_block += 4) {
-					Transpose4x4(M, T, row_block, col_block, N);
+					Kernel(M, T, row_block, col_block, lda, ldb);
 				}
 			}
 
@@ -339,35 +361,256 @@ void BlockTranspose_SSE<false>(MatType const* M, MatType* T, uint32_t N, uint32_
 }
 
 template <>
-void BlockTranspose_SSE_OMP<true>(MatType const* M, MatType* T, uint32_t N, uint32_t BLOCK_SIZE) {
-#pragma omp parallel
-	for (uint32_t row_idx = 0; row_idx < N; row_idx += BLOCK_SIZE) {
-#pragma omp for collapse(2) schedule(auto)
-		for (uint32_t col_idx = 0; col_idx < N; col_idx += BLOCK_SIZE) {
+void BlockTranspose_SSE<true>(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE) {
+	BlockTransposeSSE_Impl<Transpose4x4_Aligned>(M, T, rows, cols, lda, ldb, BLOCK_SIZE);
+}
 
-			for (uint32_t row_block = row_idx; row_block < row_idx + BLOCK_SIZE; row_block += 4) {
-				for (uint32_t col_block = col_idx; col_block < col_idx + BLOCK_SIZE; col_block += 4) {
-					Transpose4x4_Aligned(M, T, row_block, col_block, N);
+template <>
+void BlockTranspose_SSE<false>(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE) {
+	BlockTransposeSSE_Impl<Transpose4x4>(M, T, rows, cols, lda, ldb, BLOCK_SIZE);
+}
+
+template <>
+void BlockTranspose_SSE_OMP<true>(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE, uint32_t threads) {
+	BlockTransposeSSE_OMP_Impl<Transpose4x4_Aligned>(M, T, rows, cols, lda, ldb, BLOCK_SIZE, threads);
+}
+
+template <>
+void BlockTranspose_SSE_OMP<false>(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE, uint32_t threads) {
+	BlockTransposeSSE_OMP_Impl<Transpose4x4>(M, T, rows, cols, lda, ldb, BLOCK_SIZE, threads);
+}
+
+///////////////////////////////////////////////////
+//STREAMING STORES
+
+void Transpose4x16_Stream(MatType const* src, MatType* dst,
+	uint32_t row, uint32_t col, uint32_t lda, uint32_t ldb) {
+	//4 tiles stacked vertically in src end up side by side
+	//in dst, so each of the 4 rows of dst receives 16 consecutive
+	//floats (one cache line if row is a multiple of 16).
+	//Only 4 lines are open at the same time, which
+	//fits in the write combining buffers, and each
+	//line is flushed to memory as a whole once completed,
+	//without being read first
+	for (uint32_t tile = 0; tile < 16; tile += 4) {
+		__m128 row1 = _mm_loadu_ps(&src[size_t(row + tile) * lda + col]);
+		__m128 row2 = _mm_loadu_ps(&src[size_t(row + tile + 1) * lda + col]);
+		__m128 row3 = _mm_loadu_ps(&src[size_t(row + tile + 2) * lda + col]);
+		__m128 row4 = _mm_loadu_ps(&src[size_t(row + tile + 3) * lda + col]);
+
+		Transpose4x4_Regs(row1, row2, row3, row4);
+
+		_mm_stream_ps(&dst[size_t(col) * ldb + row + tile], row1);
+		_mm_stream_ps(&dst[size_t(col + 1) * ldb + row + tile], row2);
+		_mm_stream_ps(&dst[size_t(col + 2) * ldb + row + tile], row3);
+		_mm_stream_ps(&dst[size_t(col + 3) * ldb + row + tile], row4);
+	}
+}
+
+//Column order inside the block: walk down the rows of src
+//first, so that consecutive kernels fill consecutive lines
+//of the same rows of dst
+void BlockTranspose_SSE_Stream(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE) {
+	for (uint32_t row_idx = 0; row_idx < rows; row_idx += BLOCK_SIZE) {
+		for (uint32_t col_idx = 0; col_idx < cols; col_idx += BLOCK_SIZE) {
+
+			for (uint32_t col_block = col_idx; col_block < col_idx + BLOCK_SIZE; col_block += 4) {
+				for (uint32_t row_block = row_idx; row_block < row_idx + BLOCK_SIZE; row_block += 16) {
+					Transpose4x16_Stream(M, T, row_block, col_block, lda, ldb);
 				}
 			}
 
 		}
 	}
+
+	//Non temporal stores are weakly ordered, make them
+	//globally visible before returning
+	_mm_sfence();
 }
 
-template <>
-void BlockTranspose_SSE_OMP<false>(MatType const* M, MatType* T, uint32_t N, uint32_t BLOCK_SIZE) {
-#pragma omp parallel
-	for (uint32_t row_idx = 0; row_idx < N; row_idx += BLOCK_SIZE) {
-#pragma omp for collapse(2) schedule(auto)
-		for (uint32_t col_idx = 0; col_idx < N; col_idx += BLOCK_SIZE) {
+void BlockTranspose_SSE_Stream_OMP(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE, uint32_t threads) {
+#pragma omp parallel num_threads(OmpThreads(threads))
+	{
+		for (uint32_t row_idx = 0; row_idx < rows; row_idx += BLOCK_SIZE) {
+			//No collapse here, the inner loop depends on col_idx
+			//and collapse only supports rectangular loops
+#pragma omp for schedule(auto)
+			for (uint32_t col_idx = 0; col_idx < cols; col_idx += BLOCK_SIZE) {
 
-			for (uint32_t row_block = row_idx; row_block < row_idx + BLOCK_SIZE; row_block += 4) {
 				for (uint32_t col_block = col_idx; col_block < col_idx + BLOCK_SIZE; col_block += 4) {
-					Transpose4x4(M, T, row_block, col_block, N);
+					for (uint32_t row_block = row_idx; row_block < row_idx + BLOCK_SIZE; row_block += 16) {
+						Transpose4x16_Stream(M, T, row_block, col_block, lda, ldb);
+					}
 				}
+
 			}
+		}
+
+		//Each thread fences its own stores
+		_mm_sfence();
+	}
+}
+
+///////////////////////////////////////////////////
+//IN PLACE TRANSPOSE
+
+void TransposeSwap4x4(MatType* mat, uint32_t row, uint32_t col, uint32_t N) {
+	__m128 up1{}, up2{}, up3{}, up4{};
+	__m128 lo1{}, lo2{}, lo3{}, lo4{};
+
+	//Load both tiles before storing anything, 
+	//so that when row == col (tile on the diagonal)
+	//we do not read values that were already swapped
+	up1 = _mm_loadu_ps(&mat[row * N + col]);
+	up2 = _mm_loadu_ps(&mat[(row + 1) * N + col]);
+	up3 = _mm_loadu_ps(&mat[(row + 2) * N + col]);
+	up4 = _mm_loadu_ps(&mat[(row + 3) * N + col]);
+
+	lo1 = _mm_loadu_ps(&mat[col * N + row]);
+	lo2 = _mm_loadu_ps(&mat[(col + 1) * N + row]);
+	lo3 = _mm_loadu_ps(&mat[(col + 2) * N + row]);
+	lo4 = _mm_loadu_ps(&mat[(col + 3) * N + row]);
+
+	Transpose4x4_Regs(up1, up2, up3, up4);
+	Transpose4x4_Regs(lo1, lo2, lo3, lo4);
+
+	//The transposed upper tile goes to the mirrored
+	//position and vice versa
+	_mm_storeu_ps(&mat[col * N + row], up1);
+	_mm_storeu_ps(&mat[(col + 1) * N + row], up2);
+	_mm_storeu_ps(&mat[(col + 2) * N + row], up3);
+	_mm_storeu_ps(&mat[(col + 3) * N + row], up4);
+
+	_mm_storeu_ps(&mat[row * N + col], lo1);
+	_mm_storeu_ps(&mat[(row + 1) * N + col], lo2);
+	_mm_storeu_ps(&mat[(row + 2) * N + col], lo3);
+	_mm_storeu_ps(&mat[(row + 3) * N + col], lo4);
+}
 
+void TransposeSwap4x4_Aligned(MatType* mat, uint32_t row, uint32_t col, uint32_t N) {
+	__m128 up1{}, up2{}, up3{}, up4{};
+	__m128 lo1{}, lo2{}, lo3{}, lo4{};
+
+	up1 = _mm_load_ps(&mat[row * N + col]);
+	up2 = _mm_load_ps(&mat[(row + 1) * N + col]);
+	up3 = _mm_load_ps(&mat[(row + 2) * N + col]);
+	up4 = _mm_load_ps(&mat[(row + 3) * N + col]);
+
+	lo1 = _mm_load_ps(&mat[col * N + row]);
+	lo2 = _mm_load_ps(&mat[(col + 1) * N + row]);
+	lo3 = _mm_load_ps(&mat[(col + 2) * N + row]);
+	lo4 = _mm_load_ps(&mat[(col + 3) * N + row]);
+
+	Transpose4x4_Regs(up1, up2, up3, up4);
+	Transpose4x4_Regs(lo1, lo2, lo3, lo4);
+
+	_mm_store_ps(&mat[col * N + row], up1);
+	_mm_store_ps(&mat[(col + 1) * N + row], up2);
+	_mm_store_ps(&mat[(col + 2) * N + row], up3);
+	_mm_store_ps(&mat[(col + 3) * N + row], up4);
+
+	_mm_store_ps(&mat[row * N + col], lo1);
+	_mm_store_ps(&mat[(row + 1) * N + col], lo2);
+	_mm_store_ps(&mat[(row + 2) * N + col], lo3);
+	_mm_store_ps(&mat[(row + 3) * N + col], lo4);
+}
+
+//Swaps the block at (row_idx, col_idx) with its mirror,
+//4x4 tiles at a time. If the block is on the diagonal,
+//only the tiles above the diagonal (and the diagonal tiles
+//themselves) must be swapped, otherwise we would swap twice
+template <void(*Kernel)(MatType*, uint32_t, uint32_t, uint32_t)>
+static void SwapBlockPair_SSE(MatType* M, uint32_t N, uint32_t BLOCK_SIZE,
+	uint32_t row_idx, uint32_t col_idx) {
+	for (uint32_t row_block = row_idx; row_block < row_idx + BLOCK_SIZE; row_block += 4) {
+		uint32_t col_start = (row_idx == col_idx) ? row_block : col_idx;
+
+		for (uint32_t col_block = col_start; col_block < col_idx + BLOCK_SIZE; col_block += 4) {
+			Kernel(M, row_block, col_block, N);
 		}
 	}
-}
\ No newline at end of file
+}
+
+static void SwapBlockPair_NoSSE(MatType* M, uint32_t N, uint32_t BLOCK_SIZE,
+	uint32_t row_idx, uint32_t col_idx) {
+	uint32_t row_bound = std::min(row_idx + BLOCK_SIZE, N);
+	uint32_t col_bound = std::min(col_idx + BLOCK_SIZE, N);
+
+	for (uint32_t row_block = row_idx; row_block < row_bound; row_block++) {
+		//Skip the diagonal and what is below it
+		uint32_t col_start = (row_idx == col_idx) ? row_block + 1 : col_idx;
+
+		for (uint32_t col_block = col_start; col_block < col_bound; col_block++) {
+			std::swap(M[row_block * N + col_block], M[col_block * N + row_block]);
+		}
+	}
+}
+
+template <void(*Pair)(MatType*, uint32_t, uint32_t, uint32_t, uint32_t)>
+static void InPlaceUpperBlocks(MatType* M, uint32_t N, uint32_t BLOCK_SIZE) {
+	for (uint32_t row_idx = 0; row_idx < N; row_idx += BLOCK_SIZE) {
+		for (uint32_t col_idx = row_idx; col_idx < N; col_idx += BLOCK_SIZE) {
+			Pair(M, N, BLOCK_SIZE, row_idx, col_idx);
+		}
+	}
+}
+
+//The upper triangle of blocks is not rectangular, and block row
+//i has (NUM_BLOCKS - i) blocks. Fold block row i together with 
+//block row NUM_BLOCKS - 1 - i, so that every iteration of the
+//parallel loop swaps exactly NUM_BLOCKS + 1 block pairs
+//and static schedules stay balanced
+template <void(*Pair)(MatType*, uint32_t, uint32_t, uint32_t, uint32_t)>
+static void InPlaceUpperBlocks_OMP(MatType* M, uint32_t N, uint32_t BLOCK_SIZE) {
+	const uint32_t NUM_BLOCKS = (N + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	const uint32_t NUM_FOLDS = (NUM_BLOCKS + 1) / 2;
+
+#pragma omp parallel for schedule(auto)
+	for (uint32_t fold = 0; fold < NUM_FOLDS; fold++) {
+		uint32_t block_rows[2] = { fold, NUM_BLOCKS - 1 - fold };
+		//Middle row when NUM_BLOCKS is odd
+		uint32_t num_rows = (block_rows[0] == block_rows[1]) ? 1 : 2;
+
+		for (uint32_t curr = 0; curr < num_rows; curr++) {
+			uint32_t row_idx = block_rows[curr] * BLOCK_SIZE;
+
+			for (uint32_t col_idx = row_idx; col_idx < N; col_idx += BLOCK_SIZE) {
+				Pair(M, N, BLOCK_SIZE, row_idx, col_idx);
+			}
+		}
+	}
+}
+
+void BlockTransposeInPlace_NoSSE(MatType* M, uint32_t N, uint32_t BLOCK_SIZE) {
+	InPlaceUpperBlocks<SwapBlockPair_NoSSE>(M, N, BLOCK_SIZE);
+}
+
+void BlockTransposeInPlace_NoSSE_OMP(MatType* M, uint32_t N, uint32_t BLOCK_SIZE) {
+	InPlaceUpperBlocks_OMP<SwapBlockPair_NoSSE>(M, N, BLOCK_SIZE);
+}
+
+template <>
+void BlockTransposeInPlace_SSE<true>(MatType* M, uint32_t N, uint32_t BLOCK_SIZE) {
+	InPlaceUpperBlocks<SwapBlockPair_SSE<TransposeSwap4x4_Aligned>>(M, N, BLOCK_SIZE);
+}
+
+template <>
+void BlockTransposeInPlace_SSE<false>(MatType* M, uint32_t N, uint32_t BLOCK_SIZE) {
+	InPlaceUpperBlocks<SwapBlockPair_SSE<TransposeSwap4x4>>(M, N, BLOCK_SIZE);
+}
+
+template <>
+void BlockTransposeInPlace_SSE_OMP<true>(MatType* M, uint32_t N, uint32_t BLOCK_SIZE) {
+	InPlaceUpperBlocks_OMP<SwapBlockPair_SSE<TransposeSwap4x4_Aligned>>(M, N, BLOCK_SIZE);
+}
+
+template <>
+void BlockTransposeInPlace_SSE_OMP<false>(MatType* M, uint32_t N, uint32_t BLOCK_SIZE) {
+	InPlaceUpperBlocks_OMP<SwapBlockPair_SSE<TransposeSwap4x4>>(M, N, BLOCK_SIZE);
+}
@@ -3,6 +3,14 @@
 
 #include "Defs.h"
 
+/// <summary>
+/// Value for the num_threads clause of
+/// the parallel kernels
+/// </summary>
+/// <param name="threads">Requested threads, 0 = OpenMP default</param>
+/// <returns>Number of threads</returns>
+int OmpThreads(uint32_t threads);
+
 /// <summary>
 /// Computes block size for optimized
 /// transpose functions depending on the
@@ -13,6 +21,27 @@
 /// <returns>Block size</returns>
 uint32_t ComputeBlockSize(uint32_t N, uint32_t CACHE_LINE);
 
+/// <summary>
+/// Computes block size for a rows x cols
+/// matrix, the block divides both
+/// </summary>
+/// <param name="rows">Number of rows</param>
+/// <param name="cols">Number of columns</param>
+/// <param name="CACHE_LINE">Cache line size</param>
+/// <returns>Block size</returns>
+uint32_t ComputeBlockSize(uint32_t rows, uint32_t cols, uint32_t CACHE_LINE);
+
+/// <summary>
+/// Same as above, for elements of ELEM_SIZE bytes
+/// instead of MatType
+/// </summary>
+/// <param name="rows">Number of rows</param>
+/// <param name="cols">Number of columns</param>
+/// <param name="CACHE_LINE">Cache line size</param>
+/// <param name="ELEM_SIZE">Size of one element in bytes</param>
+/// <returns>Block size</returns>
+uint32_t ComputeElemBlockSize(uint32_t rows, uint32_t cols, uint32_t CACHE_LINE, uint32_t ELEM_SIZE);
+
 /// <summary>
 /// Transposes 4x4 block using SSE and
 /// unaligned loads
@@ -21,9 +50,10 @@ uint32_t ComputeBlockSize(uint32_t N, uint32_t CACHE_LINE);
 /// <param name="dst">Dest ptr</param>
 /// <param name="row">Curr row</param>
 /// <param name="col">Curr col</param>
-/// <param name="N">Size of rows and cols</param>
+/// <param name="lda">Leading dimension of src</param>
+/// <param name="ldb">Leading dimension of dst</param>
 void Transpose4x4(MatType const* src, MatType* dst,
-	uint32_t row, uint32_t col, uint32_t N);
+	uint32_t row, uint32_t col, uint32_t lda, uint32_t ldb);
 
 /// <summary>
 /// Transposes 4x4 block using SSE and
@@ -33,9 +63,10 @@ void Transpose4x4(MatType const* src, MatType* dst,
 /// <param name="dst">Dest ptr</param>
 /// <param name="row">Curr row</param>
 /// <param name="col">Curr col</param>
-/// <param name="N">Size of rows and cols</param>
+/// <param name="lda">Leading dimension of src</param>
+/// <param name="ldb">Leading dimension of dst</param>
 void Transpose4x4_Aligned(MatType const* src, MatType* dst,
-	uint32_t row, uint32_t col, uint32_t N);
+	uint32_t row, uint32_t col, uint32_t lda, uint32_t ldb);
 
 /// <summary>
 /// Transpose matrix by blocks without
@@ -43,9 +74,13 @@ void Transpose4x4_Aligned(MatType const* src, MatType* dst,
 /// </summary>
 /// <param name="M">Source matrix</param>
 /// <param name="T">Dest matrix</param>
-/// <param name="N">N</param>
+/// <param name="rows">Rows of M</param>
+/// <param name="cols">Columns of M</param>
+/// <param name="lda">Leading dimension of M</param>
+/// <param name="ldb">Leading dimension of T</param>
 /// <param name="BLOCK_SIZE">The block size</param>
-void BlockTranspose_NoSSE(MatType const* M, MatType* T, uint32_t N, uint32_t BLOCK_SIZE);
+void BlockTranspose_NoSSE(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE);
 
 /// <summary>
 /// Transpose matrix by blocks without
@@ -54,35 +89,97 @@ void BlockTranspose_NoSSE(MatType const* M, MatType* T, uint32_t N, uint32_t BLO
 /// </summary>
 /// <param name="M">Source matrix</param>
 /// <param name="T">Dest matrix</param>
-/// <param name="N">N</param>
+/// <param name="rows">Rows of M</param>
+/// <param name="cols">Columns of M</param>
+/// <param name="lda">Leading dimension of M</param>
+/// <param name="ldb">Leading dimension of T</param>
 /// <param name="BLOCK_SIZE">The block size</param>
-void BlockTranspose_NoSSE_OMP(MatType const* M, MatType* T, uint32_t N, uint32_t BLOCK_SIZE);
+void BlockTranspose_NoSSE_OMP(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE);
 
 /// <summary>
-/// Transposes the matrix in a cache oblivious fashion.
-/// Depending on the matrix size, uses SSE or 
-/// normal blocked transpose
+/// Transposes the matrix in a cache oblivious fashion,
+/// by splitting the largest dimension in half.
+/// Leaves use the 4x4 SSE kernel for full tiles and
+/// plain copies for the edges
 /// </summary>
+/// <typeparam name="Aligned">If M and T are aligned to 16 bytes and lda, ldb are multiples of 4</typeparam>
 /// <param name="M">Source matrix</param>
 /// <param name="T">Dest matrix</param>
-/// <param name="N">N</param>
-/// <param name="N_rem">Remaining matrix size in recursion</param>
+/// <param name="lda">Leading dimension of M</param>
+/// <param name="ldb">Leading dimension of T</param>
+/// <param name="rows_rem">Remaining rows in recursion</param>
+/// <param name="cols_rem">Remaining columns in recursion</param>
 /// <param name="col_offset">Global column offset</param>
 /// <param name="row_offset">Global row offset</param>
-void matTransposeCacheObliviousImp(MatType const* M, MatType* T, uint32_t N,
-	uint32_t N_rem, uint32_t col_offset, uint32_t row_offset);
+/// <param name="LEAF_SIZE">Recursion stops when both sides are at most this</param>
+template <bool Aligned>
+void matTransposeCacheObliviousImp(MatType const* M, MatType* T, uint32_t lda, uint32_t ldb,
+	uint32_t rows_rem, uint32_t cols_rem, uint32_t col_offset, uint32_t row_offset, uint32_t LEAF_SIZE);
 
 /// <summary>
-/// Same as above using openmp
+/// Same as above using openmp tasks: every level of the
+/// recursion, up to task_depth levels, makes one half a
+/// task, so there are up to 2^task_depth tasks spread
+/// over the threads. Must be called inside a parallel
+/// region (by a single thread)
 /// </summary>
+/// <typeparam name="Aligned">If M and T are aligned to 16 bytes and lda, ldb are multiples of 4</typeparam>
 /// <param name="M">Source matrix</param>
 /// <param name="T">Dest matrix</param>
-/// <param name="N">N</param>
-/// <param name="N_rem">Remaining matrix size in recursion</param>
+/// <param name="lda">Leading dimension of M</param>
+/// <param name="ldb">Leading dimension of T</param>
+/// <param name="rows_rem">Remaining rows in recursion</param>
+/// <param name="cols_rem">Remaining columns in recursion</param>
 /// <param name="col_offset">Global column offset</param>
 /// <param name="row_offset">Global row offset</param>
-void matTransposeCacheObliviousImpOMP(MatType const* M, MatType* T, uint32_t N,
-	uint32_t N_rem, uint32_t col_offset, uint32_t row_offset);
+/// <param name="LEAF_SIZE_OMP">Up to this size no tasks are spawned</param>
+/// <param name="LEAF_SIZE">Leaf size of the serial recursion run by the tasks</param>
+/// <param name="task_depth">Levels of the recursion that still spawn tasks</param>
+template <bool Aligned>
+void matTransposeCacheObliviousImpOMP(MatType const* M, MatType* T, uint32_t lda, uint32_t ldb,
+	uint32_t rows_rem, uint32_t cols_rem, uint32_t col_offset, uint32_t row_offset,
+	uint32_t LEAF_SIZE_OMP, uint32_t LEAF_SIZE, uint32_t task_depth);
+
+/// <summary>
+/// Levels of the parallel cache oblivious recursion that
+/// spawn tasks for the given number of threads: a few
+/// tasks per thread, so that idle threads can pick up
+/// the work left by the slow ones
+/// </summary>
+/// <param name="threads">Threads of the parallel region</param>
+/// <returns>Task depth</returns>
+uint32_t CacheObliviousTaskDepth(uint32_t threads);
+
+/// <summary>
+/// Edge kernel for the strips left over by a blocked
+/// transpose with a fixed block size.
+/// Uses 4x4 SSE tiles (unaligned) where possible and
+/// copies the remaining elements one at a time, so
+/// any rows and cols are accepted
+/// </summary>
+/// <param name="M">Source strip</param>
+/// <param name="T">Dest strip</param>
+/// <param name="rows">Rows of the strip</param>
+/// <param name="cols">Columns of the strip</param>
+/// <param name="lda">Leading dimension of M</param>
+/// <param name="ldb">Leading dimension of T</param>
+void TransposeEdge(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb);
+
+/// <summary>
+/// See above, but with OMP. The strip is split
+/// along its longest dimension
+/// </summary>
+/// <param name="M">Source strip</param>
+/// <param name="T">Dest strip</param>
+/// <param name="rows">Rows of the strip</param>
+/// <param name="cols">Columns of the strip</param>
+/// <param name="lda">Leading dimension of M</param>
+/// <param name="ldb">Leading dimension of T</param>
+/// <param name="threads">Threads of the parallel region, 0 = OpenMP default</param>
+void TransposeEdge_OMP(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t threads);
 
 /// <summary>
 /// Transpose matrix by blocks while
@@ -94,10 +191,14 @@ void matTransposeCacheObliviousImpOMP(MatType const* M, MatType* T, uint32_t N,
 /// <typeparam name="Aligned">If the matrices are aligned to 16 bytes boundaries</typeparam>
 /// <param name="M">Source matrix</param>
 /// <param name="T">Dest matrix</param>
-/// <param name="N">N</param>
+/// <param name="rows">Rows of M</param>
+/// <param name="cols">Columns of M</param>
+/// <param name="lda">Leading dimension of M</param>
+/// <param name="ldb">Leading dimension of T</param>
 /// <param name="BLOCK_SIZE">The block size</param>
 template <bool Aligned>
-void BlockTranspose_SSE(MatType const* M, MatType* T, uint32_t N, uint32_t BLOCK_SIZE);
+void BlockTranspose_SSE(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE);
 
 /// <summary>
 /// See above, but with OMP
@@ -105,9 +206,244 @@ void BlockTranspose_SSE(MatType const* M, MatType* T, uint32_t N, uint32_t BLOCK
 /// <typeparam name="Aligned">If the matrices are aligned to 16 bytes boundaries</typeparam>
 /// <param name="M">Source matrix</param>
 /// <param name="T">Dest matrix</param>
+/// <param name="rows">Rows of M</param>
+/// <param name="cols">Columns of M</param>
+/// <param name="lda">Leading dimension of M</param>
+/// <param name="ldb">Leading dimension of T</param>
+/// <param name="BLOCK_SIZE">The block size</param>
+/// <param name="threads">Threads of the parallel region, 0 = OpenMP default</param>
+template <bool Aligned>
+void BlockTranspose_SSE_OMP(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE, uint32_t threads);
+
+/// <summary>
+/// Transposes 8x8 block using AVX2 and
+/// unaligned loads
+/// </summary>
+/// <param name="src">Source ptr</param>
+/// <param name="dst">Dest ptr</param>
+/// <param name="row">Curr row</param>
+/// <param name="col">Curr col</param>
+/// <param name="lda">Leading dimension of src</param>
+/// <param name="ldb">Leading dimension of dst</param>
+void Transpose8x8(MatType const* src, MatType* dst,
+	uint32_t row, uint32_t col, uint32_t lda, uint32_t ldb);
+
+/// <summary>
+/// Transposes 8x8 block using AVX2 and
+/// aligned loads (32 bytes)
+/// </summary>
+/// <param name="src">Source ptr</param>
+/// <param name="dst">Dest ptr</param>
+/// <param name="row">Curr row</param>
+/// <param name="col">Curr col</param>
+/// <param name="lda">Leading dimension of src</param>
+/// <param name="ldb">Leading dimension of dst</param>
+void Transpose8x8_Aligned(MatType const* src, MatType* dst,
+	uint32_t row, uint32_t col, uint32_t lda, uint32_t ldb);
+
+/// <summary>
+/// Transposes 16x16 block using AVX-512 and
+/// unaligned loads
+/// </summary>
+/// <param name="src">Source ptr</param>
+/// <param name="dst">Dest ptr</param>
+/// <param name="row">Curr row</param>
+/// <param name="col">Curr col</param>
+/// <param name="lda">Leading dimension of src</param>
+/// <param name="ldb">Leading dimension of dst</param>
+void Transpose16x16(MatType const* src, MatType* dst,
+	uint32_t row, uint32_t col, uint32_t lda, uint32_t ldb);
+
+/// <summary>
+/// Transposes 16x16 block using AVX-512 and
+/// aligned loads (64 bytes)
+/// </summary>
+/// <param name="src">Source ptr</param>
+/// <param name="dst">Dest ptr</param>
+/// <param name="row">Curr row</param>
+/// <param name="col">Curr col</param>
+/// <param name="lda">Leading dimension of src</param>
+/// <param name="ldb">Leading dimension of dst</param>
+void Transpose16x16_Aligned(MatType const* src, MatType* dst,
+	uint32_t row, uint32_t col, uint32_t lda, uint32_t ldb);
+
+/// <summary>
+/// Same as BlockTranspose_SSE, but with
+/// 8x8 AVX2 register tiles.
+/// BLOCK_SIZE must be a multiple of 8.
+/// Only call this if the CPU supports AVX2
+/// (see SelectBlockTranspose)
+/// </summary>
+/// <typeparam name="Aligned">If the matrices are aligned to 32 bytes boundaries</typeparam>
+/// <param name="M">Source matrix</param>
+/// <param name="T">Dest matrix</param>
+/// <param name="rows">Rows of M</param>
+/// <param name="cols">Columns of M</param>
+/// <param name="lda">Leading dimension of M</param>
+/// <param name="ldb">Leading dimension of T</param>
+/// <param name="BLOCK_SIZE">The block size</param>
+template <bool Aligned>
+void BlockTranspose_AVX2(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE);
+
+/// <summary>
+/// See above, but with OMP
+/// </summary>
+/// <typeparam name="Aligned">If the matrices are aligned to 32 bytes boundaries</typeparam>
+/// <param name="M">Source matrix</param>
+/// <param name="T">Dest matrix</param>
+/// <param name="rows">Rows of M</param>
+/// <param name="cols">Columns of M</param>
+/// <param name="lda">Leading dimension of M</param>
+/// <param name="ldb">Leading dimension of T</param>
+/// <param name="BLOCK_SIZE">The block size</param>
+/// <param name="threads">Threads of the parallel region, 0 = OpenMP default</param>
+template <bool Aligned>
+void BlockTranspose_AVX2_OMP(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE, uint32_t threads);
+
+/// <summary>
+/// Same as BlockTranspose_SSE, but with
+/// 16x16 AVX-512 register tiles.
+/// BLOCK_SIZE must be a multiple of 16.
+/// Only call this if the CPU supports AVX-512F
+/// (see SelectBlockTranspose)
+/// </summary>
+/// <typeparam name="Aligned">If the matrices are aligned to 64 bytes boundaries</typeparam>
+/// <param name="M">Source matrix</param>
+/// <param name="T">Dest matrix</param>
+/// <param name="rows">Rows of M</param>
+/// <param name="cols">Columns of M</param>
+/// <param name="lda">Leading dimension of M</param>
+/// <param name="ldb">Leading dimension of T</param>
+/// <param name="BLOCK_SIZE">The block size</param>
+template <bool Aligned>
+void BlockTranspose_AVX512(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE);
+
+/// <summary>
+/// See above, but with OMP
+/// </summary>
+/// <typeparam name="Aligned">If the matrices are aligned to 64 bytes boundaries</typeparam>
+/// <param name="M">Source matrix</param>
+/// <param name="T">Dest matrix</param>
+/// <param name="rows">Rows of M</param>
+/// <param name="cols">Columns of M</param>
+/// <param name="lda">Leading dimension of M</param>
+/// <param name="ldb">Leading dimension of T</param>
+/// <param name="BLOCK_SIZE">The block size</param>
+/// <param name="threads">Threads of the parallel region, 0 = OpenMP default</param>
+template <bool Aligned>
+void BlockTranspose_AVX512_OMP(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE, uint32_t threads);
+
+/// <summary>
+/// Transposes a 16x4 block (16 rows, 4 columns) using SSE,
+/// unaligned loads and non temporal stores.
+/// dst rows must be aligned to 16 bytes
+/// </summary>
+/// <param name="src">Source ptr</param>
+/// <param name="dst">Dest ptr</param>
+/// <param name="row">Curr row, multiple of 4</param>
+/// <param name="col">Curr col, multiple of 4</param>
+/// <param name="lda">Leading dimension of src</param>
+/// <param name="ldb">Leading dimension of dst</param>
+void Transpose4x16_Stream(MatType const* src, MatType* dst,
+	uint32_t row, uint32_t col, uint32_t lda, uint32_t ldb);
+
+/// <summary>
+/// Transpose matrix by blocks while using SSE,
+/// tiling and non temporal stores.
+/// BLOCK_SIZE must be a multiple of 16, and
+/// T must be aligned to 16 bytes with ldb 
+/// multiple of 4
+/// </summary>
+/// <param name="M">Source matrix</param>
+/// <param name="T">Dest matrix</param>
+/// <param name="rows">Rows of M</param>
+/// <param name="cols">Columns of M</param>
+/// <param name="lda">Leading dimension of M</param>
+/// <param name="ldb">Leading dimension of T</param>
+/// <param name="BLOCK_SIZE">The block size</param>
+void BlockTranspose_SSE_Stream(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE);
+
+/// <summary>
+/// See above, but with OMP
+/// </summary>
+/// <param name="M">Source matrix</param>
+/// <param name="T">Dest matrix</param>
+/// <param name="rows">Rows of M</param>
+/// <param name="cols">Columns of M</param>
+/// <param name="lda">Leading dimension of M</param>
+/// <param name="ldb">Leading dimension of T</param>
+/// <param name="BLOCK_SIZE">The block size</param>
+/// <param name="threads">Threads of the parallel region, 0 = OpenMP default</param>
+void BlockTranspose_SSE_Stream_OMP(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, uint32_t BLOCK_SIZE, uint32_t threads);
+
+/// <summary>
+/// Transposes the 4x4 block at (row, col) and
+/// the one at (col, row) and swaps them, 
+/// using SSE and unaligned loads.
+/// Works also when row == col
+/// </summary>
+/// <param name="mat">Matrix ptr</param>
+/// <param name="row">Curr row</param>
+/// <param name="col">Curr col</param>
+/// <param name="N">Leading dimension of mat</param>
+void TransposeSwap4x4(MatType* mat, uint32_t row, uint32_t col, uint32_t N);
+
+/// <summary>
+/// Same as above, with aligned loads
+/// </summary>
+/// <param name="mat">Matrix ptr</param>
+/// <param name="row">Curr row</param>
+/// <param name="col">Curr col</param>
+/// <param name="N">Leading dimension of mat</param>
+void TransposeSwap4x4_Aligned(MatType* mat, uint32_t row, uint32_t col, uint32_t N);
+
+/// <summary>
+/// Transposes the matrix in place by swapping
+/// mirrored blocks across the diagonal,
+/// without using SSE
+/// </summary>
+/// <param name="M">The matrix</param>
+/// <param name="N">N</param>
+/// <param name="BLOCK_SIZE">The block size</param>
+void BlockTransposeInPlace_NoSSE(MatType* M, uint32_t N, uint32_t BLOCK_SIZE);
+
+/// <summary>
+/// See above, but with OMP. Pairs of blocks
+/// in the upper triangle are split between threads
+/// </summary>
+/// <param name="M">The matrix</param>
+/// <param name="N">N</param>
+/// <param name="BLOCK_SIZE">The block size</param>
+void BlockTransposeInPlace_NoSSE_OMP(MatType* M, uint32_t N, uint32_t BLOCK_SIZE);
+
+/// <summary>
+/// Transposes the matrix in place by swapping
+/// mirrored blocks across the diagonal, 
+/// using the 4x4 SSE kernels.
+/// BLOCK_SIZE must be a multiple of 4
+/// </summary>
+/// <typeparam name="Aligned">If the matrix is aligned to 16 bytes boundaries</typeparam>
+/// <param name="M">The matrix</param>
+/// <param name="N">N</param>
+/// <param name="BLOCK_SIZE">The block size</param>
+template <bool Aligned>
+void BlockTransposeInPlace_SSE(MatType* M, uint32_t N, uint32_t BLOCK_SIZE);
+
+/// <summary>
+/// See above, but with OMP
+/// </summary>
+/// <typeparam name="Aligned">If the matrix is aligned to 16 bytes boundaries</typeparam>
+/// <param name="M">The matrix</param>
 /// <param name="N">N</param>
 /// <param name="BLOCK_SIZE">The block size</param>
 template <bool Aligned>
-void BlockTranspose_SSE_OMP(MatType const* M, MatType* T, uint32_t N, uint32_t BLOCK_SIZE);
+void BlockTransposeInPlace_SSE_OMP(MatType* M, uint32_t N, uint32_t BLOCK_SIZE);
 
 #endif // !PARCO_MATRIX_UTILS
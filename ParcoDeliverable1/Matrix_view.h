@@ -0,0 +1,163 @@
+#ifndef PARCO_MATRIX_VIEW
+#define PARCO_MATRIX_VIEW
+
+#include "Defs.h"
+#include "Matrix_alloc.h"
+
+#include <type_traits>
+#include <utility>
+
+//Alignment of the rows of an aligned view,
+//enough for every kernel (one AVX-512 register)
+static constexpr uint32_t VIEW_ALIGNMENT = 64;
+
+template <typename Elem, bool Aligned = false>
+class MatrixView;
+
+/// <summary>
+/// Non owning rows x cols matrix, row r starting
+/// at Data() + r * LeadingDim(). Copies are cheap,
+/// pass it by value
+/// </summary>
+template <typename Elem>
+class MatrixView<Elem, false> {
+public:
+	MatrixView() : m_data(nullptr), m_rows(0), m_cols(0), m_ld(0) {}
+
+	MatrixView(Elem* data, uint32_t rows, uint32_t cols, uint32_t ld)
+		: m_data(data), m_rows(rows), m_cols(cols), m_ld(ld) {}
+
+	//Square and contiguous
+	MatrixView(Elem* data, uint32_t N) : MatrixView(data, N, N, N) {}
+
+	//Views of non const elements can be
+	//passed where a const view is expected
+	operator MatrixView<typename std::add_const<Elem>::type, false>() const {
+		return MatrixView<typename std::add_const<Elem>::type, false>(m_data, m_rows, m_cols, m_ld);
+	}
+
+	Elem* Data() const { return m_data; }
+	uint32_t Rows() const { return m_rows; }
+	uint32_t Cols() const { return m_cols; }
+	uint32_t LeadingDim() const { return m_ld; }
+
+	bool IsSquare() const { return m_rows == m_cols; }
+
+	Elem* Row(uint32_t row) const { return m_data + size_t(row) * m_ld; }
+
+	Elem& operator()(uint32_t row, uint32_t col) const { return m_data[size_t(row) * m_ld + col]; }
+
+	//rows x cols block starting at (row, col), same memory.
+	//It is unaligned, its first column can be anywhere
+	MatrixView<Elem, false> Sub(uint32_t row, uint32_t col, uint32_t rows, uint32_t cols) const {
+		return MatrixView<Elem, false>(Row(row) + col, rows, cols, m_ld);
+	}
+
+protected:
+	Elem* m_data;
+	uint32_t m_rows;
+	uint32_t m_cols;
+	uint32_t m_ld;
+};
+
+/// <summary>
+/// View whose rows all start on a VIEW_ALIGNMENT boundary,
+/// which the caller guarantees when building it (a Matrix
+/// always does). The functions taking aligned views use
+/// the aligned kernels without checking the pointers.
+/// It converts to an unaligned view, its base class
+/// </summary>
+template <typename Elem>
+class MatrixView<Elem, true> : public MatrixView<Elem, false> {
+public:
+	MatrixView() {}
+
+	MatrixView(Elem* data, uint32_t rows, uint32_t cols, uint32_t ld)
+		: MatrixView<Elem, false>(data, rows, cols, ld) {}
+
+	MatrixView(Elem* data, uint32_t N) : MatrixView(data, N, N, N) {}
+
+	operator MatrixView<typename std::add_const<Elem>::type, true>() const {
+		return MatrixView<typename std::add_const<Elem>::type, true>(this->m_data, this->m_rows,
+			this->m_cols, this->m_ld);
+	}
+};
+
+/// <summary>
+/// Owning rows x cols matrix, allocated with AllocateBuffer.
+/// Rows are padded to VIEW_ALIGNMENT, so the matrix converts
+/// to aligned views and the aligned kernels are always used.
+/// Movable, not copyable
+/// </summary>
+template <typename Elem>
+class Matrix {
+	static_assert(VIEW_ALIGNMENT % sizeof(Elem) == 0, "Rows could not be aligned");
+
+	//Elements in VIEW_ALIGNMENT bytes
+	static constexpr uint32_t ALIGN_ELEMS = VIEW_ALIGNMENT / sizeof(Elem);
+
+public:
+	Matrix() : m_data(nullptr), m_rows(0), m_cols(0), m_ld(0) {}
+
+	Matrix(uint32_t rows, uint32_t cols, MatrixAllocOptions const& options = DefaultAllocOptions())
+		: m_rows(rows), m_cols(cols), m_ld((cols + ALIGN_ELEMS - 1) / ALIGN_ELEMS * ALIGN_ELEMS) {
+		m_data = static_cast<Elem*>(AllocateBuffer(rows, size_t(m_ld) * sizeof(Elem), options));
+	}
+
+	explicit Matrix(uint32_t N) : Matrix(N, N) {}
+
+	Matrix(Matrix const&) = delete;
+	Matrix& operator=(Matrix const&) = delete;
+
+	Matrix(Matrix&& other) : Matrix() {
+		Swap(other);
+	}
+
+	Matrix& operator=(Matrix&& other) {
+		Matrix moved(std::move(other));
+		Swap(moved);
+		return *this;
+	}
+
+	~Matrix() {
+		FreeMatrix(m_data);
+	}
+
+	void Swap(Matrix& other) {
+		std::swap(m_data, other.m_data);
+		std::swap(m_rows, other.m_rows);
+		std::swap(m_cols, other.m_cols);
+		std::swap(m_ld, other.m_ld);
+	}
+
+	MatrixView<Elem, true> View() {
+		return MatrixView<Elem, true>(m_data, m_rows, m_cols, m_ld);
+	}
+
+	MatrixView<Elem const, true> View() const {
+		return MatrixView<Elem const, true>(m_data, m_rows, m_cols, m_ld);
+	}
+
+	operator MatrixView<Elem, true>() { return View(); }
+	operator MatrixView<Elem const, true>() const { return View(); }
+
+	Elem* Data() { return m_data; }
+	Elem const* Data() const { return m_data; }
+	uint32_t Rows() const { return m_rows; }
+	uint32_t Cols() const { return m_cols; }
+	uint32_t LeadingDim() const { return m_ld; }
+
+	//false if the allocation failed
+	bool IsValid() const { return m_data != nullptr; }
+
+	Elem& operator()(uint32_t row, uint32_t col) { return m_data[size_t(row) * m_ld + col]; }
+	Elem const& operator()(uint32_t row, uint32_t col) const { return m_data[size_t(row) * m_ld + col]; }
+
+private:
+	Elem* m_data;
+	uint32_t m_rows;
+	uint32_t m_cols;
+	uint32_t m_ld;
+};
+
+#endif // !PARCO_MATRIX_VIEW
@@ -3,11 +3,15 @@
 
 #include "ParcoDeliverable1.h"
 
+#include <algorithm>
 #include <memory>
 #include <chrono>
 #include <type_traits>
 #include <iomanip>
 #include <fstream>
+#include <regex>
+#include <string>
+#include <vector>
 
 //Use old ctime header for time(), rand() and srand()
 //Using the C++ distributions for random numbers is too much
@@ -16,6 +20,10 @@
 
 //memcmp()
 #include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <complex>
+#include <cstdio>
 
 //Project includes
 #include "Defs.h"
@@ -23,6 +31,10 @@
 #include "Utils.h"
 #include "Matrix_utils.h"
 #include "Matrix_manip.h"
+#include "Matrix_view.h"
+#include "Tuning.h"
+#include "Matrix_ooc.h"
+#include "Matrix_file.h"
 
 //Default value of rows and cols
 static constexpr uint32_t CONST_N = 4096;
@@ -32,38 +44,716 @@ static constexpr uint32_t MAX_THREADS = 16;
 // ///////////////////////MATRIX MANIP/CHECK FUNCTIONS//////
 
 #ifdef CONSTEXPR_N
-	//Here lies the attempt at using a constexpr matrix size to 
-	//improve loop unrolling by the compiler.
-	//Unfortunately, it seems that the amount of instructions
-	//generated could not fit in the icache very well, leading
-	//to worse than expected performance
-	//R.I.P.
+	//The first attempt at using a constexpr matrix size
+	//unrolled everything, and the code did not fit in the
+	//icache. The kernels in Matrix_fixed.h only unroll one
+	//cache line of tiles, with CONSTEXPR_N matTransposeFinal
+	//sends the sizes they exist for to them
 #endif // CONSTEXPR_N
 
 
 ////////////////////////////////////////////////////////////
 
 
-#define USE_CONSTANT
+//Smallest size of the default sweep
+static constexpr uint32_t MIN_N = 16;
+
+/// <summary>
+/// Options of the benchmark run, see PrintUsage
+/// </summary>
+struct BenchArgs {
+	std::vector<uint32_t> sizes;
+	std::vector<uint32_t> threads;
+	uint32_t reps;
+	std::string output;
+	std::string command_line;
+	bool help;
+};
+
+static void PrintUsage(const char* name) {
+	std::cerr << "Usage: " << name << " [MAX_N MAX_NUM_THREADS] [options]\n"
+		<< "  --filter <regex>        only run the benchmarks whose name matches\n"
+		<< "  --sizes <list>          matrix sizes (default " << MIN_N << ":" << CONST_N << ")\n"
+		<< "  --threads <list>        thread counts of the parallel versions (default 2:" << MAX_THREADS << ")\n"
+		<< "  --reps <n>              minimum samples per benchmark (default 10)\n"
+		<< "  --warmup <n>            untimed runs before the samples\n"
+		<< "  --time-ms <ms>          time budget of one measurement\n"
+		<< "  --target-error <pct>    stop sampling when the 95% CI is within pct% of the mean\n"
+		<< "  --no-counters           do not open the performance counters\n"
+		<< "  --output <path>         results file (default bench.json)\n"
+		<< "  --help                  print this message\n"
+		<< "A list is made of numbers and ranges separated by commas, a range is\n"
+		<< "first:last (doubling), first:last:+step or first:last:xfactor,\n"
+		<< "e.g. --sizes 100,128:1024,3000:4000:+500\n"
+		<< "Also: --tune, --transpose-file and --transpose-mat, see README.md" << std::endl;
+}
+
+//Positive number, false if it is not one
+static bool ParsePositive(const char* str, double& value) {
+	char* end = nullptr;
+	value = std::strtod(str, &end);
+	return end != str && *end == '\0' && value > 0;
+}
+
+//Fills args and the benchmark settings. MAX_N and MAX_NUM_THREADS
+//are still accepted as the first two arguments, they give the
+//same sweep as before: 16 to MAX_N and 2 to MAX_NUM_THREADS doubling
+static bool ParseBenchArgs(int argc, char* argv[], BenchArgs& args) {
+	BenchSettings& settings = GetBenchSettings();
+
+	uint32_t max_n = CONST_N;
+	uint32_t max_threads = MAX_THREADS;
+	int arg = 1;
+
+	args.reps = 10;
+	args.output = "bench.json";
+	args.help = false;
+
+	for (int idx = 0; idx < argc; idx++)
+		args.command_line += (idx == 0 ? "" : " ") + std::string(argv[idx]);
+
+	if (argc > 2 && argv[1][0] != '-') {
+		if (!ParseUint32(argv[1], max_n) || !ParseUint32(argv[2], max_threads)) {
+			std::cerr << "Invalid MAX_N or MAX_NUM_THREADS" << std::endl;
+			return false;
+		}
+
+		arg = 3;
+	}
+
+	for (uint32_t N = MIN_N; N <= max_n; N <<= 1)
+		args.sizes.push_back(N);
+
+	for (uint32_t threads = 2; threads <= max_threads; threads <<= 1)
+		args.threads.push_back(threads);
+
+	for (; arg < argc; arg++) {
+		std::string option = argv[arg];
+
+		if (option == "--help") {
+			args.help = true;
+			continue;
+		}
+
+		if (option == "--no-counters") {
+			settings.counters = false;
+			continue;
+		}
+
+		//Every other option has a value
+		if (arg + 1 >= argc) {
+			std::cerr << "Missing value for " << option << std::endl;
+			return false;
+		}
+
+		const char* value = argv[++arg];
+		double number = 0;
+		uint32_t count = 0;
+
+		if (option == "--filter") {
+			try {
+				std::regex check(value);
+			}
+			catch (std::regex_error const&) {
+				std::cerr << "Invalid regex " << value << std::endl;
+				return false;
+			}
+
+			settings.filter = value;
+		}
+		else if (option == "--sizes" || option == "--threads") {
+			if (!ParseUint32List(value, option == "--sizes" ? args.sizes : args.threads)) {
+				std::cerr << "Invalid list " << value << std::endl;
+				return false;
+			}
+		}
+		else if (option == "--output") {
+			args.output = value;
+		}
+		else if (option == "--reps" || option == "--warmup") {
+			//Zero warmup runs still do one, see MeasureBenchmark
+			if (!ParseUint32(value, count) || (option == "--reps" && count == 0)) {
+				std::cerr << "Invalid " << option << " " << value << std::endl;
+				return false;
+			}
+
+			(option == "--reps" ? args.reps : settings.warmup) = count;
+		}
+		else if (option == "--time-ms" || option == "--target-error") {
+			if (!ParsePositive(value, number)) {
+				std::cerr << "Invalid " << option << " " << value << std::endl;
+				return false;
+			}
+
+			if (option == "--time-ms")
+				settings.max_ms = number;
+			else
+				settings.target_rel_error = number / 100;
+		}
+		else {
+			std::cerr << "Unknown option " << option << std::endl;
+			return false;
+		}
+	}
+
+	if (args.sizes.empty() || args.threads.empty()) {
+		std::cerr << "No sizes or threads to run" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////
+// ///////////////////////SELF CHECKS/////////////////////
+//Run once before the benchmarks, on the shapes and APIs
+//the N x N sweep does not cover. Each prints a
+//"not working" line like the benchmark checks
+
+//Written in the padding of the outputs and in the changed
+//element of the asymmetric matrices, never a random element
+static constexpr MatType CHECK_PAD = VALUE_MAX + 1;
+
+//Random element, like CreateRandomMatrix
+template <typename Elem>
+static Elem RandomElem() {
+	return Elem(rand() % int(VALUE_MAX));
+}
+
+//Complex elements get an imaginary part too
+template <>
+std::complex<float> RandomElem<std::complex<float>>() {
+	float real = float(rand() % int(VALUE_MAX));
+	return std::complex<float>(real, float(rand() % int(VALUE_MAX)));
+}
+
+template <typename Elem>
+static void FillRandom(Elem* M, size_t count) {
+	for (size_t idx = 0; idx < count; idx++)
+		M[idx] = RandomElem<Elem>();
+}
+
+//First 64 byte aligned element of elems, which has 64 spare
+//elements. With leading dimensions that are a multiple of 64
+//bytes every row is aligned and the aligned kernels are used
+template <typename Elem>
+static Elem* AlignedStart(std::vector<Elem>& elems) {
+	return reinterpret_cast<Elem*>((reinterpret_cast<uintptr_t>(elems.data()) + 63) / 64 * 64);
+}
+
+//Copies the upper triangle of the N x N matrix M into the lower one
+template <typename Elem>
+static void MakeSymmetric(Elem* M, uint32_t N, uint32_t ld) {
+	for (uint32_t row_idx = 0; row_idx < N; row_idx++) {
+		for (uint32_t col_idx = 0; col_idx < row_idx; col_idx++)
+			M[size_t(row_idx) * ld + col_idx] = M[size_t(col_idx) * ld + row_idx];
+	}
+}
+
+//True if T (cols x rows, leading dimension ldb) is the
+//transpose of M (rows x cols, leading dimension lda)
+//and the padding of T still holds pad
+template <typename Elem>
+static bool IsPaddedTranspose(Elem const* M, Elem const* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb, Elem pad) {
+	for (uint32_t col_idx = 0; col_idx < cols; col_idx++) {
+		for (uint32_t row_idx = 0; row_idx < ldb; row_idx++) {
+			Elem expected = row_idx < rows ? M[size_t(row_idx) * lda + col_idx] : pad;
+
+			if (!(T[size_t(col_idx) * ldb + row_idx] == expected))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+//One entry of the kernel tables of the self checks
+template <typename Elem>
+struct TransposeCheck {
+	const char* name;
+	void(*transpose)(Elem const* M, Elem* T, uint32_t rows, uint32_t cols, uint32_t lda, uint32_t ldb);
+};
+
+//Runs every kernel of the table on the same random rows x cols
+//matrix and prints the ones whose output is not its transpose
+//or wrote the padding. suffix follows the name in the message
+template <typename Elem, size_t COUNT>
+static void CheckTransposes(TransposeCheck<Elem> const (&kernels)[COUNT], const char* suffix,
+	uint32_t rows, uint32_t cols, uint32_t lda, uint32_t ldb) {
+	const Elem PAD = Elem(CHECK_PAD);
+
+	std::vector<Elem> M_elems(size_t(rows) * lda + 64), T_elems(size_t(cols) * ldb + 64);
+	Elem* M = AlignedStart(M_elems);
+	Elem* T = AlignedStart(T_elems);
+
+	FillRandom(M, size_t(rows) * lda);
+
+	for (TransposeCheck<Elem> const& kernel : kernels) {
+		std::fill(T, T + size_t(cols) * ldb, PAD);
+		kernel.transpose(M, T, rows, cols, lda, ldb);
+
+		if (!IsPaddedTranspose(M, T, rows, cols, lda, ldb, PAD))
+			std::cout << kernel.name << suffix << " " << rows << "x" << cols << " not working" << std::endl;
+	}
+}
+
+//One entry of the symmetry check tables, ld is the
+//leading dimension (N for the contiguous checks)
+template <typename Elem>
+struct SymCheck {
+	const char* name;
+	bool(*check)(Elem const* M, uint32_t N, uint32_t ld);
+};
+
+//Runs every check on a random symmetric N x N matrix and
+//on the same matrix with one element changed
+template <typename Elem, size_t COUNT>
+static void CheckSymmetryChecks(SymCheck<Elem> const (&checks)[COUNT], const char* suffix,
+	uint32_t N, uint32_t ld) {
+	std::vector<Elem> elems(size_t(N) * ld + 64);
+	Elem* M = AlignedStart(elems);
+
+	FillRandom(M, size_t(N) * ld);
+	MakeSymmetric(M, N, ld);
+
+	Elem& changed = M[size_t(N - 2) * ld + 1];
+
+	for (SymCheck<Elem> const& check : checks) {
+		bool symm_ok = check.check(M, N, ld);
+
+		changed = Elem(CHECK_PAD);
+		bool asymm_ok = !check.check(M, N, ld);
+		changed = M[size_t(1) * ld + N - 2];
+
+		if (!symm_ok || !asymm_ok)
+			std::cout << check.name << suffix << " not working" << std::endl;
+	}
+}
+
+//matTransposeKernel with the rectangular signature
+template <TransposeKernel KERNEL>
+static void KernelTranspose(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	matTransposeKernel(KERNEL, M, T, rows, cols, lda, ldb, 2);
+}
+
+//Every rectangular transpose and every kernel
+//matTransposeFinal can pick, on tall, wide and
+//odd shapes with padded rows, and on aligned rows
+static void SelfCheckRectangular() {
+	const TransposeCheck<MatType> KERNELS[] = {
+		{ "matTranspose", matTranspose },
+		{ "matTransposeImp", matTransposeImp },
+		{ "matTransposeOMP", matTransposeOMP },
+		{ "matTransposeCacheOblivious", matTransposeCacheOblivious },
+		{ "matTransposeCacheObliviousOMP", matTransposeCacheObliviousOMP },
+		{ "matTransposeFinal", matTransposeFinal },
+		{ "matTransposeStream", matTransposeStream },
+		{ "matTransposeStreamOMP", matTransposeStreamOMP },
+		{ "matTransposeHier", matTransposeHier },
+		{ "matTransposeHierOMP", matTransposeHierOMP },
+		{ "matTransposePool", matTransposePool },
+		{ "matTransposeKernel(Imp)", KernelTranspose<TransposeKernel::Imp> },
+		{ "matTransposeKernel(Oblivious)", KernelTranspose<TransposeKernel::Oblivious> },
+		{ "matTransposeKernel(OMP)", KernelTranspose<TransposeKernel::OMP> },
+		{ "matTransposeKernel(ObliviousOMP)", KernelTranspose<TransposeKernel::ObliviousOMP> },
+		{ "matTransposeKernel(StreamOMP)", KernelTranspose<TransposeKernel::StreamOMP> },
+		{ "matTransposeKernel(Hier)", KernelTranspose<TransposeKernel::Hier> },
+		{ "matTransposeKernel(HierOMP)", KernelTranspose<TransposeKernel::HierOMP> },
+		{ "matTransposeKernel(Pool)", KernelTranspose<TransposeKernel::Pool> }
+	};
+
+	const uint32_t SHAPES[][4] = { { 300, 21, 26, 303 }, { 19, 257, 262, 22 }, { 133, 70, 75, 136 }, { 100, 64, 80, 112 } };
+
+	for (auto const& shape : SHAPES)
+		CheckTransposes(KERNELS, "", shape[0], shape[1], shape[2], shape[3]);
+}
+
+//The typed transposes on square, padded and aligned shapes,
+//the typed checks on a symmetric matrix and on a copy with
+//one element changed
+template <typename Elem>
+static void SelfCheckTyped(const char* type_name) {
+	const TransposeCheck<Elem> KERNELS[] = {
+		{ "matTranspose", matTranspose<Elem> },
+		{ "matTransposeImp", matTransposeImp<Elem> },
+		{ "matTransposeOMP", matTransposeOMP<Elem> },
+		{ "matTransposeCacheOblivious", matTransposeCacheOblivious<Elem> },
+		{ "matTransposeCacheObliviousOMP", matTransposeCacheObliviousOMP<Elem> },
+		{ "matTransposeFinal", matTransposeFinal<Elem> }
+	};
+
+	const SymCheck<Elem> CHECKS[] = {
+		{ "checkSym", [](Elem const* M, uint32_t N, uint32_t) { return checkSym(M, N); } },
+		{ "checkSymImp", [](Elem const* M, uint32_t N, uint32_t) { return checkSymImp(M, N); } },
+		{ "checkSymOMP", [](Elem const* M, uint32_t N, uint32_t) { return checkSymOMP(M, N); } }
+	};
+
+	const uint32_t SHAPES[][4] = { { 72, 72, 72, 72 }, { 45, 130, 133, 47 }, { 64, 96, 128, 64 } };
+
+	for (auto const& shape : SHAPES)
+		CheckTransposes(KERNELS, type_name, shape[0], shape[1], shape[2], shape[3]);
+
+	CheckSymmetryChecks(CHECKS, type_name, 70, 70);
+}
+
+using SymSkewFunc = void(*)(MatType const* M, MatType* S, MatType* K, uint32_t N);
+using SymmetrizeFunc = void(*)(MatType* M, uint32_t N);
+
+//Symmetric and skew parts and the in place symmetrize,
+//on sizes with and without edge strips, against
+//(M + M^T) / 2 and (M - M^T) / 2 computed here
+static void SelfCheckSymmetrize() {
+	const SymSkewFunc SYM_SKEW[] = { matSymSkew, matSymSkewOMP };
+	const SymmetrizeFunc IN_PLACE[] = { matSymmetrizeInPlace, matSymmetrizeInPlaceOMP };
+	const char* SYM_SKEW_NAMES[] = { "matSymSkew", "matSymSkewOMP" };
+	const char* IN_PLACE_NAMES[] = { "matSymmetrizeInPlace", "matSymmetrizeInPlaceOMP" };
+
+	for (uint32_t N : { 37u, 64u, 130u }) {
+		std::vector<MatType> M(size_t(N) * N);
+		std::vector<MatType> sym(M.size()), skew(M.size());
+
+		FillRandom(M.data(), M.size());
+
+		for (uint32_t row_idx = 0; row_idx < N; row_idx++) {
+			for (uint32_t col_idx = 0; col_idx < N; col_idx++) {
+				MatType value = M[size_t(row_idx) * N + col_idx];
+				MatType mirror = M[size_t(col_idx) * N + row_idx];
+
+				sym[size_t(row_idx) * N + col_idx] = (value + mirror) / 2;
+				skew[size_t(row_idx) * N + col_idx] = (value - mirror) / 2;
+			}
+		}
+
+		for (uint32_t idx = 0; idx < 2; idx++) {
+			std::vector<MatType> S(M.size()), K(M.size());
+			SYM_SKEW[idx](M.data(), S.data(), K.data(), N);
+
+			bool sym_skew_ok = !IsSameMatrix(sym.data(), S.data(), N) && !IsSameMatrix(skew.data(), K.data(), N);
+
+			//Only one of the parts
+			std::fill(S.begin(), S.end(), MatType(0));
+			std::fill(K.begin(), K.end(), MatType(0));
+			SYM_SKEW[idx](M.data(), S.data(), nullptr, N);
+			SYM_SKEW[idx](M.data(), nullptr, K.data(), N);
+
+			sym_skew_ok = sym_skew_ok && !IsSameMatrix(sym.data(), S.data(), N) && !IsSameMatrix(skew.data(), K.data(), N);
+
+			if (!sym_skew_ok)
+				std::cout << SYM_SKEW_NAMES[idx] << " " << N << " not working" << std::endl;
+
+			std::vector<MatType> in_place = M;
+			IN_PLACE[idx](in_place.data(), N);
+
+			if (IsSameMatrix(sym.data(), in_place.data(), N))
+				std::cout << IN_PLACE_NAMES[idx] << " " << N << " not working" << std::endl;
+		}
+	}
+}
+
+//MatrixView transposes and checks with the signatures of the tables
+
+template <void(*KERNEL)(MatrixView<MatType const, true>, MatrixView<MatType, true>)>
+static void AlignedViewTranspose(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	KERNEL(MatrixView<MatType const, true>(M, rows, cols, lda), MatrixView<MatType, true>(T, cols, rows, ldb));
+}
+
+template <void(*KERNEL)(MatrixView<MatType const>, MatrixView<MatType>)>
+static void ViewTranspose(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb) {
+	KERNEL(MatrixView<MatType const>(M, rows, cols, lda), MatrixView<MatType>(T, cols, rows, ldb));
+}
+
+template <bool(*CHECK)(MatrixView<MatType const>)>
+static bool ViewCheckSym(MatType const* M, uint32_t N, uint32_t ld) {
+	return CHECK(MatrixView<MatType const>(M, N, N, ld));
+}
+
+//The MatrixView overloads: the aligned ones on rows aligned
+//to VIEW_ALIGNMENT, the others on padded unaligned rows too
+static void SelfCheckViews() {
+	const TransposeCheck<MatType> ALIGNED[] = {
+		{ "matTransposeImp", AlignedViewTranspose<matTransposeImp> },
+		{ "matTransposeOMP", AlignedViewTranspose<matTransposeOMP> },
+		{ "matTransposeCacheOblivious", AlignedViewTranspose<matTransposeCacheOblivious> },
+		{ "matTransposeCacheObliviousOMP", AlignedViewTranspose<matTransposeCacheObliviousOMP> },
+		{ "matTransposeHier", AlignedViewTranspose<matTransposeHier> },
+		{ "matTransposeHierOMP", AlignedViewTranspose<matTransposeHierOMP> }
+	};
+
+	const TransposeCheck<MatType> UNALIGNED[] = {
+		{ "matTranspose", ViewTranspose<matTranspose> },
+		{ "matTransposeImp", ViewTranspose<matTransposeImp> },
+		{ "matTransposeOMP", ViewTranspose<matTransposeOMP> },
+		{ "matTransposeCacheOblivious", ViewTranspose<matTransposeCacheOblivious> },
+		{ "matTransposeCacheObliviousOMP", ViewTranspose<matTransposeCacheObliviousOMP> },
+		{ "matTransposeHier", ViewTranspose<matTransposeHier> },
+		{ "matTransposeHierOMP", ViewTranspose<matTransposeHierOMP> },
+		{ "matTransposeFinal", ViewTranspose<matTransposeFinal> }
+	};
+
+	const SymCheck<MatType> CHECKS[] = {
+		{ "checkSymFast", ViewCheckSym<checkSymFast> },
+		{ "checkSymFastOMP", ViewCheckSym<checkSymFastOMP> },
+		{ "checkSymSIMD", ViewCheckSym<checkSymSIMD> },
+		{ "checkSymSIMD_OMP", ViewCheckSym<checkSymSIMD_OMP> }
+	};
+
+	CheckTransposes(ALIGNED, " (aligned views)", 90, 53, 64, 96);
+	CheckTransposes(UNALIGNED, " (views)", 90, 53, 64, 96);
+	CheckTransposes(UNALIGNED, " (views)", 60, 41, 67, 63);
+	CheckSymmetryChecks(CHECKS, " (views)", 45, 51);
+}
+
+//Fixed size kernels and matTransposeImp sizes mixed in one batch,
+//every other matrix symmetric. Compared to matTranspose and
+//checkSym one matrix at a time
+static void SelfCheckBatched() {
+	const std::vector<uint32_t> SIZES = { 4, 8, 16, 20, 33, 64, 100, 256, 7, 32 };
+	const uint32_t COUNT = uint32_t(SIZES.size());
+
+	std::vector<std::vector<MatType>> in, out;
+	std::vector<MatType const*> in_ptrs;
+	std::vector<MatType*> out_ptrs;
+
+	for (uint32_t idx = 0; idx < COUNT; idx++) {
+		in.push_back(std::vector<MatType>(size_t(SIZES[idx]) * SIZES[idx]));
+		out.push_back(std::vector<MatType>(in.back().size()));
+
+		FillRandom(in.back().data(), in.back().size());
+
+		if (idx % 2 == 0)
+			MakeSymmetric(in.back().data(), SIZES[idx], SIZES[idx]);
+	}
+
+	for (uint32_t idx = 0; idx < COUNT; idx++) {
+		in_ptrs.push_back(in[idx].data());
+		out_ptrs.push_back(out[idx].data());
+	}
+
+	matTransposeBatched(in_ptrs.data(), out_ptrs.data(), SIZES.data(), COUNT);
+
+	std::unique_ptr<bool[]> results(new bool[COUNT]);
+	bool all_symm = checkSymBatched(in_ptrs.data(), SIZES.data(), COUNT, results.get());
+	bool batched_ok = true, check_ok = !all_symm && !checkSymBatched(in_ptrs.data(), SIZES.data(), COUNT);
+
+	for (uint32_t idx = 0; idx < COUNT; idx++) {
+		std::vector<MatType> T(in[idx].size());
+		matTranspose(in[idx].data(), T.data(), SIZES[idx]);
+
+		batched_ok = batched_ok && !IsSameMatrix(T.data(), out[idx].data(), SIZES[idx]);
+		check_ok = check_ok && results[idx] == checkSym(in[idx].data(), SIZES[idx]);
+	}
+
+	if (!batched_ok)
+		std::cout << "matTransposeBatched not working" << std::endl;
+
+	if (!check_ok)
+		std::cout << "checkSymBatched not working" << std::endl;
+
+	//Strided batch of 16 x 16 matrices with a gap
+	//between the inputs, the outputs contiguous
+	const uint32_t N = 16, STRIDED_COUNT = 5;
+	const size_t STRIDE = size_t(N) * N + 4;
+
+	std::vector<MatType> strided(STRIDE * STRIDED_COUNT);
+	std::vector<MatType> strided_out(size_t(N) * N * STRIDED_COUNT);
+
+	FillRandom(strided.data(), strided.size());
+
+	for (uint32_t idx = 0; idx < STRIDED_COUNT; idx += 2)
+		MakeSymmetric(strided.data() + idx * STRIDE, N, N);
+
+	matTransposeBatchedStrided(strided.data(), strided_out.data(), N, STRIDED_COUNT, STRIDE);
+
+	bool strided_results[STRIDED_COUNT];
+	all_symm = checkSymBatchedStrided(strided.data(), N, STRIDED_COUNT, STRIDE, strided_results);
+	batched_ok = true;
+	check_ok = !all_symm && !checkSymBatchedStrided(strided.data(), N, STRIDED_COUNT, STRIDE);
+
+	for (uint32_t idx = 0; idx < STRIDED_COUNT; idx++) {
+		MatType T[N * N];
+		matTranspose(strided.data() + idx * STRIDE, T, N);
+
+		batched_ok = batched_ok && !IsSameMatrix(T, strided_out.data() + size_t(idx) * N * N, N);
+		check_ok = check_ok && strided_results[idx] == checkSym(strided.data() + idx * STRIDE, N);
+	}
+
+	if (!batched_ok)
+		std::cout << "matTransposeBatchedStrided not working" << std::endl;
+
+	if (!check_ok)
+		std::cout << "checkSymBatchedStrided not working" << std::endl;
+}
+
+//A written file maps back to the same matrix. A header whose
+//payload_offset + payload_bytes wraps around 2^64 is rejected,
+//the checksum is not read so only the header check can stop it
+static void SelfCheckMatrixFile() {
+	const char* PATH = "self_check.pmat";
+	const uint32_t ROWS = 37, COLS = 21;
+
+	Matrix<MatType> M(ROWS, COLS);
+
+	for (uint32_t row_idx = 0; row_idx < ROWS; row_idx++)
+		FillRandom(M.Data() + size_t(row_idx) * M.LeadingDim(), COLS);
+
+	bool written = WriteMatrixFile(PATH, M);
+	bool read_ok = false, rejected = false;
+
+	if (written) {
+		MappedMatrixFile file(PATH);
+		MatrixView<MatType const, true> view = file.View();
+
+		read_ok = file.IsValid() && view.Rows() == ROWS && view.Cols() == COLS;
+
+		for (uint32_t row_idx = 0; read_ok && row_idx < ROWS; row_idx++)
+			read_ok = std::equal(view.Row(row_idx), view.Row(row_idx) + COLS, M.Data() + size_t(row_idx) * M.LeadingDim());
+	}
+
+	if (written) {
+		MatrixFileHeader header;
+
+		std::fstream file(PATH, std::ios::in | std::ios::out | std::ios::binary);
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+		//Still a multiple of 64, the sum wraps to a small offset
+		header.payload_offset = UINT64_MAX / 64 * 64;
+
+		file.seekp(0);
+		file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+		file.close();
+
+		rejected = !MappedMatrixFile(PATH, false).IsValid();
+	}
+
+	std::remove(PATH);
+
+	if (!read_ok)
+		std::cout << "WriteMatrixFile/MappedMatrixFile not working" << std::endl;
+
+	if (!rejected)
+		std::cout << "MappedMatrixFile header check not working" << std::endl;
+}
+
+////////////////////////////////////////////////////////////
 
 int main(int argc, char* argv[])
 {
 	uint32_t MAX_N = CONST_N;
-	uint32_t N = 16;
-	uint32_t N_THREADS = MAX_THREADS;
 
-#ifndef USE_CONSTANT
-	if (argc < 3) {
-		std::cerr << "Missing arguments\n";
-		std::cerr << "Usage: " << argv[0] << " <MAX_N> <MAX_NUM_THREADS>" << std::endl;
-		std::cin.get();
-		std::exit(0);
+	//Autotuning mode: ParcoDeliverable1 --tune [profile path]
+	//Writes the profile that matTransposeFinal loads at startup
+	if (argc > 1 && std::strcmp(argv[1], "--tune") == 0) {
+		const char* path = argc > 2 ? argv[2] : DEFAULT_TUNING_PROFILE;
+
+		InitRand();
+
+		TuningProfile profile = AutotuneTranspose(MAX_N, uint32_t(omp_get_num_procs()), std::cout);
+
+		if (!SaveTuningProfile(path, profile)) {
+			std::cerr << "Could not write " << path << std::endl;
+			return 1;
+		}
+
+		std::cout << "Tuning profile written to " << path << std::endl;
+		return 0;
+	}
+
+	//Out of core mode: ParcoDeliverable1 --transpose-file <in> <out> <rows> <cols> [max MB]
+	//Transposes a raw row major file of floats that may not fit in memory
+	if (argc > 1 && std::strcmp(argv[1], "--transpose-file") == 0) {
+		if (argc < 6) {
+			std::cerr << "Usage: " << argv[0] << " --transpose-file <in> <out> <rows> <cols> [max MB]" << std::endl;
+			return 1;
+		}
+
+		OutOfCoreOptions options = DefaultOutOfCoreOptions();
+		uint32_t rows = 0, cols = 0, max_mb = 0;
+
+		if (!ParseUint32(argv[4], rows) || !ParseUint32(argv[5], cols)) {
+			std::cerr << "Invalid rows or cols" << std::endl;
+			return 1;
+		}
+
+		if (argc > 6) {
+			if (!ParseUint32(argv[6], max_mb)) {
+				std::cerr << "Invalid max MB " << argv[6] << std::endl;
+				return 1;
+			}
+
+			options.max_buffer_bytes = uint64_t(max_mb) << 20;
+		}
+
+		if (!matTransposeFile(argv[2], argv[3], rows, cols, options)) {
+			std::cerr << "Could not transpose " << argv[2] << " into " << argv[3] << std::endl;
+			return 1;
+		}
+
+		return 0;
+	}
+
+	//Matrix file mode: ParcoDeliverable1 --transpose-mat <in.pmat> [out.pmat]
+	//Checks the symmetry of a matrix file and writes its transpose
+	if (argc > 1 && std::strcmp(argv[1], "--transpose-mat") == 0) {
+		if (argc < 3) {
+			std::cerr << "Usage: " << argv[0] << " --transpose-mat <in.pmat> [out.pmat]" << std::endl;
+			return 1;
+		}
+
+		//Row and column major payloads are used in place,
+		//tiled ones have to be copied first
+		MappedMatrixFile file(argv[2]);
+		Matrix<MatType> loaded;
+
+		if (!file.IsValid() || (file.Layout() == MatrixLayout::Tiled && !LoadMatrixFile(argv[2], loaded))) {
+			std::cerr << "Invalid matrix file " << argv[2] << std::endl;
+			return 1;
+		}
+
+		MatrixView<MatType const> M = file.Layout() == MatrixLayout::Tiled
+			? MatrixView<MatType const>(loaded.View()) : MatrixView<MatType const>(file.View());
+
+		std::cout << file.Header().rows << "x" << file.Header().cols << (checkSymFastOMP(M) ? " symmetric" : " not symmetric") << std::endl;
+
+		//A column major payload already holds the transpose
+		if (argc > 3) {
+			bool written = file.Layout() == MatrixLayout::ColMajor ? WriteMatrixFile(argv[3], M)
+				: WriteTransposedMatrixFile(argv[3], M);
+
+			if (!written) {
+				std::cerr << "Could not write " << argv[3] << std::endl;
+				return 1;
+			}
+		}
+
+		return 0;
+	}
+
+	BenchArgs args;
+
+	if (!ParseBenchArgs(argc, argv, args)) {
+		PrintUsage(argv[0]);
+		return 1;
 	}
 
-	N = TryParseUint32(argv[1], "Invalid MAX_N");
-	N_THREADS = TryParseUint32(argv[2], "Invalid MAX_NUM_THREADS");
-	
-#endif // !USE_CONSTANT
+	if (args.help) {
+		PrintUsage(argv[0]);
+		return 0;
+	}
+
+	const std::vector<uint32_t>& SIZES = args.sizes;
+	const std::vector<uint32_t>& THREADS = args.threads;
+	const uint32_t MAX_THREADS_USED = THREADS.back();
+	const uint32_t REPS = args.reps;
+
+	//Next entry of the thread list, past the
+	//last one the sweep of BenchmarkThreads ends
+	auto next_threads = [&](uint32_t, uint32_t cycle) -> uint32_t {
+		return cycle + 1 < THREADS.size() ? THREADS[cycle + 1] : UINT32_MAX;
+	};
 
 	InitRand();
 
@@ -71,33 +761,73 @@ int main(int argc, char* argv[])
 		std::cout << "Nested OMP threads not available" << std::endl;
 	}
 
-	std::ofstream out("bench.txt", std::ios::out);
+	//Started once, before the benchmarks, with enough
+	//workers for the largest thread count
+	GetDefaultThreadPool(MAX_THREADS_USED);
+
+	//Ceiling the bandwidth of every benchmark is compared to
+	std::cout << "STREAM copy: " << StreamCopyBandwidth() << " GB/s" << std::endl;
+
+	if (!PerfCountersAvailable())
+		std::cout << "Performance counters not available" << std::endl;
 
-	out << MAX_N << std::endl;
-	out << N_THREADS << std::endl;
+	SelfCheckRectangular();
+	SelfCheckTyped<double>("<double>");
+	SelfCheckTyped<int16_t>("<int16_t>");
+	SelfCheckTyped<int8_t>("<int8_t>");
+	SelfCheckTyped<uint8_t>("<uint8_t>");
+	SelfCheckTyped<std::complex<float>>("<complex<float>>");
+	SelfCheckSymmetrize();
+	SelfCheckViews();
+	SelfCheckBatched();
+	SelfCheckMatrixFile();
 
-	while (N <= MAX_N) {
-		out << N << std::endl;
+	BenchReport out;
 
-		auto the_matrix = CreateRandomMatrix(N, N_THREADS);
+	out.AddMetadata("command_line", args.command_line);
+	out.AddMetadata("max_n", SIZES.back());
+	out.AddMetadata("max_threads", MAX_THREADS_USED);
+	out.AddMetadata("stream_copy_gb_per_s", StreamCopyBandwidth());
 
-		MatType* T = new MatType[N * N]{};
-		MatType* T2 = new MatType[N * N]{};
-		MatType* T3 = new MatType[N * N]{};
-		MatType* T4 = new MatType[N * N]{};
-		MatType* T5 = new MatType[N * N]{};
-		MatType* T6 = new MatType[N * N]{};
+	for (uint32_t N : SIZES) {
+		out.SetSize(N);
+
+		//Released at the end of the iteration. The rows
+		//are not padded, so the N x N versions work for
+		//any N
+		DenseMatrix the_matrix = CreateRandomMatrix(N, MAX_THREADS_USED);
+
+		DenseMatrix T = AllocateDenseMatrix(N, MAX_THREADS_USED);
+		DenseMatrix T2 = AllocateDenseMatrix(N, MAX_THREADS_USED);
+		DenseMatrix T3 = AllocateDenseMatrix(N, MAX_THREADS_USED);
+		DenseMatrix T4 = AllocateDenseMatrix(N, MAX_THREADS_USED);
+		DenseMatrix T5 = AllocateDenseMatrix(N, MAX_THREADS_USED);
+		DenseMatrix T6 = AllocateDenseMatrix(N, MAX_THREADS_USED);
+		DenseMatrix T7 = AllocateDenseMatrix(N, MAX_THREADS_USED);
+		DenseMatrix T8 = AllocateDenseMatrix(N, MAX_THREADS_USED);
+
+		if (!the_matrix || !T || !T2 || !T3 || !T4 || !T5 || !T6 || !T7 || !T8) {
+			std::cerr << "Cannot allocate the matrices for N = " << N << std::endl;
+			return 1;
+		}
 
-		const auto NUM_BYTES = uint64_t(N) * N * 4;
+		const auto NUM_BYTES = uint64_t(N) * N * sizeof(MatType);
 
 		std::cout << "Testing for " << N << " rows and columns\n";
-		std::cout << "Which means " << (N * N) << " elements\n";
+		std::cout << "Which means " << (uint64_t(N) * N) << " elements\n";
 		std::cout << "For a total " << NUM_BYTES / 1.024e9 << " GB" << std::endl;
 
+		//References for the checks, computed by the base
+		//versions also when their benchmark is filtered out
+		bool is_symm = checkSym(the_matrix.get(), N);
+		matTranspose(the_matrix.get(), T.get(), N);
+
 		/////////////////////////////////
 
-		bool is_symm = Benchmark([=]() { return checkSym(the_matrix, N); },
-			"Base symm check", 1, out);
+		if (BenchSelected("Base symm check")) {
+			Benchmark([&]() { return checkSym(the_matrix.get(), N); },
+				"Base symm check", 1, out, NUM_BYTES);
+		}
 
 		if (is_symm) {
 			std::cout << "Matrix is symmetric" << std::endl;
@@ -107,70 +837,224 @@ int main(int argc, char* argv[])
 		}
 
 		/////////////////////////////////
-		bool is_symm_imp = Benchmark([=]() { return checkSymImp(the_matrix, N); }, "checkSymImp", 10, 
-			out);
+		if (BenchSelected("checkSymImp")) {
+			bool is_symm_imp = Benchmark([&]() { return checkSymImp(the_matrix.get(), N); }, "checkSymImp", REPS,
+				out, NUM_BYTES);
 
-		if (is_symm != is_symm_imp) {
-			std::cout << "checkSymImp not working" << std::endl;
+			if (is_symm != is_symm_imp) {
+				std::cout << "checkSymImp not working" << std::endl;
+			}
 		}
 
 		/////////////////////////////////
-		bool is_symm_omp = BenchmarkThreads([=]() { return checkSymOMP(the_matrix, N); }, "checkSymOMP", 10,
-			[](uint32_t current, uint32_t) { return current << 1; }, 2, N_THREADS, out);
+		if (BenchSelected("checkSymOMP")) {
+			bool is_symm_omp = BenchmarkThreads([&]() { return checkSymOMP(the_matrix.get(), N); }, "checkSymOMP", REPS,
+				next_threads, THREADS.front(), MAX_THREADS_USED, out, NUM_BYTES);
 
-		if (is_symm != is_symm_omp) {
-			std::cout << "checkSymOMP not working" << std::endl;
+			if (is_symm != is_symm_omp) {
+				std::cout << "checkSymOMP not working" << std::endl;
+			}
 		}
 
 		//////////////////////////////////
 
-		Benchmark([=]() -> void {matTranspose(the_matrix, T, N); }, "Base transpose", 1, out);
+		if (BenchSelected("Base transpose"))
+			Benchmark([&]() -> void {matTranspose(the_matrix.get(), T.get(), N); }, "Base transpose", 1, out, 2 * NUM_BYTES);
 
 		/////////////////////////////////
-		Benchmark([=]() { matTransposeImp(the_matrix, T2, N); }, "Imp transpose", 10, out);
-		if (IsSameMatrix(T, T2, N))
-			std::cout << "Improved transpose not working" << std::endl;
+		if (BenchSelected("Imp transpose")) {
+			Benchmark([&]() { matTransposeImp(the_matrix.get(), T2.get(), N); }, "Imp transpose", REPS, out, 2 * NUM_BYTES);
+			if (IsSameMatrix(T.get(), T2.get(), N))
+				std::cout << "Improved transpose not working" << std::endl;
+		}
 
 		////////////////////////////////
-		BenchmarkThreads([=]() { matTransposeOMP(the_matrix, T3, N); }, "OMP transpose", 10,
-			[](uint32_t curr, uint32_t) { return curr << 1; }, 2, N_THREADS, out);
-		if (IsSameMatrix(T, T3, N))
-			std::cout << "OMP transpose not working" << std::endl;
+		if (BenchSelected("OMP transpose")) {
+			BenchmarkThreads([&]() { matTransposeOMP(the_matrix.get(), T3.get(), N); }, "OMP transpose", REPS,
+				next_threads, THREADS.front(), MAX_THREADS_USED, out, 2 * NUM_BYTES);
+			if (IsSameMatrix(T.get(), T3.get(), N))
+				std::cout << "OMP transpose not working" << std::endl;
+		}
 
 		////////////////////////////////
-		Benchmark([=]() { matTransposeCacheOblivious(the_matrix, T4, N); }, "Oblivious transpose", 10,
-		 out);
-		if (IsSameMatrix(T, T4, N))
-			std::cout << "Oblivious transpose not working" << std::endl;
+		if (BenchSelected("Oblivious transpose")) {
+			Benchmark([&]() { matTransposeCacheOblivious(the_matrix.get(), T4.get(), N); }, "Oblivious transpose", REPS,
+				out, 2 * NUM_BYTES);
+			if (IsSameMatrix(T.get(), T4.get(), N))
+				std::cout << "Oblivious transpose not working" << std::endl;
+		}
 
 		////////////////////////////////
-		BenchmarkThreads([=]() { matTransposeCacheObliviousOMP(the_matrix, T5, N); }, "Oblivious OMP transpose", 10,
-			[](uint32_t curr, uint32_t) { return curr << 1; }, 2, N_THREADS, out);
-		if (IsSameMatrix(T, T5, N))
-			std::cout << "Oblivious transpose not working" << std::endl;
+		if (BenchSelected("Oblivious OMP transpose")) {
+			BenchmarkThreads([&]() { matTransposeCacheObliviousOMP(the_matrix.get(), T5.get(), N); }, "Oblivious OMP transpose", REPS,
+				next_threads, THREADS.front(), MAX_THREADS_USED, out, 2 * NUM_BYTES);
+			if (IsSameMatrix(T.get(), T5.get(), N))
+				std::cout << "Oblivious transpose not working" << std::endl;
+		}
 
 		////////////////////////////////
 
-		BenchmarkThreads([=]() { matTransposeFinal(the_matrix, T6, N); }, "Final transpose", 10,
-			[](uint32_t curr, uint32_t) { return curr << 1; }, 2, N_THREADS, out);
-		if (IsSameMatrix(T, T6, N))
-			std::cout << "Final transpose not working" << std::endl;
+		if (BenchSelected("Final transpose")) {
+			BenchmarkThreads([&]() { matTransposeFinal(the_matrix.get(), T6.get(), N); }, "Final transpose", REPS,
+				next_threads, THREADS.front(), MAX_THREADS_USED, out, 2 * NUM_BYTES);
+			if (IsSameMatrix(T.get(), T6.get(), N))
+				std::cout << "Final transpose not working" << std::endl;
+		}
 
 		////////////////////////////////
+		if (BenchSelected("Streaming OMP transpose")) {
+			BenchmarkThreads([&]() { matTransposeStreamOMP(the_matrix.get(), T8.get(), N); }, "Streaming OMP transpose", REPS,
+				next_threads, THREADS.front(), MAX_THREADS_USED, out, 2 * NUM_BYTES);
+			if (IsSameMatrix(T.get(), T8.get(), N))
+				std::cout << "Streaming OMP transpose not working" << std::endl;
+		}
+
+		////////////////////////////////
+		//Two level tiles, T6 and T8 are checked already
+		if (BenchSelected("Hier transpose")) {
+			Benchmark([&]() { matTransposeHier(the_matrix.get(), T6.get(), N); }, "Hier transpose", REPS,
+				out, 2 * NUM_BYTES);
+			if (IsSameMatrix(T.get(), T6.get(), N))
+				std::cout << "Hier transpose not working" << std::endl;
+		}
+
+		////////////////////////////////
+		if (BenchSelected("Hier OMP transpose")) {
+			BenchmarkThreads([&]() { matTransposeHierOMP(the_matrix.get(), T8.get(), N); }, "Hier OMP transpose", REPS,
+				next_threads, THREADS.front(), MAX_THREADS_USED, out, 2 * NUM_BYTES);
+			if (IsSameMatrix(T.get(), T8.get(), N))
+				std::cout << "Hier OMP transpose not working" << std::endl;
+		}
+
+		////////////////////////////////
+		//Same threads every call, no parallel region
+		if (BenchSelected("Pool transpose")) {
+			BenchmarkThreads([&]() { matTransposePool(the_matrix.get(), T6.get(), N); }, "Pool transpose", REPS,
+				next_threads, THREADS.front(), MAX_THREADS_USED, out, 2 * NUM_BYTES);
+			if (IsSameMatrix(T.get(), T6.get(), N))
+				std::cout << "Pool transpose not working" << std::endl;
+		}
+
+		////////////////////////////////
+		//In place transposes modify their input, so each
+		//benchmark works on a copy and, since repeated calls
+		//swap the matrix back and forth, correctness is
+		//verified with a single call on a fresh copy
+
+		if (BenchSelected("Imp in place transpose")) {
+			std::memcpy(T7.get(), the_matrix.get(), NUM_BYTES);
+			Benchmark([&]() { matTransposeInPlaceImp(T7.get(), N); }, "Imp in place transpose", REPS, out, 2 * NUM_BYTES);
+			std::memcpy(T7.get(), the_matrix.get(), NUM_BYTES);
+			matTransposeInPlaceImp(T7.get(), N);
+			if (IsSameMatrix(T.get(), T7.get(), N))
+				std::cout << "Imp in place transpose not working" << std::endl;
+		}
+
+		////////////////////////////////
+		if (BenchSelected("OMP in place transpose")) {
+			std::memcpy(T7.get(), the_matrix.get(), NUM_BYTES);
+			BenchmarkThreads([&]() { matTransposeInPlaceOMP(T7.get(), N); }, "OMP in place transpose", REPS,
+				next_threads, THREADS.front(), MAX_THREADS_USED, out, 2 * NUM_BYTES);
+			std::memcpy(T7.get(), the_matrix.get(), NUM_BYTES);
+			matTransposeInPlaceOMP(T7.get(), N);
+			if (IsSameMatrix(T.get(), T7.get(), N))
+				std::cout << "OMP in place transpose not working" << std::endl;
+		}
 
-		delete[] the_matrix;
-		delete[] T;
-		delete[] T2;
-		delete[] T3;
-		delete[] T4;
-		delete[] T5;
-		delete[] T6;
+		////////////////////////////////
+		//Early exit checks, on a random matrix these
+		//return after the first few tiles, so the bytes
+		//they read are unknown
+		if (BenchSelected("checkSymFast")) {
+			bool is_symm_fast = Benchmark([&]() { return checkSymFast(the_matrix.get(), N); }, "checkSymFast", REPS,
+				out);
+
+			if (is_symm != is_symm_fast) {
+				std::cout << "checkSymFast not working" << std::endl;
+			}
+		}
+
+		////////////////////////////////
+		if (BenchSelected("checkSymFastOMP")) {
+			bool is_symm_fast_omp = BenchmarkThreads([&]() { return checkSymFastOMP(the_matrix.get(), N); }, "checkSymFastOMP", REPS,
+				next_threads, THREADS.front(), MAX_THREADS_USED, out);
+
+			if (is_symm != is_symm_fast_omp) {
+				std::cout << "checkSymFastOMP not working" << std::endl;
+			}
+		}
+
+		////////////////////////////////
+		if (BenchSelected("checkSymSIMD")) {
+			bool is_symm_simd = Benchmark([&]() { return checkSymSIMD(the_matrix.get(), N); }, "checkSymSIMD", REPS,
+				out, NUM_BYTES);
+
+			if (is_symm != is_symm_simd) {
+				std::cout << "checkSymSIMD not working" << std::endl;
+			}
+		}
+
+		////////////////////////////////
+		if (BenchSelected("checkSymSIMD_OMP")) {
+			bool is_symm_simd_omp = BenchmarkThreads([&]() { return checkSymSIMD_OMP(the_matrix.get(), N); }, "checkSymSIMD_OMP", REPS,
+				next_threads, THREADS.front(), MAX_THREADS_USED, out, NUM_BYTES);
+
+			if (is_symm != is_symm_simd_omp) {
+				std::cout << "checkSymSIMD_OMP not working" << std::endl;
+			}
+		}
+
+		////////////////////////////////
+		if (BenchSelected("checkSymPool")) {
+			bool is_symm_pool = BenchmarkThreads([&]() { return checkSymPool(the_matrix.get(), N); }, "checkSymPool", REPS,
+				next_threads, THREADS.front(), MAX_THREADS_USED, out, NUM_BYTES);
+
+			if (is_symm != is_symm_pool) {
+				std::cout << "checkSymPool not working" << std::endl;
+			}
+		}
+
+		////////////////////////////////
+		//Tolerance checks, with zero tolerance
+		//they must agree with the exact ones
+		if (BenchSelected("checkSymTolImp")) {
+			bool is_symm_tol = Benchmark([&]() { return checkSymTolImp(the_matrix.get(), N, 0, 0); }, "checkSymTolImp", REPS,
+				out, NUM_BYTES);
+
+			if (is_symm != is_symm_tol) {
+				std::cout << "checkSymTolImp not working" << std::endl;
+			}
+		}
+
+		////////////////////////////////
+		if (BenchSelected("checkSymTolOMP")) {
+			bool is_symm_tol_omp = BenchmarkThreads([&]() { return checkSymTolOMP(the_matrix.get(), N, 0, 0); }, "checkSymTolOMP", REPS,
+				next_threads, THREADS.front(), MAX_THREADS_USED, out, NUM_BYTES);
+
+			if (is_symm != is_symm_tol_omp) {
+				std::cout << "checkSymTolOMP not working" << std::endl;
+			}
+		}
+
+		////////////////////////////////
+		//Symmetric and skew parts in T7 and T8,
+		//which are free at this point
+		if (BenchSelected("OMP symmetric/skew parts")) {
+			BenchmarkThreads([&]() { matSymSkewOMP(the_matrix.get(), T7.get(), T8.get(), N); }, "OMP symmetric/skew parts", REPS,
+				next_threads, THREADS.front(), MAX_THREADS_USED, out, 3 * NUM_BYTES);
+			if (!checkSymFast(T7.get(), N))
+				std::cout << "OMP symmetric/skew parts not working" << std::endl;
+		}
+
+		////////////////////////////////
 
-		N <<= 1;
+		//Rewritten after every size, a run that is
+		//stopped keeps what it measured
+		if (!out.Write(args.output.c_str()))
+			std::cerr << "Cannot write " << args.output << std::endl;
 
 		std::cout << std::setfill('*') << std::setw(40) << "\n\n" << std::endl;
 	}
 
-	std::cin.get();
 	return 0;
 }
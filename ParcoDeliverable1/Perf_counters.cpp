@@ -0,0 +1,221 @@
+#include "Perf_counters.h"
+#include "Cpu_dispatch.h"
+#include "Matrix_alloc.h"
+#include "Thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <omp.h>
+
+//Bounds of each STREAM array, the lower one for
+//machines that do not report their LLC
+static constexpr size_t STREAM_COPY_MIN_BYTES = size_t(64) << 20;
+static constexpr size_t STREAM_COPY_MAX_BYTES = size_t(512) << 20;
+static constexpr size_t STREAM_COPY_ROW_BYTES = size_t(1) << 16;
+static constexpr uint32_t STREAM_COPY_RUNS = 5;
+
+static const char* PERF_EVENT_NAMES[PERF_EVENT_COUNT] = {
+	"cycles", "instructions", "LLC misses", "dTLB misses", "page faults"
+};
+
+const char* PerfEventName(PerfEvent event) {
+	return event < PerfEvent::Count ? PERF_EVENT_NAMES[uint32_t(event)] : "unknown";
+}
+
+bool PerfValues::AnyValid() const {
+	return std::find(valid, valid + PERF_EVENT_COUNT, true) != valid + PERF_EVENT_COUNT;
+}
+
+static perf_event_attr EventAttr(PerfEvent event) {
+	perf_event_attr attr;
+	std::memset(&attr, 0, sizeof(attr));
+
+	attr.size = sizeof(attr);
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	switch (event) {
+	case PerfEvent::Cycles:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CPU_CYCLES;
+		break;
+	case PerfEvent::Instructions:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+		break;
+	case PerfEvent::LLCMisses:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		break;
+	case PerfEvent::DTLBMisses:
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+			| (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		break;
+	default:
+		attr.type = PERF_TYPE_SOFTWARE;
+		attr.config = PERF_COUNT_SW_PAGE_FAULTS;
+		break;
+	}
+
+	return attr;
+}
+
+//Counter of the calling thread, on any cpu
+static int OpenEvent(PerfEvent event) {
+	perf_event_attr attr = EventAttr(event);
+	return int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+static bool CheckPerfCounters() {
+	bool any = false;
+
+	for (uint32_t event = 0; event < PERF_EVENT_COUNT; event++) {
+		int fd = OpenEvent(PerfEvent(event));
+
+		if (fd >= 0) {
+			close(fd);
+			any = true;
+		}
+	}
+
+	return any;
+}
+
+bool PerfCountersAvailable() {
+	static const bool available = CheckPerfCounters();
+	return available;
+}
+
+PerfCounters::~PerfCounters() {
+	Close();
+}
+
+void PerfCounters::OpenOnThisThread() {
+	int tid = int(syscall(SYS_gettid));
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	//The caller is also thread 0 of the team and of the pool
+	if (std::find(m_tids.begin(), m_tids.end(), tid) != m_tids.end())
+		return;
+
+	m_tids.push_back(tid);
+
+	for (uint32_t event = 0; event < PERF_EVENT_COUNT; event++)
+		m_fds.push_back(OpenEvent(PerfEvent(event)));
+}
+
+void PerfCounters::Start() {
+	Close();
+
+	OpenOnThisThread();
+
+#pragma omp parallel
+	OpenOnThisThread();
+
+	ThreadPool& pool = GetDefaultThreadPool();
+	pool.Run([this](uint32_t) { OpenOnThisThread(); });
+
+	//Opening woke the workers, their spin before going
+	//back to sleep would be counted for every kernel,
+	//also the ones that do not use the pool
+	pool.WaitIdle();
+
+	//Started together, after the (slow) opening
+	for (int fd : m_fds) {
+		if (fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+}
+
+PerfValues PerfCounters::Stop() {
+	PerfValues result{};
+
+	for (int fd : m_fds) {
+		if (fd >= 0)
+			ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+	}
+
+	for (size_t idx = 0; idx < m_fds.size(); idx++) {
+		const uint32_t EVENT = uint32_t(idx % PERF_EVENT_COUNT);
+
+		//Value, time enabled, time running
+		uint64_t data[3];
+
+		if (m_fds[idx] < 0 || read(m_fds[idx], data, sizeof(data)) != ssize_t(sizeof(data)))
+			continue;
+
+		result.valid[EVENT] = true;
+
+		//Multiplexed, extrapolate to the whole time
+		if (data[2] > 0)
+			result.values[EVENT] += double(data[0]) * double(data[1]) / double(data[2]);
+	}
+
+	Close();
+	return result;
+}
+
+void PerfCounters::Close() {
+	for (int fd : m_fds) {
+		if (fd >= 0)
+			close(fd);
+	}
+
+	m_fds.clear();
+	m_tids.clear();
+}
+
+static double MeasureStreamCopy() {
+	const size_t BYTES = std::min(std::max(size_t(GetCacheSizes().llc) * 4, STREAM_COPY_MIN_BYTES), STREAM_COPY_MAX_BYTES);
+	const uint32_t ROWS = uint32_t(BYTES / STREAM_COPY_ROW_BYTES);
+	const int64_t ELEMS = int64_t(BYTES / sizeof(MatType));
+	const int THREADS = omp_get_num_procs();
+
+	MatrixAllocOptions options = DefaultAllocOptions();
+	options.threads = uint32_t(THREADS);
+
+	MatType* a = static_cast<MatType*>(AllocateBuffer(ROWS, STREAM_COPY_ROW_BYTES, options));
+	MatType* b = static_cast<MatType*>(AllocateBuffer(ROWS, STREAM_COPY_ROW_BYTES, options));
+
+	double best = 0;
+
+	if (a != nullptr && b != nullptr) {
+#pragma omp parallel for schedule(static) num_threads(THREADS)
+		for (int64_t idx = 0; idx < ELEMS; idx++)
+			a[idx] = MatType(idx);
+
+		for (uint32_t run = 0; run < STREAM_COPY_RUNS; run++) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+#pragma omp parallel for schedule(static) num_threads(THREADS)
+			for (int64_t idx = 0; idx < ELEMS; idx++)
+				b[idx] = a[idx];
+
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			best = std::max(best, 2.0 * BYTES / elapsed.count() / 1e9);
+		}
+	}
+
+	FreeMatrix(a);
+	FreeMatrix(b);
+
+	return best;
+}
+
+double StreamCopyBandwidth() {
+	static const double bandwidth = MeasureStreamCopy();
+	return bandwidth;
+}
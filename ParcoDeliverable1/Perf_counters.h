@@ -0,0 +1,102 @@
+#ifndef PARCO_PERF_COUNTERS
+#define PARCO_PERF_COUNTERS
+
+#include "Defs.h"
+
+#include <mutex>
+#include <vector>
+
+/// <summary>
+/// Events counted by PerfCounters
+/// </summary>
+enum class PerfEvent : uint32_t {
+	Cycles = 0,
+	Instructions = 1,
+	LLCMisses = 2,
+	DTLBMisses = 3,
+	PageFaults = 4,
+	Count = 5
+};
+
+static constexpr uint32_t PERF_EVENT_COUNT = uint32_t(PerfEvent::Count);
+
+/// <summary>
+/// Human readable name of the event
+/// </summary>
+/// <param name="event">The event</param>
+/// <returns>Name</returns>
+const char* PerfEventName(PerfEvent event);
+
+/// <summary>
+/// Counts summed over every thread, scaled when the
+/// kernel had to multiplex the counters. An event is
+/// not valid if it could not be opened (no PMU in a
+/// VM, perf_event_paranoid too high...)
+/// </summary>
+struct PerfValues {
+	double values[PERF_EVENT_COUNT];
+	bool valid[PERF_EVENT_COUNT];
+
+	bool AnyValid() const;
+};
+
+/// <summary>
+/// Tells if at least one event can be opened,
+/// checked once with perf_event_open
+/// </summary>
+/// <returns>True if PerfCounters counts something</returns>
+bool PerfCountersAvailable();
+
+/// <summary>
+/// Hardware counters (perf_event_open) of one
+/// measurement. Linux counters only follow one thread,
+/// so Start opens them on the caller, on every thread
+/// of the next OMP team and on the workers of the
+/// default thread pool (enabled once they sleep
+/// again, so only a call that uses the pool wakes
+/// them), and Stop adds them up.
+/// Threads created after Start (nested teams) are not
+/// counted. User space only
+/// </summary>
+class PerfCounters {
+public:
+	PerfCounters() = default;
+
+	PerfCounters(PerfCounters const&) = delete;
+	PerfCounters& operator=(PerfCounters const&) = delete;
+
+	~PerfCounters();
+
+	/// <summary>
+	/// Opens the counters on the threads and starts them
+	/// </summary>
+	void Start();
+
+	/// <summary>
+	/// Stops the counters and closes them
+	/// </summary>
+	/// <returns>Counts of every thread, summed</returns>
+	PerfValues Stop();
+
+private:
+	void OpenOnThisThread();
+
+	void Close();
+
+	std::mutex m_mutex;
+	//Threads already counted
+	std::vector<int> m_tids;
+	//One fd per thread and event, -1 if not opened
+	std::vector<int> m_fds;
+};
+
+/// <summary>
+/// Bandwidth of a STREAM copy (b[i] = a[i], 2 arrays
+/// of 4 times the LLC, at most 512 MB each, counted
+/// as read + write) with one thread per cpu, best of
+/// 5 runs. Measured once, on the first call
+/// </summary>
+/// <returns>Bandwidth in GB/s</returns>
+double StreamCopyBandwidth();
+
+#endif // !PARCO_PERF_COUNTERS
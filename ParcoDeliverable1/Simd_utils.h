@@ -0,0 +1,93 @@
+#ifndef PARCO_SIMD_UTILS
+#define PARCO_SIMD_UTILS
+
+#include <xmmintrin.h>
+#include <immintrin.h>
+
+/// <summary>
+/// Transposes the 4x4 block held in the
+/// four registers, in place.
+/// Shared by every kernel that needs
+/// a transposed 4x4 tile in registers
+/// </summary>
+/// <param name="row1">First row, becomes first column</param>
+/// <param name="row2">Second row</param>
+/// <param name="row3">Third row</param>
+/// <param name="row4">Fourth row</param>
+static inline void Transpose4x4_Regs(__m128& row1, __m128& row2, __m128& row3, __m128& row4) {
+	__m128 t1{}, t2{}, t3{}, t4{};
+
+	//For each row:
+	//Select two elements from position N
+	//(where N is the destination row number)
+	//from alternating rows
+	t1 = _mm_shuffle_ps(row1, row3, 0b00000000);
+	//Select the other two elements from the
+	//the remaining rows
+	t2 = _mm_shuffle_ps(row2, row4, 0b00000000);
+	//Blend the two vectors together, by
+	//using an alternating pattern for selection
+	t1 = _mm_blend_ps(t1, t2, 0b1010);
+
+	t2 = _mm_shuffle_ps(row1, row3, 0b00010001);
+	t3 = _mm_shuffle_ps(row2, row4, 0b01000100);
+	t2 = _mm_blend_ps(t2, t3, 0b1010);
+
+	t3 = _mm_shuffle_ps(row1, row3, 0b00100010);
+	t4 = _mm_shuffle_ps(row2, row4, 0b10001000);
+	t3 = _mm_blend_ps(t3, t4, 0b1010);
+
+	t4 = _mm_shuffle_ps(row1, row3, 0b00110011);
+	row1 = _mm_shuffle_ps(row2, row4, 0b11001100);
+	t4 = _mm_blend_ps(t4, row1, 0b1010);
+
+	/*
+	To why we are using alternating rows in the shuffle:
+	https://www.intel.com/content/www/us/en/docs/intrinsics-guide/index.html#text=_mm_shuffle_&ig_expand=6047
+
+	In short: Adjacent elements are taken from the same
+	row, so we cannot get, for example, elements 0 and 0
+	of the first two rows and put them as elements 0, 1
+	in the transposed row
+
+	Step by step approach:
+
+	We need to transpose
+	0 1 2 3
+	4 5 6 7
+	8 9 a b
+	c d e f
+
+	1) Start by loading all 4 rows into xmm registers by using _mm_loadu_ps
+	2) First row shuffle:
+		Select element 0 from row0 and row3, putting them in a temp register,
+		which gives 0 - 8 -
+		Then select element 0 from row1 and row2, store them in a second register
+		giving - 4 - c
+		(Note that the - are don't care)
+	3) First row blend:
+		The immediate value in the blend instruction is 4 bits,
+		where bit N is used to decide from which variable
+		the value of the N float is taken
+		For reference:
+		https://www.intel.com/content/www/us/en/docs/intrinsics-guide/index.html#text=_mm_blend_ps&ig_expand=6047,482
+		By using the pattern 1010, we see that we are selecting
+		T[0] from the first temp. value,
+		T[1] from the second and so on
+		The resulting operation is:
+			0 - 8 -
+			- 4 - c
+		=   0 4 8 c
+	4) Repeat same approach used for row 0 but instead of selecting
+		element 0 from the rows in the shuffle, select
+		element N
+	5) Store each row one at a time
+	*/
+
+	row1 = t1;
+	row2 = t2;
+	row3 = t3;
+	row4 = t4;
+}
+
+#endif // !PARCO_SIMD_UTILS
@@ -0,0 +1,157 @@
+#include "Thread_pool.h"
+
+#include <algorithm>
+
+#include <immintrin.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <omp.h>
+
+//About 100 us of pause on recent cpus, long enough
+//to cover the gap between two calls of a benchmark
+static constexpr uint32_t POOL_SPIN_COUNT = 1 << 14;
+
+//Cpus in the affinity mask of the process
+static std::vector<uint32_t> AllowedCpus() {
+	std::vector<uint32_t> cpus;
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+
+	if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+		for (uint32_t cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			if (CPU_ISSET(cpu, &set))
+				cpus.push_back(cpu);
+		}
+	}
+
+	return cpus;
+}
+
+ThreadPool::ThreadPool(uint32_t threads, bool pin)
+	: m_task(nullptr), m_ctx(nullptr), m_stop(false),
+	m_state(0), m_pending(0), m_spin(POOL_SPIN_COUNT), m_sleeping(0) {
+	std::vector<uint32_t> cpus = AllowedCpus();
+
+	if (threads == 0)
+		threads = std::max<uint32_t>(uint32_t(cpus.size()), 1);
+
+	if (threads > cpus.size())
+		m_spin = 0;
+
+	for (uint32_t thread_idx = 1; thread_idx < threads; thread_idx++) {
+		m_workers.emplace_back(&ThreadPool::WorkerLoop, this, thread_idx);
+
+		//The caller is not pinned, it keeps its own mask.
+		//Worker i goes on the i-th allowed cpu, the first
+		//one is left to the caller while there are enough
+		if (pin && !cpus.empty()) {
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpus[thread_idx % cpus.size()], &set);
+			pthread_setaffinity_np(m_workers.back().native_handle(), sizeof(set), &set);
+		}
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_run_mutex);
+		m_stop = true;
+	}
+
+	//Wakes everyone, m_stop is read after the generation
+	Dispatch(nullptr, nullptr, 0);
+
+	for (std::thread& worker : m_workers)
+		worker.join();
+}
+
+void ThreadPool::Dispatch(TaskFunc task, void* ctx, uint32_t threads) {
+	std::lock_guard<std::mutex> lock(m_run_mutex);
+
+	//Stopping wakes every worker
+	const uint32_t ACTIVE = (threads == 0 || threads > Threads() || m_stop) ? Threads() : threads;
+
+	m_task = task;
+	m_ctx = ctx;
+	m_pending.store(ACTIVE - 1, std::memory_order_relaxed);
+
+	//Publishes the task, workers that are already
+	//asleep need the condition variable
+	uint64_t generation = (m_state.load(std::memory_order_relaxed) >> 32) + 1;
+	m_state.store((generation << 32) | ACTIVE, std::memory_order_seq_cst);
+
+	if (m_sleeping.load(std::memory_order_seq_cst) != 0) {
+		std::lock_guard<std::mutex> sleep_lock(m_sleep_mutex);
+		m_wake.notify_all();
+	}
+
+	if (task != nullptr)
+		task(ctx, 0);
+
+	//The workers finish at about the same time as the caller,
+	//spin a bit and then leave the cpu to them
+	for (uint32_t spin = 0; m_pending.load(std::memory_order_acquire) != 0; spin++) {
+		if (spin < m_spin)
+			_mm_pause();
+		else
+			std::this_thread::yield();
+	}
+}
+
+void ThreadPool::WaitIdle() {
+	//No new task can wake them meanwhile
+	std::lock_guard<std::mutex> lock(m_run_mutex);
+
+	while (m_sleeping.load(std::memory_order_seq_cst) < m_workers.size())
+		std::this_thread::yield();
+}
+
+void ThreadPool::WorkerLoop(uint32_t thread_idx) {
+	uint64_t seen = 0;
+
+	while (true) {
+		uint64_t state = m_state.load(std::memory_order_acquire);
+
+		for (uint32_t spin = 0; state >> 32 == seen >> 32 && spin < m_spin; spin++) {
+			_mm_pause();
+			state = m_state.load(std::memory_order_acquire);
+		}
+
+		if (state >> 32 == seen >> 32) {
+			std::unique_lock<std::mutex> lock(m_sleep_mutex);
+			m_sleeping.fetch_add(1, std::memory_order_seq_cst);
+
+			m_wake.wait(lock, [&]() {
+				state = m_state.load(std::memory_order_seq_cst);
+				return state >> 32 != seen >> 32;
+			});
+
+			m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		seen = state;
+
+		//Not part of this task, the caller does not wait
+		//for it and the task may already be gone
+		if (thread_idx >= uint32_t(state))
+			continue;
+
+		if (m_stop) {
+			m_pending.fetch_sub(1, std::memory_order_release);
+			return;
+		}
+
+		m_task(m_ctx, thread_idx);
+
+		m_pending.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+ThreadPool& GetDefaultThreadPool(uint32_t min_threads) {
+	static ThreadPool pool(std::max({ uint32_t(omp_get_num_procs()), uint32_t(omp_get_max_threads()),
+		min_threads }));
+	return pool;
+}
@@ -0,0 +1,130 @@
+#ifndef PARCO_THREAD_POOL
+#define PARCO_THREAD_POOL
+
+#include "Defs.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/// <summary>
+/// Workers created once and reused by every call, so a
+/// parallel transpose does not pay for the fork/join of a
+/// new OpenMP region. The calling thread works as thread 0,
+/// the others are pinned to the cpus the process may use.
+/// Idle workers spin for a while before sleeping, back to
+/// back calls find them awake. Calls from different threads
+/// are serialized, a task must not call back into its pool
+/// </summary>
+class ThreadPool {
+public:
+	/// <summary>
+	/// Starts threads - 1 workers
+	/// </summary>
+	/// <param name="threads">Threads including the caller (0 = one per cpu)</param>
+	/// <param name="pin">Pin each worker to a cpu</param>
+	explicit ThreadPool(uint32_t threads = 0, bool pin = true);
+
+	ThreadPool(ThreadPool const&) = delete;
+	ThreadPool& operator=(ThreadPool const&) = delete;
+
+	~ThreadPool();
+
+	uint32_t Threads() const { return uint32_t(m_workers.size()) + 1; }
+
+	/// <summary>
+	/// Calls func(thread_idx) once on each of the first
+	/// threads threads and returns when all are done
+	/// </summary>
+	/// <param name="func">Task</param>
+	/// <param name="threads">Threads to use (0 or more than Threads() = all)</param>
+	template <typename Func>
+	void Run(Func&& func, uint32_t threads = 0) {
+		using FuncType = typename std::remove_reference<Func>::type;
+
+		Dispatch([](void* ctx, uint32_t thread_idx) { (*static_cast<FuncType*>(ctx))(thread_idx); },
+			const_cast<void*>(static_cast<void const*>(&func)), threads);
+	}
+
+	/// <summary>
+	/// Calls func(idx) for every idx in [0, count), indices are
+	/// handed out one at a time to the first free thread
+	/// (like schedule(dynamic))
+	/// </summary>
+	/// <param name="count">Number of iterations</param>
+	/// <param name="func">Body of the loop</param>
+	/// <param name="threads">Threads to use (0 or more than Threads() = all)</param>
+	template <typename Func>
+	void ParallelFor(uint32_t count, Func&& func, uint32_t threads = 0) {
+		//More threads than iterations would only wait
+		if (count <= 1) {
+			if (count == 1)
+				func(0);
+			return;
+		}
+
+		if (threads == 0 || threads > count)
+			threads = std::min(count, Threads());
+
+		std::atomic<uint32_t> next(0);
+
+		Run([&](uint32_t) {
+			for (uint32_t idx = next.fetch_add(1, std::memory_order_relaxed); idx < count;
+				idx = next.fetch_add(1, std::memory_order_relaxed))
+				func(idx);
+		}, threads);
+	}
+
+	/// <summary>
+	/// Returns once every worker has stopped spinning
+	/// after the last call and sleeps
+	/// </summary>
+	void WaitIdle();
+
+private:
+	using TaskFunc = void(*)(void* ctx, uint32_t thread_idx);
+
+	void Dispatch(TaskFunc task, void* ctx, uint32_t threads);
+
+	void WorkerLoop(uint32_t thread_idx);
+
+	std::vector<std::thread> m_workers;
+
+	//Serializes Dispatch
+	std::mutex m_run_mutex;
+
+	//Current task, published by bumping the generation
+	TaskFunc m_task;
+	void* m_ctx;
+	bool m_stop;
+
+	//Generation in the high 32 bits, active threads in the
+	//low ones: a worker reads both at once, so it can skip
+	//a task it is not part of without being waited for
+	std::atomic<uint64_t> m_state;
+	std::atomic<uint32_t> m_pending;
+
+	//Spins before sleeping, 0 when there are more
+	//threads than cpus and spinning steals the cpu
+	uint32_t m_spin;
+
+	std::mutex m_sleep_mutex;
+	std::condition_variable m_wake;
+	std::atomic<uint32_t> m_sleeping;
+};
+
+/// <summary>
+/// Pool used by the functions that do not take one
+/// (matTransposePool, checkSymPool). Created on first
+/// use with one thread per cpu, OMP_NUM_THREADS or
+/// min_threads, whichever is larger
+/// </summary>
+/// <param name="min_threads">Only used by the first call</param>
+/// <returns>The pool</returns>
+ThreadPool& GetDefaultThreadPool(uint32_t min_threads = 0);
+
+#endif // !PARCO_THREAD_POOL
@@ -0,0 +1,507 @@
+#include "Tuning.h"
+#include "Matrix_manip.h"
+#include "Cpu_dispatch.h"
+#include "Matrix_alloc.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const char* const SIZE_CLASS_NAMES[SIZE_CLASS_COUNT] = {
+	"small", "small_pow2", "large", "large_pow2"
+};
+
+static const char* const KERNEL_NAMES[uint32_t(TransposeKernel::Count)] = {
+	"imp", "oblivious", "omp", "oblivious_omp", "stream_omp", "hier", "hier_omp", "pool"
+};
+
+TuningProfile DefaultTuningProfile() {
+	TuningProfile profile{};
+
+	profile.block_ratio = 1.5f;
+	profile.leaf_size = 32;
+	profile.leaf_size_omp = 64;
+	profile.large_elements = 512 * 512;
+	profile.stream_bytes = STREAM_THRESHOLD_BYTES;
+
+	//Same as the old jump table
+	profile.kernels[SIZE_SMALL] = TransposeKernel::Imp;
+	profile.kernels[SIZE_SMALL_POW2] = TransposeKernel::Oblivious;
+	profile.kernels[SIZE_LARGE] = TransposeKernel::OMP;
+	profile.kernels[SIZE_LARGE_POW2] = TransposeKernel::ObliviousOMP;
+
+	for (uint32_t idx = 0; idx < SIZE_CLASS_COUNT; idx++)
+		profile.threads[idx] = 0;
+
+	return profile;
+}
+
+static TuningProfile LoadActiveProfile() {
+	TuningProfile profile = DefaultTuningProfile();
+
+	const char* path = std::getenv("PARCO_TUNING_PROFILE");
+	bool explicit_path = path != nullptr;
+
+	if (!explicit_path)
+		path = DEFAULT_TUNING_PROFILE;
+
+	//No profile in the working directory is the normal case,
+	//only complain if the user asked for a specific file
+	if (!std::ifstream(path)) {
+		if (explicit_path)
+			std::cerr << "Tuning profile " << path << " not found, using defaults" << std::endl;
+		return profile;
+	}
+
+	if (!LoadTuningProfile(path, profile)) {
+		std::cerr << "Invalid tuning profile " << path << ", using defaults" << std::endl;
+		return DefaultTuningProfile();
+	}
+
+	return profile;
+}
+
+static TuningProfile& ActiveProfile() {
+	//Loaded once, thread safe since C++11
+	static TuningProfile profile = LoadActiveProfile();
+	return profile;
+}
+
+TuningProfile const& GetTuningProfile() {
+	return ActiveProfile();
+}
+
+void SetTuningProfile(TuningProfile const& profile) {
+	ActiveProfile() = profile;
+}
+
+static bool ParseKernel(std::string const& name, TransposeKernel& kernel) {
+	for (uint32_t idx = 0; idx < uint32_t(TransposeKernel::Count); idx++) {
+		if (name == KERNEL_NAMES[idx]) {
+			kernel = TransposeKernel(idx);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//The recursion splits at multiples of 4 only while both
+//halves are at least 4 (see CacheObliviousSplit), below
+//8 a leaf can start at an odd offset and the aligned
+//4x4 kernels would write to a misaligned address
+static bool IsValidLeafSize(uint32_t leaf_size) {
+	return leaf_size >= 8 && leaf_size % 4 == 0;
+}
+
+bool LoadTuningProfile(const char* path, TuningProfile& profile) {
+	std::ifstream in(path);
+
+	if (!in)
+		return false;
+
+	TuningProfile loaded = profile;
+	std::string line;
+
+	try {
+		while (std::getline(in, line)) {
+			if (line.empty() || line[0] == '#')
+				continue;
+
+			std::istringstream fields(line);
+			std::string key, value;
+
+			if (!(fields >> key >> value))
+				return false;
+
+			if (key == "block_ratio")
+				loaded.block_ratio = std::stof(value);
+			else if (key == "leaf_size")
+				loaded.leaf_size = uint32_t(std::stoul(value));
+			else if (key == "leaf_size_omp")
+				loaded.leaf_size_omp = uint32_t(std::stoul(value));
+			else if (key == "large_elements")
+				loaded.large_elements = std::stoull(value);
+			else if (key == "stream_bytes")
+				loaded.stream_bytes = std::stoull(value);
+			else {
+				//kernel_<class> and threads_<class>,
+				//unknown keys are skipped so that newer
+				//profiles still load
+				for (uint32_t size_class = 0; size_class < SIZE_CLASS_COUNT; size_class++) {
+					if (key == std::string("kernel_") + SIZE_CLASS_NAMES[size_class]) {
+						if (!ParseKernel(value, loaded.kernels[size_class]))
+							return false;
+					}
+					else if (key == std::string("threads_") + SIZE_CLASS_NAMES[size_class]) {
+						loaded.threads[size_class] = uint32_t(std::stoul(value));
+					}
+				}
+			}
+		}
+	}
+	catch (...) {
+		//stof/stoul on garbage
+		return false;
+	}
+
+	if (!(loaded.block_ratio > 0.0f) || !IsValidLeafSize(loaded.leaf_size) || !IsValidLeafSize(loaded.leaf_size_omp))
+		return false;
+
+	profile = loaded;
+	return true;
+}
+
+bool SaveTuningProfile(const char* path, TuningProfile const& profile) {
+	std::ofstream out(path, std::ios::out);
+
+	if (!out)
+		return false;
+
+	out << "# Transpose tuning profile\n";
+	out << "# simd " << SimdLevelName(GetSimdLevel()) << "\n";
+	out << "block_ratio " << profile.block_ratio << "\n";
+	out << "leaf_size " << profile.leaf_size << "\n";
+	out << "leaf_size_omp " << profile.leaf_size_omp << "\n";
+	out << "large_elements " << profile.large_elements << "\n";
+	out << "stream_bytes " << profile.stream_bytes << "\n";
+
+	for (uint32_t size_class = 0; size_class < SIZE_CLASS_COUNT; size_class++) {
+		out << "kernel_" << SIZE_CLASS_NAMES[size_class] << " "
+			<< TransposeKernelName(profile.kernels[size_class]) << "\n";
+		out << "threads_" << SIZE_CLASS_NAMES[size_class] << " "
+			<< profile.threads[size_class] << "\n";
+	}
+
+	return bool(out);
+}
+
+TransposeFunc GetTransposeKernel(TransposeKernel kernel) {
+	//Overloads, the cast picks the rectangular version
+	switch (kernel) {
+	case TransposeKernel::Oblivious:
+		return static_cast<TransposeFunc>(matTransposeCacheOblivious);
+	case TransposeKernel::OMP:
+		return static_cast<TransposeFunc>(matTransposeOMP);
+	case TransposeKernel::ObliviousOMP:
+		return static_cast<TransposeFunc>(matTransposeCacheObliviousOMP);
+	case TransposeKernel::StreamOMP:
+		return static_cast<TransposeFunc>(matTransposeStreamOMP);
+	case TransposeKernel::Hier:
+		return static_cast<TransposeFunc>(matTransposeHier);
+	case TransposeKernel::HierOMP:
+		return static_cast<TransposeFunc>(matTransposeHierOMP);
+	case TransposeKernel::Pool:
+		return static_cast<TransposeFunc>(matTransposePool);
+	default:
+		break;
+	}
+
+	return static_cast<TransposeFunc>(matTransposeImp);
+}
+
+const char* TransposeKernelName(TransposeKernel kernel) {
+	if (uint32_t(kernel) >= uint32_t(TransposeKernel::Count))
+		return KERNEL_NAMES[0];
+
+	return KERNEL_NAMES[uint32_t(kernel)];
+}
+
+//////////////////////////////////////////
+//AUTOTUNING
+
+//Kernel and thread count tried on every size
+struct TuneConfig {
+	TransposeKernel kernel;
+	uint32_t threads;
+};
+
+//Median of a few runs after a warm up run,
+//threads = 0 leaves the OpenMP default
+static double TimeTranspose(TransposeKernel kernel, MatType const* M, MatType* T, uint32_t N,
+	uint32_t threads) {
+	const uint32_t RUNS = 5;
+
+	matTransposeKernel(kernel, M, T, N, N, N, N, threads);
+
+	std::vector<double> times;
+
+	for (uint32_t run = 0; run < RUNS; run++) {
+		auto start = std::chrono::steady_clock::now();
+		matTransposeKernel(kernel, M, T, N, N, N, N, threads);
+		auto end = std::chrono::steady_clock::now();
+
+		times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	std::nth_element(times.begin(), times.begin() + RUNS / 2, times.end());
+	return times[RUNS / 2];
+}
+
+//Each size is normalized by its time with the first
+//candidate, otherwise the largest matrix would decide alone
+template <typename Candidate, typename Apply>
+static Candidate SweepParameter(std::vector<Candidate> const& candidates, Apply&& apply,
+	TransposeKernel kernel, std::vector<uint32_t> const& sizes, MatType const* M, MatType* T,
+	const char* name, std::ostream& log) {
+	std::vector<double> reference(sizes.size(), 0.0);
+
+	Candidate best = candidates[0];
+	double best_score = 0.0;
+
+	for (size_t idx = 0; idx < candidates.size(); idx++) {
+		apply(candidates[idx]);
+
+		double score = 0.0;
+
+		for (size_t size_idx = 0; size_idx < sizes.size(); size_idx++) {
+			double time = TimeTranspose(kernel, M, T, sizes[size_idx], 0);
+
+			if (idx == 0)
+				reference[size_idx] = time;
+
+			score += time / std::max(reference[size_idx], 1e-6);
+		}
+
+		log << name << " " << candidates[idx] << ": " << score / sizes.size() << std::endl;
+
+		if (idx == 0 || score < best_score) {
+			best = candidates[idx];
+			best_score = score;
+		}
+	}
+
+	apply(best);
+	return best;
+}
+
+static uint32_t SizeClassOf(uint32_t N, uint64_t large_elements) {
+	uint32_t size_class = uint32_t(uint64_t(N) * N >= large_elements) << 1;
+	return size_class | uint32_t((N & (N - 1)) == 0);
+}
+
+//Picks the config of each size class with the lowest time
+//relative to the fastest config, summed over the sizes of
+//the class. Classes without sizes keep their entry of chosen.
+//Returns the sum over all the classes
+static double ChooseClassConfigs(std::vector<std::vector<double>> const& times, std::vector<uint32_t> const& sizes,
+	uint64_t large_elements, size_t (&chosen)[SIZE_CLASS_COUNT]) {
+	double total = 0.0;
+
+	for (uint32_t size_class = 0; size_class < SIZE_CLASS_COUNT; size_class++) {
+		double best_score = 0.0;
+		bool first = true;
+
+		for (size_t config_idx = 0; config_idx < times[0].size(); config_idx++) {
+			double score = 0.0;
+			bool has_sizes = false;
+
+			for (size_t size_idx = 0; size_idx < sizes.size(); size_idx++) {
+				if (SizeClassOf(sizes[size_idx], large_elements) != size_class)
+					continue;
+
+				std::vector<double> const& size_times = times[size_idx];
+				double fastest = *std::min_element(size_times.begin(), size_times.end());
+
+				score += size_times[config_idx] / std::max(fastest, 1e-6);
+				has_sizes = true;
+			}
+
+			if (!has_sizes)
+				break;
+
+			if (first || score < best_score) {
+				first = false;
+				best_score = score;
+				chosen[size_class] = config_idx;
+			}
+		}
+
+		total += best_score;
+	}
+
+	return total;
+}
+
+TuningProfile AutotuneTranspose(uint32_t max_N, uint32_t max_threads, std::ostream& log) {
+	const TuningProfile original = GetTuningProfile();
+
+	TuningProfile profile = original;
+	SetTuningProfile(profile);
+
+	max_threads = std::max(max_threads, 1u);
+
+	//Powers of two and 3/4 of them up to max_N, the crossovers
+	//between the size classes and to streaming are searched here
+	std::vector<uint32_t> sizes;
+	for (uint32_t pow2 = 64; pow2 <= max_N; pow2 *= 2) {
+		sizes.push_back(pow2 / 4 * 3);
+		sizes.push_back(pow2);
+	}
+
+	if (sizes.empty())
+		sizes.push_back(std::max(max_N, 4u));
+
+	//The parameters only need a few of them: the old small
+	//cases and the two largest sizes
+	std::vector<uint32_t> param_sizes{ 384, 256 };
+	for (size_t idx = sizes.size() >= 2 ? sizes.size() - 2 : 0; idx < sizes.size(); idx++) {
+		if (sizes[idx] > 384)
+			param_sizes.push_back(sizes[idx]);
+	}
+
+	uint32_t alloc_N = std::max(sizes.back(), 384u);
+
+	MatType* M = AllocateMatrix(alloc_N);
+	MatType* T = AllocateMatrix(alloc_N);
+
+	if (M == nullptr || T == nullptr) {
+		log << "Could not allocate two " << alloc_N << "x" << alloc_N
+			<< " matrices, keeping the current profile" << std::endl;
+
+		FreeMatrix(M);
+		FreeMatrix(T);
+		return original;
+	}
+
+	for (size_t idx = 0; idx < size_t(alloc_N) * alloc_N; idx++)
+		M[idx] = MatType(rand() % int(VALUE_MAX));
+
+	log << "Tuning with " << SimdLevelName(GetSimdLevel()) << " kernels, up to "
+		<< max_threads << " threads" << std::endl;
+
+	//Parameters first, the kernel selection
+	//then runs with the tuned ones
+	profile.block_ratio = SweepParameter(std::vector<float>{ 1.5f, 0.5f, 1.0f, 2.0f, 3.0f, 4.0f },
+		[&](float ratio) { profile.block_ratio = ratio; SetTuningProfile(profile); },
+		TransposeKernel::Imp, param_sizes, M, T, "block_ratio", log);
+
+	profile.leaf_size = SweepParameter(std::vector<uint32_t>{ 32, 16, 64, 128 },
+		[&](uint32_t leaf) { profile.leaf_size = leaf; SetTuningProfile(profile); },
+		TransposeKernel::Oblivious, param_sizes, M, T, "leaf_size", log);
+
+	profile.leaf_size_omp = SweepParameter(std::vector<uint32_t>{ 64, 32, 128, 256 },
+		[&](uint32_t leaf) { profile.leaf_size_omp = leaf; SetTuningProfile(profile); },
+		TransposeKernel::ObliviousOMP, param_sizes, M, T, "leaf_size_omp", log);
+
+	//Thread counts tried by the OMP kernels
+	std::vector<uint32_t> thread_counts;
+	for (uint32_t threads = 1; threads < max_threads; threads *= 2)
+		thread_counts.push_back(threads);
+	thread_counts.push_back(max_threads);
+
+	std::vector<TuneConfig> configs;
+	for (uint32_t kernel_idx = 0; kernel_idx < uint32_t(TransposeKernel::Count); kernel_idx++) {
+		TransposeKernel kernel = TransposeKernel(kernel_idx);
+		bool uses_omp = kernel != TransposeKernel::Imp && kernel != TransposeKernel::Oblivious
+			&& kernel != TransposeKernel::Hier;
+
+		if (!uses_omp) {
+			configs.push_back({ kernel, 0 });
+			continue;
+		}
+
+		for (uint32_t threads : thread_counts)
+			configs.push_back({ kernel, threads });
+	}
+
+	//Every config on every size
+	std::vector<std::vector<double>> times(sizes.size(), std::vector<double>(configs.size()));
+
+	for (size_t size_idx = 0; size_idx < sizes.size(); size_idx++) {
+		for (size_t config_idx = 0; config_idx < configs.size(); config_idx++) {
+			TuneConfig const& config = configs[config_idx];
+			double time = TimeTranspose(config.kernel, M, T, sizes[size_idx], config.threads);
+
+			log << "N=" << sizes[size_idx] << " " << TransposeKernelName(config.kernel);
+			if (config.threads != 0)
+				log << " " << config.threads << " threads";
+			log << ": " << time << " ms" << std::endl;
+
+			times[size_idx][config_idx] = time;
+		}
+	}
+
+	//Small/large crossover: a class boundary at each size,
+	//or past the largest one (everything small)
+	size_t chosen[SIZE_CLASS_COUNT];
+	double best_total = 0.0;
+
+	for (size_t size_idx = 0; size_idx <= sizes.size(); size_idx++) {
+		uint64_t large_elements = size_idx < sizes.size() ? uint64_t(sizes[size_idx]) * sizes[size_idx]
+			: uint64_t(sizes.back()) * sizes.back() + 1;
+
+		//configs.size() marks a class without sizes,
+		//which keeps the kernel of the profile
+		size_t candidate[SIZE_CLASS_COUNT];
+		std::fill(candidate, candidate + SIZE_CLASS_COUNT, configs.size());
+
+		double total = ChooseClassConfigs(times, sizes, large_elements, candidate);
+
+		log << "large_elements " << large_elements << ": " << total / sizes.size() << std::endl;
+
+		if (size_idx == 0 || total < best_total) {
+			best_total = total;
+			profile.large_elements = large_elements;
+			std::copy(candidate, candidate + SIZE_CLASS_COUNT, chosen);
+		}
+	}
+
+	for (uint32_t size_class = 0; size_class < SIZE_CLASS_COUNT; size_class++) {
+		if (chosen[size_class] < configs.size()) {
+			profile.kernels[size_class] = configs[chosen[size_class]].kernel;
+			profile.threads[size_class] = configs[chosen[size_class]].threads;
+		}
+	}
+
+	//Streaming threshold: the smallest size from which
+	//the streaming transpose beats the chosen kernel on
+	//every larger size too
+	size_t stream_from = sizes.size();
+
+	for (size_t size_idx = sizes.size(); size_idx-- > 0;) {
+		double stream_time = 0.0;
+		bool first = true;
+
+		for (size_t config_idx = 0; config_idx < configs.size(); config_idx++) {
+			if (configs[config_idx].kernel == TransposeKernel::StreamOMP
+				&& (first || times[size_idx][config_idx] < stream_time)) {
+				first = false;
+				stream_time = times[size_idx][config_idx];
+			}
+		}
+
+		uint32_t size_class = SizeClassOf(sizes[size_idx], profile.large_elements);
+		double class_time = chosen[size_class] < configs.size() ? times[size_idx][chosen[size_class]] : 0.0;
+
+		log << "N=" << sizes[size_idx] << " stream_omp " << stream_time << " ms, "
+			<< SIZE_CLASS_NAMES[size_class] << " kernel " << class_time << " ms" << std::endl;
+
+		if (first || !(stream_time < class_time))
+			break;
+
+		stream_from = size_idx;
+	}
+
+	//Never faster on the largest size: the threshold is only
+	//moved past it, larger matrices were not measured
+	const uint64_t LARGEST_BYTES = uint64_t(sizes.back()) * sizes.back() * sizeof(MatType);
+
+	if (stream_from < sizes.size())
+		profile.stream_bytes = uint64_t(sizes[stream_from]) * sizes[stream_from] * sizeof(MatType);
+	else
+		profile.stream_bytes = std::max(profile.stream_bytes, LARGEST_BYTES + sizeof(MatType));
+
+	FreeMatrix(M);
+	FreeMatrix(T);
+
+	SetTuningProfile(original);
+
+	return profile;
+}
@@ -0,0 +1,137 @@
+#ifndef PARCO_TUNING
+#define PARCO_TUNING
+
+#include "Defs.h"
+
+#include <iosfwd>
+
+//Profile read when no path is given
+//and PARCO_TUNING_PROFILE is not set
+#define DEFAULT_TUNING_PROFILE "parco_tuning.txt"
+
+/// <summary>
+/// Transposes that matTransposeFinal can dispatch to
+/// </summary>
+enum class TransposeKernel : uint32_t {
+	Imp = 0,
+	Oblivious = 1,
+	OMP = 2,
+	ObliviousOMP = 3,
+	StreamOMP = 4,
+	Hier = 5,
+	HierOMP = 6,
+	Pool = 7,
+	Count = 8
+};
+
+/// <summary>
+/// Size classes of matTransposeFinal,
+/// used to index the kernel table
+/// </summary>
+enum TuningSizeClass : uint32_t {
+	SIZE_SMALL = 0,
+	SIZE_SMALL_POW2 = 1,
+	SIZE_LARGE = 2,
+	SIZE_LARGE_POW2 = 3,
+	SIZE_CLASS_COUNT = 4
+};
+
+/// <summary>
+/// Machine dependent parameters of the transposes.
+/// The defaults are the values that used to be
+/// hard coded, tuned on a single desktop
+/// </summary>
+struct TuningProfile {
+	//Max block size of ComputeBlockSize, in cache lines
+	float block_ratio;
+	//Leaf size of the serial cache oblivious recursion,
+	//a multiple of 4 and at least 8
+	uint32_t leaf_size;
+	//Below this size the OMP cache oblivious transpose
+	//does not spawn tasks, same constraints
+	uint32_t leaf_size_omp;
+	//Elements from which a matrix is in a large size class
+	uint64_t large_elements;
+	//Bytes from which matTransposeFinal always streams
+	uint64_t stream_bytes;
+	//Kernel and thread count (0 = OpenMP default)
+	//for each size class. The count is passed to the
+	//kernel, capped by omp_get_max_threads()
+	TransposeKernel kernels[SIZE_CLASS_COUNT];
+	uint32_t threads[SIZE_CLASS_COUNT];
+};
+
+using TransposeFunc = void(*)(MatType const* M, MatType* T, uint32_t rows, uint32_t cols,
+	uint32_t lda, uint32_t ldb);
+
+/// <summary>
+/// Returns the profile matching the old hard coded behaviour
+/// </summary>
+/// <returns>Default profile</returns>
+TuningProfile DefaultTuningProfile();
+
+/// <summary>
+/// Returns the active profile. On first use it is
+/// loaded from the file in PARCO_TUNING_PROFILE, or
+/// DEFAULT_TUNING_PROFILE in the working directory,
+/// and falls back to the defaults if there is none
+/// </summary>
+/// <returns>Active profile</returns>
+TuningProfile const& GetTuningProfile();
+
+/// <summary>
+/// Replaces the active profile.
+/// Not thread safe, must not run
+/// together with any transpose
+/// </summary>
+/// <param name="profile">New profile</param>
+void SetTuningProfile(TuningProfile const& profile);
+
+/// <summary>
+/// Reads a profile written by SaveTuningProfile.
+/// Missing keys keep the value they have in profile
+/// </summary>
+/// <param name="path">File path</param>
+/// <param name="profile">Profile to update</param>
+/// <returns>false if the file could not be opened or has invalid values</returns>
+bool LoadTuningProfile(const char* path, TuningProfile& profile);
+
+/// <summary>
+/// Writes the profile as "key value" lines
+/// </summary>
+/// <param name="path">File path</param>
+/// <param name="profile">The profile</param>
+/// <returns>false if the file could not be written</returns>
+bool SaveTuningProfile(const char* path, TuningProfile const& profile);
+
+/// <summary>
+/// Returns the function of a kernel
+/// </summary>
+/// <param name="kernel">The kernel</param>
+/// <returns>Function pointer</returns>
+TransposeFunc GetTransposeKernel(TransposeKernel kernel);
+
+/// <summary>
+/// Name of the kernel, as used in the profile file
+/// </summary>
+/// <param name="kernel">The kernel</param>
+/// <returns>Name</returns>
+const char* TransposeKernelName(TransposeKernel kernel);
+
+/// <summary>
+/// Sweeps block ratio, leaf sizes, kernels and
+/// thread counts on this machine and returns the
+/// fastest configuration. Every kernel is timed on
+/// sizes from 48 to max_N, which also place the
+/// small/large and the streaming thresholds. The
+/// active profile is changed during the sweep and
+/// restored at the end, and returned unchanged if
+/// the matrices cannot be allocated
+/// </summary>
+/// <param name="max_N">Largest matrix side used</param>
+/// <param name="max_threads">Largest thread count tried</param>
+/// <param name="log">Progress output</param>
+/// <returns>Tuned profile</returns>
+TuningProfile AutotuneTranspose(uint32_t max_N, uint32_t max_threads, std::ostream& log);
+
+#endif // !PARCO_TUNING
@@ -1,8 +1,16 @@
 #include "Utils.h"
+#include "Matrix_alloc.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
 #include <ctime>
 #include <cstring>
 #include <iostream>
+#include <sstream>
+#include <string>
 
 #include <omp.h>
 
@@ -13,34 +21,36 @@ void InitRand() {
 
 //Allocate N*N contiguous memory
 //(do not use array of pointers for each row, bad for cache and paging)
-Matrix CreateRandomMatrix(uint32_t N, uint32_t N_THREADS) {
-	const uint32_t TOT_SIZE = N * N;
+DenseMatrix AllocateDenseMatrix(uint32_t N, uint32_t N_THREADS) {
+	//The pages are placed by the allocator
+	//(first touch by default, see Matrix_alloc.h):
+	//on a NUMA system the rows end up on the
+	//socket of the thread that will read them,
+	//instead of all on the socket of the main thread
+	MatrixAllocOptions options = DefaultAllocOptions();
+	options.threads = N_THREADS;
+
+	return DenseMatrix(AllocateMatrix(N, N, options), FreeMatrix);
+}
+
+DenseMatrix CreateRandomMatrix(uint32_t N, uint32_t N_THREADS) {
+	DenseMatrix unit_matrix = AllocateDenseMatrix(N, N_THREADS);
 
-	auto unit_matrix = new MatType[TOT_SIZE];
+	if (!unit_matrix)
+		return unit_matrix;
 
 	int omp_dynamic = omp_get_dynamic();
 	omp_set_dynamic(0);
 
 	omp_set_num_threads(N_THREADS);
 
-	//Init matrix linearly, one element at a time
-	//You may be asking, why are we using openmp here?
-	//Well my friend, this is useless when running
-	//on a desktop system with a normal desktop
-	//cpu, but necessary when running on a NUMA
-	//system.
-	//In principle, the new only reserves virtual memory,
-	//and does not, in fact, allocate physical memory.
-	//This allows us to perform the real init on 
-	//multiple threads that, hopefully, will be 
-	//distributed on different sockets in a smart
-	//way. By the time that we ready to run benchmarks
-	//for the matrix transposition, the matrix will be 
-	//distributed on the physical memory of multiple 
-	//sockets, allowing fast access from all threads
-#pragma omp parallel for
-	for (uint32_t index = 0; index < TOT_SIZE; index++) {
-		unit_matrix[index] = rand() % int(VALUE_MAX);
+	MatType* M = unit_matrix.get();
+
+#pragma omp parallel for schedule(static)
+	for (uint32_t row_idx = 0; row_idx < N; row_idx++) {
+		for (uint32_t col_idx = 0; col_idx < N; col_idx++) {
+			M[size_t(row_idx) * N + col_idx] = rand() % int(VALUE_MAX);
+		}
 	}
 
 	omp_set_dynamic(omp_dynamic);
@@ -66,32 +76,76 @@ int IsSameMatrix(MatType const* M, MatType const* T, uint32_t N) {
 	return std::memcmp(M, T, (N * N) * sizeof(MatType));
 }
 
-uint32_t TryParseUint32(const char* str, const char* err_msg) {
-	uint32_t parsed_value = 0;
+bool ParseUint32(const char* str, uint32_t& value) {
+	//strtoul would skip spaces and accept a sign
+	if (str[0] < '0' || str[0] > '9')
+		return false;
 
-	try {
-		parsed_value = uint32_t(std::stoi(std::string{ str }));
-	}
-	catch (...) {
-		std::cerr << err_msg << std::endl;
-		std::exit(0);
+	char* end = nullptr;
+	errno = 0;
+	unsigned long parsed = std::strtoul(str, &end, 10);
+
+	if (*end != '\0' || errno == ERANGE || parsed > UINT32_MAX)
+		return false;
+
+	value = uint32_t(parsed);
+	return true;
+}
+
+//Numbers from first to last, both included
+static bool AppendRange(std::string const& range, std::vector<uint32_t>& values) {
+	unsigned long first = 0, last = 0, step = 2;
+	char kind = 'x';
+	char extra = 0;
+
+	int parsed = std::sscanf(range.c_str(), "%lu:%lu:%c%lu%c", &first, &last, &kind, &step, &extra);
+
+	if (parsed == 2)
+		parsed = 4;
+
+	if (parsed != 4 || first == 0 || first > last || last > UINT32_MAX
+		|| (kind == 'x' && step < 2) || (kind == '+' && step < 1) || (kind != 'x' && kind != '+'))
+		return false;
+
+	for (unsigned long value = first; value <= last; value = kind == 'x' ? value * step : value + step)
+		values.push_back(uint32_t(value));
+
+	return true;
+}
+
+bool ParseUint32List(const char* str, std::vector<uint32_t>& values) {
+	std::stringstream list(str);
+	std::string item;
+
+	values.clear();
+
+	while (std::getline(list, item, ',')) {
+		if (item.find(':') != std::string::npos) {
+			if (!AppendRange(item, values))
+				return false;
+			continue;
+		}
+
+		uint32_t value = 0;
+
+		if (!ParseUint32(item.c_str(), value) || value == 0)
+			return false;
+
+		values.push_back(value);
 	}
 
-	return parsed_value;
+	std::sort(values.begin(), values.end());
+	values.erase(std::unique(values.begin(), values.end()), values.end());
+
+	return !values.empty();
 }
 
 ////////////////////////////////////////////////
 //Nothing to see here
 
 MatType* AllocateAndInit(uint32_t N) {
-	MatType* T = new MatType[N * N];
-
-#pragma omp parallel for
-	for (uint32_t i = 0; i < N * N; i++) {
-		T[i] = 0;
-	}
-
-	return T;
+	//Already zeroed by the allocator
+	return AllocateMatrix(N);
 }
 
 bool VerifyNestedAvail() {
@@ -2,6 +2,10 @@
 #define PARCO_UTILS
 
 #include "Defs.h"
+#include "Matrix_view.h"
+
+#include <memory>
+#include <vector>
 
 /// <summary>
 /// Inits random number generation
@@ -9,13 +13,29 @@
 void InitRand();
 
 /// <summary>
-/// Allocates N*N contiguous memory and
+/// N*N matrix without padding between the rows, as
+/// the functions that only take N expect for any N
+/// (a Matrix pads them to a multiple of 16)
+/// </summary>
+using DenseMatrix = std::unique_ptr<MatType, void(*)(void*)>;
+
+/// <summary>
+/// Allocates a zeroed N*N matrix, its pages
+/// are placed by N_THREADS threads
+/// </summary>
+/// <param name="N">N rows and columns</param>
+/// <param name="N_THREADS">Number of threads for init (useful for NUMA)</param>
+/// <returns>The matrix, empty if it could not be allocated</returns>
+DenseMatrix AllocateDenseMatrix(uint32_t N, uint32_t N_THREADS);
+
+/// <summary>
+/// Allocates a N*N matrix and
 /// initializes it with random numbers
 /// </summary>
 /// <param name="N">N rows and columns</param>
 /// <param name="N_THREADS">Number of threads for init (useful for NUMA)</param>
 /// <returns></returns>
-Matrix CreateRandomMatrix(uint32_t N, uint32_t N_THREADS);
+DenseMatrix CreateRandomMatrix(uint32_t N, uint32_t N_THREADS);
 
 /// <summary>
 /// Print matrix to console
@@ -34,15 +54,24 @@ void PrintMatrix(MatType* mat, uint32_t N);
 int IsSameMatrix(MatType const* M, MatType const* T, uint32_t N);
 
 /// <summary>
-/// Attempts to parse a uint32 from
-/// the given parameter and prints 
-/// err_msg to the console if it fails
-/// (after that it simply stops execution)
+/// Parses a decimal uint32, the whole string
+/// must be digits (no sign, no spaces)
+/// </summary>
+/// <param name="str">Origin string</param>
+/// <param name="value">Parsed number</param>
+/// <returns>False if the string is not a number or does not fit</returns>
+bool ParseUint32(const char* str, uint32_t& value);
+
+/// <summary>
+/// Parses a comma separated list of numbers and
+/// ranges, sorted and without duplicates.
+/// A range is first:last (doubling), first:last:+step
+/// or first:last:xfactor, e.g. "100,128:1024,3000:4000:+500"
 /// </summary>
 /// <param name="str">Origin string</param>
-/// <param name="err_msg">Error message</param>
-/// <returns>The number</returns>
-uint32_t TryParseUint32(const char* str, const char* err_msg);
+/// <param name="values">Parsed numbers</param>
+/// <returns>False if the string is not valid</returns>
+bool ParseUint32List(const char* str, std::vector<uint32_t>& values);
 
 ////////////////////////////
 //Ignore these two functions
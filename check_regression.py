@@ -0,0 +1,152 @@
+import argparse
+import json
+import math
+import os
+import shutil
+import subprocess
+import sys
+
+#Runs the benchmarks listed in the config (regression.json) and
+#compares them with a baseline written by the same script with
+#--update. A result is a regression when its median is slower than
+#the baseline by at least the tolerance of its kernel (in %) and
+#the difference of the means is larger than the 95% confidence
+#intervals of both runs. A result of the baseline missing from the
+#new run (a kernel that stopped running or was renamed) fails the
+#check too. Exit code: 0 ok, 1 regressions or missing results, 2 error
+
+def load_json(path):
+	with open(path, 'r') as input_file:
+		return json.load(input_file)
+
+def run_benchmarks(binary, config, output):
+	args = [binary,
+		'--sizes', config['sizes'],
+		'--threads', config['threads'],
+		'--reps', str(config['reps']),
+		'--time-ms', str(config['time_ms']),
+		'--target-error', str(config['target_error']),
+		'--output', output]
+
+	if config.get('filter'):
+		args += ['--filter', config['filter']]
+
+	print(' '.join(args))
+	return subprocess.call(args, stdin=subprocess.DEVNULL) == 0
+
+def results_by_key(report):
+	return {(result['kernel'], result['n'], result['threads']): result for result in report['results']}
+
+#Null when the run had a single sample
+def ci95(result):
+	return result['ci95_ms'] or 0
+
+def is_slower(base, current, tolerance):
+	if current['median_ms'] < base['median_ms'] * (1 + tolerance / 100):
+		return False
+	return current['mean_ms'] - base['mean_ms'] > math.hypot(ci95(base), ci95(current))
+
+#Results of different machines or builds are not comparable,
+#the comparison is still made but flagged
+def check_metadata(baseline, current):
+	for key in ['cpu', 'simd', 'compiler', 'cxx_flags', 'num_procs']:
+		base_value = baseline['metadata'].get(key)
+		current_value = current['metadata'].get(key)
+		if base_value != current_value:
+			print(f'Warning: {key} differs, baseline {base_value}, current {current_value}')
+
+def compare(baseline, current, config):
+	tolerances = config.get('tolerances', {})
+	default_tolerance = config.get('default_tolerance', 10)
+	base_results = results_by_key(baseline)
+	current_results = results_by_key(current)
+
+	regressions = []
+	missing = []
+
+	print(f'{"kernel":<28}{"n":>6}{"threads":>8}{"baseline":>12}{"current":>12}{"change":>9}{"tol":>6}')
+
+	for key, result in sorted(current_results.items()):
+		kernel, n, threads = key
+		tolerance = tolerances.get(kernel, default_tolerance)
+
+		if key not in base_results:
+			print(f'{kernel:<28}{n:>6}{threads:>8}{"-":>12}{result["median_ms"]:>12.5g}{"":>9}{tolerance:>5}%  not in baseline')
+			continue
+
+		base = base_results[key]
+		change = 100 * (result['median_ms'] / base['median_ms'] - 1) if base['median_ms'] > 0 else 0
+		status = ''
+
+		if is_slower(base, result, tolerance):
+			status = 'REGRESSION'
+			regressions.append(key)
+		elif change < -tolerance:
+			status = 'faster'
+
+		print(f'{kernel:<28}{n:>6}{threads:>8}{base["median_ms"]:>12.5g}{result["median_ms"]:>12.5g}{change:>8.1f}%{tolerance:>5}%  {status}')
+
+	for key, base in sorted(base_results.items()):
+		if key not in current_results:
+			kernel, n, threads = key
+			tolerance = tolerances.get(kernel, default_tolerance)
+			print(f'{kernel:<28}{n:>6}{threads:>8}{base["median_ms"]:>12.5g}{"-":>12}{"":>9}{tolerance:>5}%  MISSING')
+			missing.append(key)
+
+	return regressions, missing
+
+def main():
+	parser = argparse.ArgumentParser(description='Benchmark regression check')
+	parser.add_argument('--binary', help='ParcoDeliverable1 executable')
+	parser.add_argument('--config', required=True, help='sizes, threads and tolerances (regression.json)')
+	parser.add_argument('--baseline', required=True, help='results to compare against')
+	parser.add_argument('--output', default='regression_results.json', help='where the new results are written')
+	parser.add_argument('--current', help='compare these results instead of running the benchmarks')
+	parser.add_argument('--update', action='store_true', help='store the new results as the baseline')
+	args = parser.parse_args()
+
+	config = load_json(args.config)
+	current_path = args.current
+
+	if not args.update and not os.path.exists(args.baseline):
+		print(f'No baseline at {args.baseline}, create it with --update (benchmark-baseline target)')
+		return 2
+
+	if current_path is None:
+		if args.binary is None:
+			print('Either --binary or --current is needed')
+			return 2
+		if not run_benchmarks(args.binary, config, args.output):
+			print('Benchmarks failed')
+			return 2
+		current_path = args.output
+
+	if args.update:
+		shutil.copyfile(current_path, args.baseline)
+		print(f'Baseline written to {args.baseline}')
+		return 0
+
+	baseline = load_json(args.baseline)
+	current = load_json(current_path)
+
+	check_metadata(baseline, current)
+	regressions, missing = compare(baseline, current, config)
+
+	if regressions:
+		print(f'{len(regressions)} regressions:')
+		for kernel, n, threads in regressions:
+			print(f'  {kernel} N={n} threads={threads}')
+
+	if missing:
+		print(f'{len(missing)} baseline results missing from the current run:')
+		for kernel, n, threads in missing:
+			print(f'  {kernel} N={n} threads={threads}')
+
+	if regressions or missing:
+		return 1
+
+	print('No regressions')
+	return 0
+
+if __name__ == '__main__':
+	sys.exit(main())
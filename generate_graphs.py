@@ -1,8 +1,37 @@
 import matplotlib as mp
 import matplotlib.pyplot as plt
+import json
 import math
 import sys
 
+#Benchmark names in bench.json and the keys
+#used for them by the graphs
+KERNEL_KEYS = {
+	'Base symm check': 'sym',
+	'checkSymImp': 'imp_sym',
+	'checkSymOMP': 'omp_sym',
+	'Base transpose': 'transpose',
+	'Imp transpose': 'imp_transpose',
+	'OMP transpose': 'omp_transpose',
+	'Oblivious transpose': 'obv_transpose',
+	'Oblivious OMP transpose': 'obv_omp_transpose',
+	'Final transpose': 'final_omp_transpose',
+	'Streaming OMP transpose': 'stream_omp_transpose',
+	'Hier transpose': 'hier_transpose',
+	'Hier OMP transpose': 'hier_omp_transpose',
+	'Pool transpose': 'pool_transpose',
+	'Imp in place transpose': 'inplace_transpose',
+	'OMP in place transpose': 'inplace_omp_transpose',
+	'checkSymFast': 'fast_sym',
+	'checkSymFastOMP': 'fast_omp_sym',
+	'checkSymSIMD': 'simd_sym',
+	'checkSymSIMD_OMP': 'simd_omp_sym',
+	'checkSymPool': 'pool_sym',
+	'checkSymTolImp': 'tol_sym',
+	'checkSymTolOMP': 'tol_omp_sym',
+	'OMP symmetric/skew parts': 'symskew_omp',
+}
+
 def parse_threads(input_file, n_rep):
 	threads = []
 	while n_rep > 0:
@@ -14,6 +43,8 @@ def parse_threads(input_file, n_rep):
 		n_rep -= 1
 	return threads
 
+#Sections of the old text format only have the
+#benchmarks the program had when it was written
 def parse_section(input_file, n_rep):
 	curr_n = input_file.readline().rstrip()
 
@@ -43,7 +74,31 @@ def parse_section(input_file, n_rep):
 
 	return section
 
-def parse_file(input_file):
+#bench.json, see BenchReport in Bench.h. Serial results
+#are a time, threaded ones a list like in the text format,
+#unknown kernels are kept under their name
+def parse_json(input_file):
+	report = json.load(input_file)
+	metadata = report['metadata']
+	data = { 'max_n': metadata['max_n'], 'threads': metadata['max_threads'], 'metadata': metadata }
+
+	sections = {}
+
+	for result in report['results']:
+		section = sections.setdefault(result['n'], {'n': result['n']})
+		key = KERNEL_KEYS.get(result['kernel'], result['kernel'])
+
+		if result['parallel']:
+			section.setdefault(key, []).append({'threads': result['threads'], 'time': result['median_ms']})
+		else:
+			section[key] = result['median_ms']
+
+	data['benchmarks'] = [sections[n] for n in sorted(sections)]
+
+	return data
+
+#Old positional text format (bench.txt, bench_cluster.txt)
+def parse_text(input_file):
 	max_n = int(input_file.readline().rstrip())
 	max_threads = int(input_file.readline().rstrip())
 	data = { 'max_n': max_n, 'threads': max_threads }
@@ -62,6 +117,29 @@ def parse_file(input_file):
 
 	return data
 
+def parse_file(input_file):
+	text = input_file.read()
+	input_file.seek(0)
+
+	if text.lstrip().startswith('{'):
+		return parse_json(input_file)
+
+	return parse_text(input_file)
+
+#Thread counts of a threaded benchmark, in order
+def thread_counts(data, alg_id):
+	counts = set()
+	for section in data['benchmarks']:
+		counts.update(entry['threads'] for entry in section.get(alg_id, []))
+	return sorted(counts)
+
+#Older files (like the text format) miss the newer benchmarks
+def has_kernel(data, alg_id):
+	return all(alg_id in section for section in data['benchmarks'])
+
+def time_with_threads(section, alg_id, n_threads):
+	return list(filter(lambda entry: (entry['threads'] == n_threads), section[alg_id]))[0]['time']
+
 #Confront baseline symmetry check
 #with other implementations 
 #depending on N
@@ -81,6 +159,13 @@ def output_symmetry(data, n_threads):
 	line_sym_check = plt.plot(collect_n, collect_sym_check, '^-b', label='Base sym')
 	line_imp_check = plt.plot(collect_n, collect_imp_sym, 's-r', label='Imp sym')
 	line_omp_check = plt.plot(collect_n, collect_omp_sym, 'D-g', label=f'OMP sym {n_threads} threads')
+
+	if has_kernel(data, 'simd_sym'):
+		collect_simd_sym = [benchmarks[i]['simd_sym'] for i in range(len(benchmarks))]
+		collect_simd_omp_sym = [time_with_threads(benchmarks[i], 'simd_omp_sym', n_threads) for i in range(len(benchmarks))]
+		line_simd_check = plt.plot(collect_n, collect_simd_sym, 'o-y', label='SIMD sym')
+		line_simd_omp_check = plt.plot(collect_n, collect_simd_omp_sym, '*-k', label=f'SIMD OMP sym {n_threads} threads')
+
 	plt.legend()
 	plt.savefig('sym.png')
 
@@ -104,6 +189,11 @@ def output_transpose(data, n_threads):
 	line_transose = plt.plot(collect_n, collect_transpose, '^-b', label='Base transpose')
 	line_imp_tran = plt.plot(collect_n, collect_imp_transpose, 's-r', label='Imp transpose')
 	line_obv_tran = plt.plot(collect_n, collect_obv_transpose, 'D-g', label='Oblivious transpose')
+
+	if has_kernel(data, 'hier_transpose'):
+		collect_hier_transpose = [benchmarks[i]['hier_transpose'] for i in range(len(benchmarks))]
+		line_hier_tran = plt.plot(collect_n, collect_hier_transpose, 'x-m', label='Hier transpose')
+
 	line_omp_tran = plt.plot(collect_n, collect_omp_transpose, 'o-y', label=f'OMP transpose {n_threads} threads')
 	line_omp_obv = plt.plot(collect_n, collect_obv_omp_transpose, '*-k', label=f'OMP Oblivious {n_threads} threads')
 
@@ -116,38 +206,35 @@ def output_compare_symmetry(data):
 
 	collect_n = [benchmarks[i]['n'] for i in range(len(benchmarks))]
 
-	max_threads = data['threads']
-	n_lines = int(math.log2(max_threads))
-
 	plt.clf()
 	plt.title('Symmetry with different n_threads')
 	plt.ylabel('Time (ms)')
 	plt.xlabel('Matrix size (sqrt(N) elements)')
 
-	for thread_id in range(n_lines):
-		collect_sym_per_thread = [benchmarks[i]['omp_sym'][thread_id]['time'] for i in range(len(benchmarks))]
-		plt.plot(collect_n, collect_sym_per_thread, label=f'{2**(thread_id+1)} threads')
+	for n_threads in thread_counts(data, 'omp_sym'):
+		collect_sym_per_thread = [time_with_threads(benchmarks[i], 'omp_sym', n_threads) for i in range(len(benchmarks))]
+		plt.plot(collect_n, collect_sym_per_thread, label=f'{n_threads} threads')
 
 	plt.legend()
 	plt.savefig('compare_symm.png')
 	return
 
 def output_compare_transpose(data, name, alg_id):
+	if not has_kernel(data, alg_id):
+		return
+
 	benchmarks = data['benchmarks']
 
 	collect_n = [benchmarks[i]['n'] for i in range(len(benchmarks))]
 
-	max_threads = data['threads']
-	n_lines = int(math.log2(max_threads))
-
 	plt.clf()
 	plt.title(f'{name} with different n_threads')
 	plt.ylabel('Time (ms)')
 	plt.xlabel('Matrix size (sqrt(N) elements)')
 
-	for thread_id in range(n_lines):
-		collect_trans_per_thread = [benchmarks[i][alg_id][thread_id]['time'] for i in range(len(benchmarks))]
-		plt.plot(collect_n, collect_trans_per_thread, label=f'{2**(thread_id+1)} threads')
+	for n_threads in thread_counts(data, alg_id):
+		collect_trans_per_thread = [time_with_threads(benchmarks[i], alg_id, n_threads) for i in range(len(benchmarks))]
+		plt.plot(collect_n, collect_trans_per_thread, label=f'{n_threads} threads')
 
 	plt.legend()
 	plt.savefig(f'{alg_id}.png')
@@ -167,6 +254,15 @@ def generate():
 		output_compare_transpose(data, 'OMP transpose', 'omp_transpose')
 		output_compare_transpose(data, 'Oblivious OMP transpose', 'obv_omp_transpose')
 		output_compare_transpose(data, 'Final transpose', 'final_omp_transpose')
+		output_compare_transpose(data, 'Streaming OMP transpose', 'stream_omp_transpose')
+		output_compare_transpose(data, 'Hier OMP transpose', 'hier_omp_transpose')
+		output_compare_transpose(data, 'Pool transpose', 'pool_transpose')
+		output_compare_transpose(data, 'OMP in place transpose', 'inplace_omp_transpose')
+		output_compare_transpose(data, 'Early exit OMP symmetry check', 'fast_omp_sym')
+		output_compare_transpose(data, 'SIMD OMP symmetry check', 'simd_omp_sym')
+		output_compare_transpose(data, 'Pool symmetry check', 'pool_sym')
+		output_compare_transpose(data, 'Tolerance OMP symmetry check', 'tol_omp_sym')
+		output_compare_transpose(data, 'OMP symmetric/skew parts', 'symskew_omp')
 	return
 
 if __name__ == '__main__':